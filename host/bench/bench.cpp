@@ -0,0 +1,73 @@
+/* @file
+ * @brief Common part of the host benches: the options & the emulated device
+ *
+ * @section LICENCE
+ *
+ * This code is in the Public Domain (or CC0 licensed, at your option.)
+ *
+ * Unless required by applicable law or agreed to in writing, this
+ * software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <cstdio>
+#include <cstring>
+
+#include <nvs_flash.h>
+#include <esp_log.h>
+#include <nvs_emul.h>
+
+#include "nvs_device"
+#include "bench.h"
+
+
+namespace bench
+{
+
+    // parse the command line by the option table & limit the log to the errors
+    bool parse(int argc, char* argv[], std::initializer_list<option> opts)
+    {
+	for (int i = 1; i < argc; i++)
+	{
+		const option* opt = nullptr;
+
+	    for (const option& o: opts)
+		if (strcmp(argv[i], o.name) == 0)
+		    opt = &o;
+	    if (!opt)
+	    {
+		fprintf(stderr, "Unknown option: %s\n", argv[i]);
+		return false;
+	    }; /* if !opt */
+	    if (opt->flag)
+		opt->set(nullptr);
+	    else if (i + 1 < argc)
+		opt->set(argv[++i]);
+	    else
+	    {
+		fprintf(stderr, "Missing value of the option: %s\n", argv[i]);
+		return false;
+	    }; /* else if i + 1 < argc */
+	}; /* for int i = 1; i < argc; i++ */
+	esp_log_level_set("*", ESP_LOG_ERROR);
+	return true;
+    }; /* parse() */
+
+
+    // the default partition & the initialized device; the exit code of the bench
+    int device(size_t partition)
+    {
+	if (partition && nvs_emul::partition(NVS_DEFAULT_PART_NAME, partition) != ESP_OK)
+	{
+	    fprintf(stderr, "Invalid partition size: %zu\n", partition);
+	    return 2;
+	}; /* if partition && nvs_emul::partition(...) != ESP_OK */
+	if (!nvs::dev::check())
+	{
+	    fprintf(stderr, "NVS device is not initialized: %s\n", esp_err_to_name(nvs::dev::state()));
+	    return 1;
+	}; /* if !nvs::dev::check() */
+	return 0;
+    }; /* device() */
+
+}; /* namespace bench */
@@ -0,0 +1,66 @@
+/* @file
+ * @brief Common part of the host benches: the options & the emulated device
+ *
+ * Each bench lists its options as the table of bench::option, parses the
+ * command line by bench::parse() and gets the emulated partition with the
+ * initialized nvs::dev by bench::device(); the rest of it is the measurement.
+ *
+ * @section LICENCE
+ *
+ * This code is in the Public Domain (or CC0 licensed, at your option.)
+ *
+ * Unless required by applicable law or agreed to in writing, this
+ * software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#ifndef __NVS_BENCH_H__
+#define __NVS_BENCH_H__
+
+#include <cstddef>
+#include <cstdlib>
+#include <functional>
+#include <initializer_list>
+#include <string>
+#include <type_traits>
+
+namespace bench
+{
+
+    /// Option of the command line: '--name value', or the flag '--name' without the value
+    struct option
+    {
+	/// the option of the value; the bool one is the flag, set by its presence
+	template <typename T>
+	option(const char name[], T& var): name(name), flag(std::is_same_v<T, bool>),
+	    set([&var](const char val[]) {
+		if constexpr (std::is_same_v<T, bool>)
+		    var = true;
+		else if constexpr (std::is_same_v<T, std::string>)
+		    var = val;
+		else
+		    var = static_cast<T>(strtoull(val, nullptr, 0));
+	    })
+	{};
+
+	/// the flag, which sets 'var' to 'on'
+	template <typename T>
+	option(const char name[], T& var, T on): name(name), flag(true), set([&var, on](const char[]) { var = on; })
+	{};
+
+	const char* name;
+	bool flag;				///< no value follows the option
+	std::function<void(const char[])> set;	///< store the value (nullptr for the flag)
+    }; /* struct option */
+
+    /// parse the command line by the option table & limit the log to the errors;
+    /// false, after the message, on the unknown option or the missing value
+    bool parse(int argc, char* argv[], std::initializer_list<option> opts);
+
+    /// the default partition of 'partition' bytes (the default size of the emulator, if 0)
+    /// & the initialized device; the exit code of the bench, 0 if the device is ready
+    int device(size_t partition = 0);
+
+}; /* namespace bench */
+
+#endif // __NVS_BENCH_H__
@@ -0,0 +1,164 @@
+/* @file
+ * @brief Caller-side latency of the control loop: direct writes vs. the write-behind
+ *
+ * The control loop saves its state every tick: a few keys, most of them changed,
+ * then sleeps till the next tick. The flash timing is spent for real, so the
+ * page erases of the NVS garbage collection stall the caller of the direct
+ * stream::write()/commit(). With '--behind' the state is queued to the
+ * stream::write_behind, its worker applies & commits the merged writes.
+ *
+ * Usage: nvs_behind [--partition bytes] [--ticks N] [--keys N] [--tick-us N]
+ *			[--interval-ms N] [--behind]
+ *
+ * Output is the 'name value' lines, one metric per line.
+ *
+ * @section LICENCE
+ *
+ * This code is in the Public Domain (or CC0 licensed, at your option.)
+ *
+ * Unless required by applicable law or agreed to in writing, this
+ * software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <nvs.h>
+#include <nvs_emul.h>
+
+#include "nvs_device"
+#include "nvstream"
+#include "bench.h"
+
+
+namespace
+{
+
+    struct options
+    {
+	size_t partition = 0x6000;
+	unsigned ticks = 500;
+	unsigned keys = 4;		///< keys saved every tick
+	unsigned tick_us = 1000;	///< period of the control loop
+	unsigned interval_ms = 50;	///< write-behind: the longest wait of the queued write
+	bool behind = false;
+    }; /* struct options */
+
+
+    /// p-th percentile of the samples, 'samples' is reordered
+    uint64_t percentile(std::vector<uint64_t>& samples, unsigned p)
+    {
+	if (samples.empty())
+	    return 0;
+
+	    size_t n = (samples.size() - 1) * p / 100;
+
+	std::nth_element(samples.begin(), samples.begin() + n, samples.end());
+	return samples[n];
+    }; /* percentile() */
+
+
+    void report(const char name[], std::vector<uint64_t>& samples)
+    {
+	printf("%s_p50 %" PRIu64 "\n", name, percentile(samples, 50));
+	printf("%s_p99 %" PRIu64 "\n", name, percentile(samples, 99));
+	printf("%s_max %" PRIu64 "\n", name, samples.empty()? 0: *std::max_element(samples.begin(), samples.end()));
+    }; /* report() */
+
+}; /* namespace */
+
+
+
+int main(int argc, char* argv[])
+{
+	options opt;
+	int rc;
+
+    if (!bench::parse(argc, argv, {
+	    {"--partition", opt.partition},
+	    {"--ticks", opt.ticks},
+	    {"--keys", opt.keys},
+	    {"--tick-us", opt.tick_us},
+	    {"--interval-ms", opt.interval_ms},
+	    {"--behind", opt.behind}}))
+	return 2;
+
+    if ((rc = bench::device(opt.partition)) != 0)
+	return rc;
+
+	nvs::stream space("control", nvs::readwrite, nvs::shadowed, opt.behind? nvs::multi_task: nvs::single_task);
+	nvs::stream::write_behind::policy pol;
+	std::vector<std::string> keys;
+	std::vector<uint64_t> tick_wall;
+	esp_err_t err = space.status();
+
+    pol.interval_ms = opt.interval_ms;
+    for (unsigned k = 0; k < opt.keys; k++)
+	keys.push_back("state" + std::to_string(k));
+
+	nvs_emul::timing tm = nvs_emul::get_timing();
+
+    tm.realtime = true;
+    nvs_emul::set_timing(tm);
+    nvs_emul::reset_stats();
+
+	nvs::stream::write_behind behind(space, pol);
+	auto next = std::chrono::steady_clock::now();
+
+    for (unsigned t = 0; t < opt.ticks && err == ESP_OK; t++)
+    {
+	    auto start = std::chrono::steady_clock::now();
+
+	for (unsigned k = 0; k < opt.keys && err == ESP_OK; k++)
+	{
+		uint32_t val = t * 1000 + k;
+
+	    err = opt.behind? behind.write(keys[k], val): space.write(keys[k], val);
+	}; /* for unsigned k = 0; k < opt.keys && err == ESP_OK; k++ */
+	if (err == ESP_OK && !opt.behind)
+	    err = space.commit();
+
+	    auto end = std::chrono::steady_clock::now();
+
+	tick_wall.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+	next += std::chrono::microseconds(opt.tick_us);
+	std::this_thread::sleep_until(next);
+    }; /* for unsigned t = 0; t < opt.ticks && err == ESP_OK; t++ */
+
+	auto flushing = std::chrono::steady_clock::now();
+
+    if (err == ESP_OK)
+	err = behind.flush().get();
+
+	auto flushed = std::chrono::steady_clock::now();
+
+    if (err != ESP_OK)
+    {
+	fprintf(stderr, "Workload failed: %s\n", esp_err_to_name(err));
+	return 1;
+    }; /* if err != ESP_OK */
+
+	nvs_emul::stats st = nvs_emul::get_stats();
+	nvs::stream::write_behind::stats bst = behind.get_stats();
+
+    printf("mode %s\n", opt.behind? "write_behind": "direct");
+    printf("ticks %u\n", opt.ticks);
+    printf("writes_requested %u\n", opt.ticks * opt.keys);
+    printf("behind_coalesced %" PRIu32 "\n", bst.coalesced);
+    printf("behind_batches %" PRIu32 "\n", bst.batches);
+    printf("behind_full_waits %" PRIu32 "\n", bst.full_waits);
+    printf("nvs_sets %" PRIu64 "\n", st.sets);
+    printf("nvs_commits %" PRIu64 "\n", st.commits);
+    printf("entries_written %" PRIu64 "\n", st.entries_written);
+    printf("page_erases %" PRIu64 "\n", st.page_erases);
+    report("tick_wall_ns", tick_wall);
+    printf("final_flush_ns %" PRIu64 "\n",
+	    uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(flushed - flushing).count()));
+    return 0;
+}; /* main() */
@@ -0,0 +1,189 @@
+/* @file
+ * @brief Boot-time blocking of the tasks by the initialization of the NVS partition
+ *
+ * The default partition is filled with '--keys' items, so its init scans the
+ * written pages (the emulator spends the scan time for real). Then the "boot"
+ * starts the tasks, each doing its own work first and then opening its
+ * namespace, except the 'led' one, which does not use the NVS at all:
+ *
+ *	lazy	- the first task touching the NVS initializes the partition, the others wait for it
+ *	eager	- the main task initializes the partition by dev::check() before starting the tasks
+ *	async	- the main task starts the deferred initialization by dev::start(), the tasks
+ *		  wait for the readiness only in the open of their namespaces
+ *
+ * Reported are the time the main task & each task was blocked, the time each
+ * task was done, from the start of the boot, and the waits of the tasks traced
+ * by the latency histogram.
+ *
+ * Usage: nvs_boot [--partition bytes] [--keys N] [--mode lazy|eager|async]
+ *
+ * Output is the 'name value' lines, one metric per line.
+ *
+ * @section LICENCE
+ *
+ * This code is in the Public Domain (or CC0 licensed, at your option.)
+ *
+ * Unless required by applicable law or agreed to in writing, this
+ * software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <string>
+#include <thread>
+
+#include <nvs_flash.h>
+#include <nvs.h>
+#include <nvs_emul.h>
+
+#include "nvs_device"
+#include "nvstream"
+#include "bench.h"
+
+
+namespace
+{
+
+    struct options
+    {
+	size_t partition = 0x40000;
+	unsigned keys = 6000;		///< items stored in the partition before the boot
+	std::string mode = "async";
+    }; /* struct options */
+
+
+    /// The boot task: its own work, then its namespace, if any
+    struct task
+    {
+	const char* name;
+	unsigned work_ms;		///< work before the first use of the NVS
+	const char* space;		///< nullptr: the NVS is not used
+	uint64_t blocked_us = 0;
+	uint64_t done_us = 0;		///< from the start of the boot
+	esp_err_t err = ESP_OK;
+    }; /* struct task */
+
+    using clock = std::chrono::steady_clock;
+
+    uint64_t since(clock::time_point start)
+    {
+	return std::chrono::duration_cast<std::chrono::microseconds>(clock::now() - start).count();
+    }; /* since() */
+
+
+    /// the partition of 'keys' items & one item in each namespace of the tasks; initialized by the C API,
+    /// not by the nvs::dev, then deinitialized: the device of the boot is not made yet
+    esp_err_t fill(size_t size, unsigned keys, const task tasks[], size_t count)
+    {
+	    nvs_handle_t h;
+	    char name[16];
+	    esp_err_t err = nvs_emul::partition(NVS_DEFAULT_PART_NAME, size);
+
+	if (err == ESP_OK)
+	    err = nvs_flash_init();
+	if (err == ESP_OK)
+	    err = nvs_open("fill", NVS_READWRITE, &h);
+	for (unsigned i = 0; i < keys && err == ESP_OK; i++)
+	{
+	    snprintf(name, sizeof(name), "k%05u", i);
+	    err = nvs_set_u32(h, name, i);
+	}; /* for unsigned i = 0; i < keys && err == ESP_OK; i++ */
+	if (err == ESP_OK)
+	    err = nvs_commit(h);
+	nvs_close(h);
+	for (size_t t = 0; t < count && err == ESP_OK; t++)
+	    if (tasks[t].space && (err = nvs_open(tasks[t].space, NVS_READWRITE, &h)) == ESP_OK)
+	    {
+		err = nvs_set_u32(h, "setting", 1);
+		nvs_close(h);
+	    }; /* if tasks[t].space && ... */
+	if (err == ESP_OK)
+	    err = nvs_flash_deinit();
+	return err;
+    }; /* fill() */
+
+}; /* namespace */
+
+
+
+int main(int argc, char* argv[])
+{
+	options opt;
+	task tasks[] = {{"led", 1, nullptr}, {"wifi", 2, "wifi"}, {"sensor", 10, "sensor"}, {"ui", 25, "ui"}};
+	constexpr size_t count = sizeof(tasks) / sizeof(tasks[0]);
+	std::thread threads[count];
+	nvs_emul::timing tm = nvs_emul::get_timing();
+	esp_err_t err;
+
+    if (!bench::parse(argc, argv, {
+	    {"--partition", opt.partition},
+	    {"--keys", opt.keys},
+	    {"--mode", opt.mode}}) || (opt.mode != "lazy" && opt.mode != "eager" && opt.mode != "async"))
+	return 2;
+
+    if ((err = fill(opt.partition, opt.keys, tasks, count)) != ESP_OK)
+    {
+	fprintf(stderr, "Partition is not filled: %s\n", esp_err_to_name(err));
+	return 1;
+    }; /* if (err = fill(...)) != ESP_OK */
+    tm.realtime = true;
+    nvs_emul::set_timing(tm);
+    nvs_emul::reset_stats();
+    nvs::latency::reset();
+
+	auto boot = clock::now();
+
+    if (opt.mode == "eager")
+	nvs::dev::check();
+    else if (opt.mode == "async")
+	nvs::dev::start();
+
+	uint64_t main_blocked = since(boot);
+
+    for (size_t t = 0; t < count; t++)
+	threads[t] = std::thread([&boot](task& job)
+	    {
+		std::this_thread::sleep_for(std::chrono::milliseconds(job.work_ms));
+		if (job.space)
+		{
+			auto start = clock::now();
+			nvs::stream space(job.space, nvs::readwrite);
+			uint32_t val = 0;
+
+		    job.blocked_us = since(start);
+		    job.err = space.read("setting", val);
+		}; /* if job.space */
+		job.done_us = since(boot);
+	    }, std::ref(tasks[t]));
+    for (std::thread& th: threads)
+	th.join();
+
+	nvs::latency::histogram waits = nvs::latency::get(nvs::latency::wait);
+	uint64_t done = 0;
+
+    printf("mode %s\n", opt.mode.c_str());
+    printf("keys %u\n", opt.keys);
+    printf("init_scan_us %" PRIu64 "\n", nvs_emul::get_stats().flash_time_ns / 1000);
+    printf("main_blocked_us %" PRIu64 "\n", main_blocked);
+    for (const task& job: tasks)
+    {
+	printf("%s_blocked_us %" PRIu64 "\n", job.name, job.blocked_us);
+	printf("%s_done_us %" PRIu64 "\n", job.name, job.done_us);
+	done = std::max(done, job.done_us);
+	if (job.err != ESP_OK)
+	{
+	    fprintf(stderr, "Task '%s' failed: %s\n", job.name, esp_err_to_name(job.err));
+	    return 1;
+	}; /* if job.err != ESP_OK */
+    }; /* for const task& job: tasks */
+    printf("boot_done_us %" PRIu64 "\n", done);
+    printf("status %s\n", esp_err_to_name(nvs::dev::status(NVS_DEFAULT_PART_NAME)));
+    if (nvs::latency::compiled)
+    {
+	printf("traced_waits %" PRIu32 "\n", waits.count);
+	printf("traced_wait_max_us %" PRIu32 "\n", waits.max_ns / 1000);
+    }; /* if nvs::latency::compiled */
+    return 0;
+}; /* main() */
@@ -0,0 +1,169 @@
+/* @file
+ * @brief Memory profile of the chunked blob I/O against the whole-buffer blob
+ *
+ * Blobs of the growing sizes are written & read back by the small caller buffer
+ * through the stream::blob_writer/blob_reader, and by the stream::write_blob()/
+ * read_blob() of the whole buffer. The largest heap allocation of each
+ * operation is reported: it is the chunk for the chunked I/O, whatever the size
+ * of the blob is, and the whole blob for the plain one.
+ *
+ * Usage: nvs_chunked [--partition bytes] [--chunk bytes] [--buffer bytes] [--max bytes]
+ *
+ * Output is the 'name value' lines, one metric per line.
+ *
+ * @section LICENCE
+ *
+ * This code is in the Public Domain (or CC0 licensed, at your option.)
+ *
+ * Unless required by applicable law or agreed to in writing, this
+ * software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <vector>
+
+#include <nvs.h>
+
+#include "nvs_device"
+#include "nvstream"
+#include "bench.h"
+
+
+namespace
+{
+
+    std::atomic<size_t> largest{0};	///< largest allocation since the last reset
+
+}; /* namespace */
+
+
+void* operator new(size_t size)
+{
+	size_t seen = largest;
+
+    while (size > seen && !largest.compare_exchange_weak(seen, size))
+	;
+    if (void* p = malloc(size? size: 1))
+	return p;
+    throw std::bad_alloc();
+}; /* operator new() */
+
+void operator delete(void* p) noexcept { free(p); };
+void operator delete(void* p, size_t) noexcept { free(p); };
+
+
+namespace
+{
+
+    struct options
+    {
+	size_t partition = 0x100000;
+	size_t chunk = nvs::stream::blob_writer::default_chunk;
+	size_t buffer = 256;		///< caller's buffer of the chunked I/O
+	size_t max = 256 * 1024;	///< the largest blob; sizes are 4K, 16K, ... up to it
+    }; /* struct options */
+
+
+    /// byte 'i' of the test payload
+    uint8_t pattern(size_t i) { return uint8_t(i * 131 + (i >> 8)); };
+
+}; /* namespace */
+
+
+
+int main(int argc, char* argv[])
+{
+	options opt;
+	int rc;
+
+    if (!bench::parse(argc, argv, {
+	    {"--partition", opt.partition},
+	    {"--chunk", opt.chunk},
+	    {"--buffer", opt.buffer},
+	    {"--max", opt.max}}))
+	return 2;
+
+    if ((rc = bench::device(opt.partition)) != 0)
+	return rc;
+
+	nvs::stream space("blobs", nvs::readwrite);
+	std::vector<uint8_t> buff(opt.buffer);
+	esp_err_t err = space.status();
+
+    printf("chunk_bytes %zu\n", opt.chunk);
+    printf("buffer_bytes %zu\n", opt.buffer);
+    for (size_t size = 4096; size <= opt.max && err == ESP_OK; size *= 4)
+    {
+	    size_t checked = 0;
+
+	// chunked write by the caller's buffer
+	largest = 0;
+	{
+		nvs::stream::blob_writer out(space, "calib", opt.chunk);
+
+	    for (size_t pos = 0; pos < size && err == ESP_OK; pos += buff.size())
+	    {
+		    size_t part = std::min(buff.size(), size - pos);
+
+		for (size_t i = 0; i < part; i++)
+		    buff[i] = pattern(pos + i);
+		err = out.write(buff.data(), part);
+	    }; /* for size_t pos = 0; pos < size && err == ESP_OK; ... */
+	    if (err == ESP_OK)
+		err = out.finish();
+	}
+	printf("chunked_%zu_write_largest_alloc %zu\n", size, size_t(largest));
+
+	// chunked read by the caller's buffer, checked
+	largest = 0;
+	{
+		nvs::stream::blob_reader in(space, "calib");
+		size_t length = buff.size();
+
+	    if ((err = in.status()) == ESP_OK && in.size() != size)
+		err = ESP_ERR_INVALID_SIZE;
+	    while (err == ESP_OK && (err = in.read(buff.data(), length)) == ESP_OK && length)
+	    {
+		for (size_t i = 0; i < length; i++)
+		    if (buff[i] != pattern(checked + i))
+			err = ESP_ERR_INVALID_RESPONSE;
+		checked += length;
+		length = buff.size();
+	    }; /* while err == ESP_OK && ... */
+	}
+	printf("chunked_%zu_read_largest_alloc %zu\n", size, size_t(largest));
+	if (err == ESP_OK && checked != size)
+	    err = ESP_ERR_INVALID_SIZE;
+	if (err != ESP_OK)
+	    break;
+
+	// whole-buffer blob of the same size, as before
+	largest = 0;
+	{
+		std::vector<uint8_t> whole(size);
+		std::vector<uint8_t> back;
+
+	    for (size_t i = 0; i < size; i++)
+		whole[i] = pattern(i);
+	    err = space.write_blob("plain", whole.data(), whole.size());
+	    if (err == ESP_OK)
+		err = space.read_blob("plain", back);
+	    if (err == ESP_OK && back != whole)
+		err = ESP_ERR_INVALID_RESPONSE;
+	    space.write_blob("plain", nullptr, 0);	// free the flash for the next size
+	}
+	printf("plain_%zu_largest_alloc %zu\n", size, size_t(largest));
+    }; /* for size_t size = 4096; size <= opt.max && err == ESP_OK; size *= 4 */
+
+    if (err != ESP_OK)
+    {
+	fprintf(stderr, "Blob I/O failed: %s\n", esp_err_to_name(err));
+	return 1;
+    }; /* if err != ESP_OK */
+    return 0;
+}; /* main() */
@@ -0,0 +1,145 @@
+/* @file
+ * @brief Flash writes of the persistent counters: the write of every second vs. the nvs::counter
+ *
+ * Three counters change every second: the uptime (+1), the cycles (+0..2) and
+ * the energy (+0..20). They are persisted by the stream::write() & commit() of
+ * each change, or accumulated by the nvs::counter and persisted after '--every'
+ * units into the ring of '--slots' slot keys. The hours of the simulated time
+ * are run; reported are the NVS sets, the flash entries programmed and the page
+ * erases per hour, then the power failure is simulated: the counters are dropped
+ * without the flush and recovered from the slots, the loss is reported.
+ *
+ * Usage: nvs_counter [--partition bytes] [--hours N] [--every N] [--slots N] [--direct] [--seed N]
+ *
+ * Output is the 'name value' lines, one metric per line.
+ *
+ * @section LICENCE
+ *
+ * This code is in the Public Domain (or CC0 licensed, at your option.)
+ *
+ * Unless required by applicable law or agreed to in writing, this
+ * software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+
+#include <nvs.h>
+#include <nvs_emul.h>
+
+#include "nvs_device"
+#include "nvstream"
+#include "bench.h"
+
+
+namespace
+{
+
+    struct options
+    {
+	size_t partition = 0x6000;
+	unsigned hours = 4;
+	uint64_t every = 60;		///< units accumulated before the persist
+	unsigned slots = 4;
+	bool direct = false;		///< write & commit every change
+	unsigned seed = 1;
+    }; /* struct options */
+
+
+    const char* const names[] = {"uptime", "cycles", "energy"};
+    constexpr size_t count = sizeof(names) / sizeof(names[0]);
+
+
+    /// increment of the counter 'i' in the second
+    uint64_t step(size_t i, std::mt19937& rnd)
+    {
+	return (i == 0)? 1: (i == 1)? rnd() % 3: rnd() % 21;
+    }; /* step() */
+
+}; /* namespace */
+
+
+
+int main(int argc, char* argv[])
+{
+	options opt;
+	int rc;
+
+    if (!bench::parse(argc, argv, {
+	    {"--partition", opt.partition},
+	    {"--hours", opt.hours},
+	    {"--every", opt.every},
+	    {"--slots", opt.slots},
+	    {"--seed", opt.seed},
+	    {"--direct", opt.direct}}))
+	return 2;
+
+    if ((rc = bench::device(opt.partition)) != 0)
+	return rc;
+
+	nvs::stream space("counters", nvs::readwrite);
+	nvs::counter::policy pol;
+	nvs::counter* counters[count] = {};
+	uint64_t totals[count] = {};
+	uint64_t worst[count] = {};	///< the most pending units seen
+	std::mt19937 rnd(opt.seed);
+	uint64_t seconds = uint64_t(opt.hours) * 3600;
+	esp_err_t err = space.status();
+
+    pol.every = opt.every;
+    pol.slots = opt.slots;
+    for (size_t i = 0; i < count && !opt.direct; i++)
+	counters[i] = new nvs::counter(space, names[i], pol);
+    nvs_emul::reset_stats();
+    for (uint64_t t = 0; t < seconds && err == ESP_OK; t++)
+	for (size_t i = 0; i < count && err == ESP_OK; i++)
+	{
+		uint64_t delta = step(i, rnd);
+
+	    totals[i] += delta;
+	    if (opt.direct)
+	    {
+		if (delta && (err = space.write(names[i], uint32_t(totals[i]))) == ESP_OK)
+		    err = space.commit();
+		continue;
+	    }; /* if opt.direct */
+	    err = counters[i]->add(delta);
+	    worst[i] = std::max(worst[i], counters[i]->value() - counters[i]->stored());
+	}; /* for size_t i = 0; i < count && err == ESP_OK; i++ */
+    if (err != ESP_OK)
+    {
+	fprintf(stderr, "Workload failed: %s\n", esp_err_to_name(err));
+	return 1;
+    }; /* if err != ESP_OK */
+
+	nvs_emul::stats st = nvs_emul::get_stats();
+
+    printf("mode %s\n", opt.direct? "direct": "counter");
+    printf("hours %u\n", opt.hours);
+    printf("every_units %" PRIu64 "\n", opt.every);
+    printf("slots %u\n", opt.slots);
+    printf("nvs_sets_per_hour %.1f\n", double(st.sets) / opt.hours);
+    printf("entries_written_per_hour %.1f\n", double(st.entries_written) / opt.hours);
+    printf("page_erases_per_hour %.2f\n", double(st.page_erases) / opt.hours);
+    if (opt.direct)
+	return 0;
+
+    // power failure: the counters are lost with their pending increments, the new ones recover the slots
+    for (size_t i = 0; i < count; i++)
+    {
+	    nvs::counter back(space, names[i], pol);
+
+	printf("%s_worst_pending %" PRIu64 "\n", names[i], worst[i]);
+	printf("%s_loss %" PRIu64 "\n", names[i], totals[i] - back.value());
+	if (back.status() != ESP_OK || back.value() != counters[i]->stored() || totals[i] - back.value() >= std::max<uint64_t>(opt.every, 1))
+	{
+	    fprintf(stderr, "Counter '%s' is not recovered: %" PRIu64 " of %" PRIu64 "\n", names[i], back.value(), totals[i]);
+	    return 1;
+	}; /* if back.status() != ESP_OK || ... */
+    }; /* for size_t i = 0; i < count; i++ */
+    return 0;	// the dropped counters are not destroyed: their pending increments are never persisted
+}; /* main() */
@@ -0,0 +1,141 @@
+/* @file
+ * @brief Flash wear of the frequently tweaked parameter table: whole blob vs. delta blob
+ *
+ * The parameter table is stored as one blob and updated many times, a few
+ * bytes per update (one tuned parameter). Each update is written by the
+ * stream::write_blob() of the whole table, or by the stream::write_blob_delta(),
+ * which writes only the chunks changed. Reported are the bytes written per
+ * update, the flash entries programmed and the page erases of the NVS GC.
+ *
+ * Usage: nvs_delta [--partition bytes] [--table bytes] [--updates N] [--tweaks N]
+ *			[--chunk bytes] [--seed N]
+ *
+ * Output is the 'name value' lines, one metric per line.
+ *
+ * @section LICENCE
+ *
+ * This code is in the Public Domain (or CC0 licensed, at your option.)
+ *
+ * Unless required by applicable law or agreed to in writing, this
+ * software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <nvs.h>
+#include <nvs_emul.h>
+
+#include "nvs_device"
+#include "nvstream"
+#include "bench.h"
+
+
+namespace
+{
+
+    struct options
+    {
+	size_t partition = 0x10000;
+	size_t table = 8192;		///< bytes of the parameter table
+	unsigned updates = 200;
+	unsigned tweaks = 2;		///< parameters (bytes) changed per update
+	size_t chunk = nvs::stream::delta_chunk;
+	unsigned seed = 1;
+    }; /* struct options */
+
+
+    /// Run the updates of the table by 'write', print the metrics with the prefix 'name'
+    template <typename Write>
+    esp_err_t run(const char name[], const options& opt, Write&& write)
+    {
+	    std::mt19937 rnd(opt.seed);
+	    std::vector<uint8_t> table(opt.table);
+	    uint64_t bytes = 0;
+	    esp_err_t err = ESP_OK;
+
+	for (size_t i = 0; i < table.size(); i++)
+	    table[i] = uint8_t(i);
+	if ((err = write(table, bytes)) != ESP_OK)	// the initial table is not counted
+	    return err;
+	nvs_emul::reset_stats();
+	bytes = 0;
+	for (unsigned u = 0; u < opt.updates && err == ESP_OK; u++)
+	{
+	    for (unsigned t = 0; t < opt.tweaks; t++)
+		table[rnd() % table.size()] += 1 + rnd() % 255;
+	    err = write(table, bytes);
+	}; /* for unsigned u = 0; u < opt.updates && err == ESP_OK; u++ */
+
+	    nvs_emul::stats st = nvs_emul::get_stats();
+
+	printf("%s_bytes_per_update %.1f\n", name, double(bytes) / opt.updates);
+	printf("%s_entries_per_update %.2f\n", name, double(st.entries_written) / opt.updates);
+	printf("%s_page_erases %" PRIu64 "\n", name, st.page_erases);
+	printf("%s_flash_ns_per_update %" PRIu64 "\n", name, st.flash_time_ns / opt.updates);
+	return err;
+    }; /* run() */
+
+}; /* namespace */
+
+
+
+int main(int argc, char* argv[])
+{
+	options opt;
+	int rc;
+
+    if (!bench::parse(argc, argv, {
+	    {"--partition", opt.partition},
+	    {"--table", opt.table},
+	    {"--updates", opt.updates},
+	    {"--tweaks", opt.tweaks},
+	    {"--chunk", opt.chunk},
+	    {"--seed", opt.seed}}))
+	return 2;
+
+    if ((rc = bench::device(opt.partition)) != 0)
+	return rc;
+
+	nvs::stream space("params", nvs::readwrite);
+	std::vector<uint8_t> last;
+	esp_err_t err;
+
+    printf("table_bytes %zu\n", opt.table);
+    printf("updates %u\n", opt.updates);
+    printf("tweaks_per_update %u\n", opt.tweaks);
+    printf("chunk_bytes %zu\n", opt.chunk);
+
+    err = run("whole", opt, [&](const std::vector<uint8_t>& table, uint64_t& bytes) {
+	    esp_err_t rc = space.write_blob("whole", table.data(), table.size());
+
+	bytes += table.size();
+	return rc;
+    });
+    space.write_blob("whole", nullptr, 0);	// free the flash for the delta run
+    if (err == ESP_OK)
+	err = run("delta", opt, [&](const std::vector<uint8_t>& table, uint64_t& bytes) {
+		nvs::delta_stats report;
+		esp_err_t rc = space.write_blob_delta("delta", table.data(), table.size(), &report, opt.chunk);
+
+	    bytes += report.bytes;
+	    last = table;
+	    return rc;
+	});
+
+	std::vector<uint8_t> back;
+
+    if (err == ESP_OK && (err = space.read_blob_delta("delta", back)) == ESP_OK && back != last)
+	err = ESP_ERR_INVALID_RESPONSE;
+    if (err != ESP_OK)
+    {
+	fprintf(stderr, "Workload failed: %s\n", esp_err_to_name(err));
+	return 1;
+    }; /* if err != ESP_OK */
+    return 0;
+}; /* main() */
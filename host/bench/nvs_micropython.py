@@ -0,0 +1,79 @@
+# Throughput of the MicroPython module 'nvs' on the unix port, over the emulated partition
+#
+# Each operation of the nvs.Stream is run N times: the typed get/set of the
+# integers & of the string, the blob - into the new bytes object, into the
+# caller's bytearray (readinto_blob) & from it; the batch of the items written
+# by the update() with one commit against the set_*() & commit() per item.
+# Reported per operation are the time, the bytes allocated on the MicroPython
+# heap (the garbage collector is off during the run) and the NVS operations of
+# the emulated partition.
+#
+# Usage: micropython host/bench/nvs_micropython.py [iterations]
+#
+# Output is the 'name value' lines, one metric per line.
+
+import gc
+import sys
+import time
+import nvs
+
+N = int(sys.argv[1]) if len(sys.argv) > 1 else 5000
+BATCH = 16
+
+
+def measure(name, op):
+    gc.collect()
+    gc.disable()
+    nvs.reset_stats()
+    heap = gc.mem_alloc()
+    start = time.ticks_us()
+    for i in range(N):
+        op(i)
+    us = time.ticks_diff(time.ticks_us(), start)
+    heap = gc.mem_alloc() - heap
+    gc.enable()
+    st = nvs.stats()
+    print(name + "_ns", us * 1000 // N)
+    print(name + "_heap_bytes", heap // N)
+    print(name + "_sets", st["sets"] // N)
+    print(name + "_commits", st["commits"] // N)
+
+
+nvs.emul_partition(0x40000)
+s = nvs.Stream("bench", nvs.READWRITE)
+blob_a = bytearray(range(64))
+blob_b = bytearray(reversed(range(64)))
+into = bytearray(64)
+# the batch of the changed items: the values of the two lists alternate
+pairs = ([("cfg%02d" % k, k * 7) for k in range(BATCH)], [("cfg%02d" % k, k * 9 + 1) for k in range(BATCH)])
+batch = (dict(pairs[0]), dict(pairs[1]))
+
+s.set_u32("u32", 1)
+s.set_i64("i64", -1)
+s.set_str("str", "value of the setting")
+s.set_blob("blob", blob_a)
+s.commit()
+
+print("iterations", N)
+measure("u32_get", lambda i: s.get_u32("u32"))
+measure("u32_set", lambda i: s.set_u32("u32", i))
+measure("i64_get", lambda i: s.get_i64("i64"))
+measure("i64_set", lambda i: s.set_i64("i64", -5000000000 - i))
+measure("str_get", lambda i: s.get_str("str"))
+measure("str_set", lambda i: s.set_str("str", "AB"[i & 1] + " value of the setting"))
+measure("blob_get", lambda i: s.get_blob("blob"))
+measure("blob_readinto", lambda i: s.readinto_blob("blob", into))
+measure("blob_set", lambda i: s.set_blob("blob", blob_b if i & 1 else blob_a))
+measure("absent_default", lambda i: s.get_u32("none", 0))
+
+
+def per_item(i):
+    for k, v in pairs[i & 1]:
+        s.set_i32(k, v)
+        s.commit()
+
+
+measure("batch_per_item_commit", per_item)
+measure("batch_update", lambda i: s.update(pairs[i & 1]))
+measure("batch_update_dict", lambda i: s.update(batch[i & 1]))
+s.close()
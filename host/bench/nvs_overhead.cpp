@@ -0,0 +1,259 @@
+/* @file
+ * @brief Overhead of the nvs::stream over the raw NVS C API, per type & per operation
+ *
+ * For each type stored by the stream - the integers, the std::string and the
+ * blob - the same operation is run by the stream and by the nvs_get_*()/
+ * nvs_set_*() of the C API on its own namespace: the read, the write of the
+ * changed value, the write of the unchanged value; the commit - once, it does
+ * not depend on the type. Reported per operation are the time, the heap
+ * allocations, the item lookups and the flash entries programmed by the
+ * emulated partition; '<type>_<op>_overhead_ns' is the difference of the times,
+ * to be gated by the CI. The flash time is not spent: the time is the CPU only.
+ *
+ * Usage: nvs_overhead [--iterations N] [--shadow]
+ *
+ * Output is the 'name value' lines, one metric per line, the names are
+ * '<type>_<op>_<api>_<metric>', <api> is 'c' or 'stream'.
+ *
+ * @section LICENCE
+ *
+ * This code is in the Public Domain (or CC0 licensed, at your option.)
+ *
+ * Unless required by applicable law or agreed to in writing, this
+ * software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <vector>
+
+#include <nvs.h>
+#include <nvs_emul.h>
+
+#include "nvs_device"
+#include "nvstream"
+#include "bench.h"
+
+
+namespace
+{
+
+    std::atomic<uint64_t> allocs{0};	///< heap allocations since the start
+
+}; /* namespace */
+
+
+void* operator new(size_t size)
+{
+    allocs.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = malloc(size? size: 1))
+	return p;
+    throw std::bad_alloc();
+}; /* operator new() */
+
+void operator delete(void* p) noexcept { free(p); };
+void operator delete(void* p, size_t) noexcept { free(p); };
+
+
+namespace
+{
+
+    struct options
+    {
+	unsigned iterations = 20000;
+	bool shadow = false;		///< the stream keeps the RAM shadow
+    }; /* struct options */
+
+
+    using blob = std::vector<uint8_t>;
+
+    // The C API by the type
+    esp_err_t c_set(nvs_handle_t h, const char k[], int8_t v)   { return nvs_set_i8(h, k, v); };
+    esp_err_t c_set(nvs_handle_t h, const char k[], uint8_t v)  { return nvs_set_u8(h, k, v); };
+    esp_err_t c_set(nvs_handle_t h, const char k[], int16_t v)  { return nvs_set_i16(h, k, v); };
+    esp_err_t c_set(nvs_handle_t h, const char k[], uint16_t v) { return nvs_set_u16(h, k, v); };
+    esp_err_t c_set(nvs_handle_t h, const char k[], int32_t v)  { return nvs_set_i32(h, k, v); };
+    esp_err_t c_set(nvs_handle_t h, const char k[], uint32_t v) { return nvs_set_u32(h, k, v); };
+    esp_err_t c_set(nvs_handle_t h, const char k[], int64_t v)  { return nvs_set_i64(h, k, v); };
+    esp_err_t c_set(nvs_handle_t h, const char k[], uint64_t v) { return nvs_set_u64(h, k, v); };
+    esp_err_t c_set(nvs_handle_t h, const char k[], const std::string& v) { return nvs_set_str(h, k, v.c_str()); };
+    esp_err_t c_set(nvs_handle_t h, const char k[], const blob& v) { return nvs_set_blob(h, k, v.data(), v.size()); };
+
+    esp_err_t c_get(nvs_handle_t h, const char k[], int8_t& v)   { return nvs_get_i8(h, k, &v); };
+    esp_err_t c_get(nvs_handle_t h, const char k[], uint8_t& v)  { return nvs_get_u8(h, k, &v); };
+    esp_err_t c_get(nvs_handle_t h, const char k[], int16_t& v)  { return nvs_get_i16(h, k, &v); };
+    esp_err_t c_get(nvs_handle_t h, const char k[], uint16_t& v) { return nvs_get_u16(h, k, &v); };
+    esp_err_t c_get(nvs_handle_t h, const char k[], int32_t& v)  { return nvs_get_i32(h, k, &v); };
+    esp_err_t c_get(nvs_handle_t h, const char k[], uint32_t& v) { return nvs_get_u32(h, k, &v); };
+    esp_err_t c_get(nvs_handle_t h, const char k[], int64_t& v)  { return nvs_get_i64(h, k, &v); };
+    esp_err_t c_get(nvs_handle_t h, const char k[], uint64_t& v) { return nvs_get_u64(h, k, &v); };
+
+    /// the string & the blob are read into the caller's buffer, as the C code does
+    esp_err_t c_get(nvs_handle_t h, const char k[], std::string&)
+    {
+	    char buff[128];
+	    size_t length = sizeof(buff);
+
+	return nvs_get_str(h, k, buff, &length);
+    }; /* c_get(std::string&) */
+
+    esp_err_t c_get(nvs_handle_t h, const char k[], blob&)
+    {
+	    uint8_t buff[128];
+	    size_t length = sizeof(buff);
+
+	return nvs_get_blob(h, k, buff, &length);
+    }; /* c_get(blob&) */
+
+
+    // The stream by the type
+    template <typename T>
+    esp_err_t s_set(nvs::stream& s, const char k[], const T& v) { return s.write(k, v); };
+    esp_err_t s_set(nvs::stream& s, const char k[], const blob& v) { return s.write_blob(k, v.data(), v.size()); };
+
+    /// the value is read into the new local, as the typical caller does
+    template <typename T>
+    esp_err_t s_get(nvs::stream& s, const char k[], T&) { T v; return s.read(k, v); };
+    esp_err_t s_get(nvs::stream& s, const char k[], blob&) { blob v; return s.read_blob(k, v); };
+
+
+    struct sample
+    {
+	double ns = 0;
+	double allocs = 0;
+	double lookups = 0;
+	double entries = 0;	///< flash entries programmed
+    }; /* struct sample */
+
+
+    /// run the 'op' of the iteration number 'iterations' times
+    template <typename Op>
+    sample measure(unsigned iterations, Op&& op)
+    {
+	    esp_err_t err = ESP_OK;
+
+	nvs_emul::reset_stats();
+
+	    uint64_t before = allocs.load();
+	    auto start = std::chrono::steady_clock::now();
+
+	for (unsigned i = 0; i < iterations && err == ESP_OK; i++)
+	    err = op(i);
+
+	    auto end = std::chrono::steady_clock::now();
+	    uint64_t count = allocs.load() - before;
+	    nvs_emul::stats st = nvs_emul::get_stats();
+
+	if (err != ESP_OK)
+	{
+	    fprintf(stderr, "Operation failed: %s\n", esp_err_to_name(err));
+	    exit(1);
+	}; /* if err != ESP_OK */
+	return sample{double(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count()) / iterations,
+		double(count) / iterations, double(st.lookups) / iterations, double(st.entries_written) / iterations};
+    }; /* measure() */
+
+
+    void print(const std::string& prefix, const sample& s)
+    {
+	printf("%s_ns %.1f\n", prefix.c_str(), s.ns);
+	printf("%s_allocs %.2f\n", prefix.c_str(), s.allocs);
+	printf("%s_lookups %.2f\n", prefix.c_str(), s.lookups);
+	printf("%s_flash_entries %.2f\n", prefix.c_str(), s.entries);
+    }; /* print() */
+
+
+    void report(const std::string& prefix, const sample& c, const sample& s)
+    {
+	print(prefix + "_c", c);
+	print(prefix + "_stream", s);
+	printf("%s_overhead_ns %.1f\n", prefix.c_str(), s.ns - c.ns);
+    }; /* report() */
+
+
+    /// read, changed write & unchanged write of the type T: the values 'a' & 'b' alternate
+    template <typename T>
+    void run(const char name[], nvs_handle_t raw, nvs::stream& strm, unsigned iterations, const T& a, const T& b)
+    {
+	    T val = a;
+	    sample c, s;
+
+	// the initial items; the first write of the key is not measured
+	if (c_set(raw, name, a) != ESP_OK || s_set(strm, name, a) != ESP_OK)
+	{
+	    fprintf(stderr, "Initial write of '%s' failed\n", name);
+	    exit(1);
+	}; /* if c_set(raw, name, a) != ESP_OK || ... */
+
+	c = measure(iterations, [&](unsigned) { return c_get(raw, name, val); });
+	s = measure(iterations, [&](unsigned) { return s_get(strm, name, val); });
+	report(std::string(name) + "_read", c, s);
+
+	c = measure(iterations, [&](unsigned i) { return c_set(raw, name, (i & 1)? a: b); });
+	s = measure(iterations, [&](unsigned i) { return s_set(strm, name, (i & 1)? a: b); });
+	report(std::string(name) + "_write", c, s);
+
+	c = measure(iterations, [&](unsigned) { return c_set(raw, name, b); });
+	s = measure(iterations, [&](unsigned) { return s_set(strm, name, b); });
+	report(std::string(name) + "_unchanged", c, s);
+    }; /* run() */
+
+}; /* namespace */
+
+
+
+int main(int argc, char* argv[])
+{
+	options opt;
+	int rc;
+
+    if (!bench::parse(argc, argv, {
+	    {"--iterations", opt.iterations},
+	    {"--shadow", opt.shadow}}))
+	return 2;
+
+    if ((rc = bench::device(0x40000)) != 0)
+	return rc;
+
+	nvs_handle_t raw = 0;
+	nvs::stream strm("wrapped", nvs::readwrite, opt.shadow? nvs::shadowed: nvs::noshadow);
+	blob b1(32), b2(32);
+
+    if (nvs_open("raw", NVS_READWRITE, &raw) != ESP_OK || strm.status() != ESP_OK)
+    {
+	fprintf(stderr, "Namespaces are not opened\n");
+	return 1;
+    }; /* if nvs_open("raw", NVS_READWRITE, &raw) != ESP_OK || ... */
+    for (size_t i = 0; i < b1.size(); i++)
+    {
+	b1[i] = uint8_t(i);
+	b2[i] = uint8_t(i * 7);
+    }; /* for size_t i = 0; i < b1.size(); i++ */
+
+    printf("iterations %u\n", opt.iterations);
+    printf("shadow %d\n", opt.shadow? 1: 0);
+    printf("trace_level %d\n", NVS_TRACE_LEVEL);
+    printf("latency %d\n", nvs::latency::compiled? 1: 0);
+    run<int8_t>  ("i8",  raw, strm, opt.iterations, -5, 7);
+    run<uint8_t> ("u8",  raw, strm, opt.iterations, 5, 7);
+    run<int16_t> ("i16", raw, strm, opt.iterations, -500, 700);
+    run<uint16_t>("u16", raw, strm, opt.iterations, 500, 700);
+    run<int32_t> ("i32", raw, strm, opt.iterations, -50000, 70000);
+    run<uint32_t>("u32", raw, strm, opt.iterations, 50000, 70000);
+    run<int64_t> ("i64", raw, strm, opt.iterations, -5000000000, 7000000000);
+    run<uint64_t>("u64", raw, strm, opt.iterations, 5000000000, 7000000000);
+    run<std::string>("str", raw, strm, opt.iterations, "the value of the setting, A", "the value of the setting, B");
+    run<blob>("blob", raw, strm, opt.iterations, b1, b2);
+
+	sample c = measure(opt.iterations, [&](unsigned) { return nvs_commit(raw); });
+	sample s = measure(opt.iterations, [&](unsigned) { return strm.commit(); });
+
+    report("commit", c, s);
+    nvs_close(raw);
+    return 0;
+}; /* main() */
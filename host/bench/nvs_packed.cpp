@@ -0,0 +1,219 @@
+/* @file
+ * @brief Space saved by the compressed blobs & strings and the CPU cost of the codec
+ *
+ * The payloads of the typical kinds - JSON fragments, the lookup table of the
+ * small records, the text and the random bytes - are written & read back by the
+ * stream::write_blob()/read_blob() (the text - by the stream::write()/read() of
+ * the std::string), plain and with the stream::compress(). Reported are the
+ * bytes stored per item, the space saved, and the time of the write & the read
+ * per KiB of the payload; the flash time is not spent, so the difference of the
+ * times is the CPU cost of the codec.
+ *
+ * Usage: nvs_packed [--partition bytes] [--size bytes] [--rounds N] [--seed N]
+ *
+ * Output is the 'name value' lines, one metric per line.
+ *
+ * @section LICENCE
+ *
+ * This code is in the Public Domain (or CC0 licensed, at your option.)
+ *
+ * Unless required by applicable law or agreed to in writing, this
+ * software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <nvs.h>
+#include <nvs_emul.h>
+
+#include "nvs_device"
+#include "nvstream"
+#include "bench.h"
+
+
+namespace
+{
+
+    struct options
+    {
+	size_t partition = 0x40000;
+	size_t size = 2048;		///< bytes of the payload; the text is limited by the NVS string
+	unsigned rounds = 200;		///< writes & reads of each payload, the variants alternate
+	unsigned seed = 1;
+    }; /* struct options */
+
+
+    /// the JSON fragment: array of the sensor descriptions
+    std::string json(size_t size, std::mt19937& rnd)
+    {
+	    std::string out = "[";
+
+	for (unsigned id = 0; out.size() < size; id++)
+	    out += "{\"id\":" + std::to_string(id) + ",\"name\":\"sensor_" + std::to_string(rnd() % 64)
+		    + "\",\"enabled\":" + ((rnd() % 4)? "true": "false") + ",\"threshold\":"
+		    + std::to_string(rnd() % 1000) + ".5,\"unit\":\"mV\"},";
+	out.resize(size);
+	return out;
+    }; /* json() */
+
+
+    /// the lookup table: records of the calibration points, the small values
+    std::string table(size_t size, std::mt19937& rnd)
+    {
+	    std::string out;
+
+	for (uint16_t point = 0; out.size() < size; point++)
+	{
+		uint16_t rec[4] = {point, uint16_t(rnd() % 4), uint16_t(1000 + point / 8), 0};
+
+	    out.append(reinterpret_cast<const char*>(rec), sizeof(rec));
+	}; /* for uint16_t point = 0; out.size() < size; point++ */
+	out.resize(size);
+	return out;
+    }; /* table() */
+
+
+    /// the text: the lines of the event log
+    std::string text(size_t size, std::mt19937& rnd)
+    {
+	    static const char* const events[] = {"boot", "wifi connected", "wifi lost", "ota check", "sensor timeout"};
+	    std::string out;
+
+	for (unsigned t = 0; out.size() < size; t++)
+	    out += "I (" + std::to_string(t * 1000 + rnd() % 1000) + ") app: " + events[rnd() % 5] + "\n";
+	out.resize(size);
+	return out;
+    }; /* text() */
+
+
+    std::string noise(size_t size, std::mt19937& rnd)
+    {
+	    std::string out(size, '\0');
+
+	for (auto& c: out)
+	    c = char(rnd());
+	return out;
+    }; /* noise() */
+
+
+    struct result
+    {
+	uint64_t stored = 0;	///< bytes stored per item
+	uint64_t write_ns = 0;	///< of all the rounds
+	uint64_t read_ns = 0;
+    }; /* struct result */
+
+
+    /// write & read back the 'items' in the 'rounds', alternating them; the strings by the std::string
+    esp_err_t run(nvs::stream& space, bool packed, bool string, const std::vector<std::string>& items, unsigned rounds, result& res)
+    {
+	    std::vector<uint8_t> blob;
+	    std::string back;
+	    esp_err_t err = ESP_OK;
+
+	space.compress(packed);
+	for (unsigned r = 0; r < rounds && err == ESP_OK; r++)
+	{
+		const std::string& item = items[r % items.size()];
+		auto start = std::chrono::steady_clock::now();
+
+	    nvs_emul::reset_stats();
+	    err = string? space.write("payload", item): space.write_blob("payload", item.data(), item.size());
+	    res.stored = nvs_emul::get_stats().payload_bytes;
+
+		auto written = std::chrono::steady_clock::now();
+
+	    if (err == ESP_OK)
+		err = string? space.read("payload", back): space.read_blob("payload", blob);
+
+		auto end = std::chrono::steady_clock::now();
+
+	    if (err == ESP_OK && (string? back != item: std::string(blob.begin(), blob.end()) != item))
+		err = ESP_ERR_INVALID_RESPONSE;
+	    res.write_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(written - start).count();
+	    res.read_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(end - written).count();
+	}; /* for unsigned r = 0; r < rounds && err == ESP_OK; r++ */
+	return err;
+    }; /* run() */
+
+
+    /// report the plain & the packed variants of the payload 'name'
+    esp_err_t report(nvs::stream& space, const char name[], bool string, const std::vector<std::string>& items, unsigned rounds)
+    {
+	    result plain, packed;
+	    esp_err_t err = run(space, false, string, items, rounds, plain);
+	    double kib = double(items[0].size()) * rounds / 1024;
+
+	if (err == ESP_OK)
+	    err = run(space, true, string, items, rounds, packed);
+	if (err != ESP_OK)
+	    return err;
+	printf("%s_plain_bytes %" PRIu64 "\n", name, plain.stored);
+	printf("%s_packed_bytes %" PRIu64 "\n", name, packed.stored);
+	printf("%s_ratio %.2f\n", name, packed.stored? double(plain.stored) / packed.stored: 0.0);
+	printf("%s_saved_pct %.1f\n", name, plain.stored? 100.0 * (double(plain.stored) - packed.stored) / plain.stored: 0.0);
+	printf("%s_plain_write_ns_per_kb %.0f\n", name, plain.write_ns / kib);
+	printf("%s_packed_write_ns_per_kb %.0f\n", name, packed.write_ns / kib);
+	printf("%s_plain_read_ns_per_kb %.0f\n", name, plain.read_ns / kib);
+	printf("%s_packed_read_ns_per_kb %.0f\n", name, packed.read_ns / kib);
+	return ESP_OK;
+    }; /* report() */
+
+}; /* namespace */
+
+
+
+int main(int argc, char* argv[])
+{
+	options opt;
+	int rc;
+
+    if (!bench::parse(argc, argv, {
+	    {"--partition", opt.partition},
+	    {"--size", opt.size},
+	    {"--rounds", opt.rounds},
+	    {"--seed", opt.seed}}))
+	return 2;
+
+    if ((rc = bench::device(opt.partition)) != 0)
+	return rc;
+
+	nvs::stream space("packed", nvs::readwrite);
+	std::mt19937 rnd(opt.seed);
+	size_t text_size = std::min<size_t>(opt.size, 3999);	// the NVS string, the terminating zero included
+	std::vector<std::string> jsons, tables, texts, noises;
+	esp_err_t err = space.status();
+
+    // two variants of each payload: every write changes the item
+    for (int v = 0; v < 2; v++)
+    {
+	jsons.push_back(json(opt.size, rnd));
+	tables.push_back(table(opt.size, rnd));
+	texts.push_back(text(text_size, rnd));
+	noises.push_back(noise(opt.size, rnd));
+    }; /* for int v = 0; v < 2; v++ */
+    printf("payload_bytes %zu\n", opt.size);
+    printf("text_bytes %zu\n", text_size);
+    printf("rounds %u\n", opt.rounds);
+    if (err == ESP_OK)
+	err = report(space, "json", false, jsons, opt.rounds);
+    if (err == ESP_OK)
+	err = report(space, "table", false, tables, opt.rounds);
+    if (err == ESP_OK)
+	err = report(space, "text", true, texts, opt.rounds);
+    if (err == ESP_OK)
+	err = report(space, "random", false, noises, opt.rounds);
+    if (err != ESP_OK)
+    {
+	fprintf(stderr, "Workload failed: %s\n", esp_err_to_name(err));
+	return 1;
+    }; /* if err != ESP_OK */
+    return 0;
+}; /* main() */
@@ -0,0 +1,177 @@
+/* @file
+ * @brief Path keys against the hand-squeezed short keys: reads, storage & the prefix enumeration
+ *
+ * The configuration tree of '--keys' items "device<d>/channel<c>/setting_<i>" (16
+ * devices of 4 channels) is written by the path keys into one namespace and, as
+ * the baseline, by the short keys "d<d>c<c>s<i>" into the other one. Reported are
+ * the flash entries written by each (the creation of the path writes its bucket
+ * & the listing of its directory too, the update - the item only), the time &
+ * the NVS lookups of the read of one item, which do not depend on the size of
+ * the namespace, and the enumeration of one device: by the stream::list() of its
+ * prefix against the baseline scan of the whole namespace by the iterator. The
+ * values read are checked.
+ *
+ * Usage: nvs_paths [--partition bytes] [--keys N] [--iterations N]
+ *
+ * Output is the 'name value' lines, one metric per line.
+ *
+ * @section LICENCE
+ *
+ * This code is in the Public Domain (or CC0 licensed, at your option.)
+ *
+ * Unless required by applicable law or agreed to in writing, this
+ * software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <nvs.h>
+#include <nvs_emul.h>
+
+#include "nvs_device"
+#include "nvstream"
+#include "bench.h"
+
+
+namespace
+{
+
+    struct options
+    {
+	size_t partition = 0x80000;
+	unsigned keys = 1024;
+	unsigned iterations = 20000;
+    }; /* struct options */
+
+
+    nvs::path path_of(unsigned i)
+    {
+	return nvs::path("device" + std::to_string(i % 16)) / ("channel" + std::to_string(i / 16 % 4))
+		/ ("setting_" + std::to_string(i));
+    }; /* path_of() */
+
+    nvs::key key_of(unsigned i)
+    {
+	    char buff[16];
+
+	snprintf(buff, sizeof(buff), "d%xc%xs%u", i % 16, i / 16 % 4, i);
+	return nvs::key(buff);
+    }; /* key_of() */
+
+
+    using clock = std::chrono::steady_clock;
+
+    double ns_since(clock::time_point start, unsigned count)
+    {
+	return double(std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - start).count()) / count;
+    }; /* ns_since() */
+
+}; /* namespace */
+
+
+
+int main(int argc, char* argv[])
+{
+	options opt;
+	int rc;
+
+    if (!bench::parse(argc, argv, {
+	    {"--partition", opt.partition},
+	    {"--keys", opt.keys},
+	    {"--iterations", opt.iterations}}))
+	return 2;
+
+    if ((rc = bench::device(opt.partition)) != 0)
+	return rc;
+
+	nvs::stream tree("tree", nvs::readwrite);
+	nvs::stream flat("flat", nvs::readwrite);
+	esp_err_t err = ESP_OK;
+	uint32_t val = 0;
+
+    // the same items by the path keys & by the short keys
+    nvs_emul::reset_stats();
+    for (unsigned i = 0; i < opt.keys && err == ESP_OK; i++)
+	err = tree.write(path_of(i), uint32_t(i));
+    if (err == ESP_OK)
+	err = tree.commit();
+
+	uint64_t tree_entries = nvs_emul::get_stats().entries_written;
+
+    nvs_emul::reset_stats();
+    for (unsigned i = 0; i < opt.keys && err == ESP_OK; i++)
+	err = flat.write(key_of(i), uint32_t(i));
+    if (err == ESP_OK)
+	err = flat.commit();
+    if (err != ESP_OK)
+    {
+	fprintf(stderr, "Items are not written: %s\n", esp_err_to_name(err));
+	return 1;
+    }; /* if err != ESP_OK */
+    printf("keys %u\n", opt.keys);
+    printf("path_entries_written %" PRIu64 "\n", tree_entries);
+    printf("key_entries_written %" PRIu64 "\n", nvs_emul::get_stats().entries_written);
+
+    // the update of the stored path: its item only
+    nvs_emul::reset_stats();
+    for (unsigned i = 0; i < opt.keys && err == ESP_OK; i++)
+	err = tree.write(path_of(i), uint32_t(i + 1));
+    for (unsigned i = 0; i < opt.keys && err == ESP_OK; i++)
+	err = tree.write(path_of(i), uint32_t(i));
+    printf("path_update_entries_written %.2f\n", double(nvs_emul::get_stats().entries_written) / (2 * opt.keys));
+
+    // read of one item: by the pre-built path & by the short key
+	std::vector<nvs::path> paths;
+
+    for (unsigned i = 0; i < opt.keys; i++)
+	paths.push_back(path_of(i));
+    nvs_emul::reset_stats();
+
+	auto start = clock::now();
+
+    for (unsigned i = 0; i < opt.iterations && err == ESP_OK; i++)
+	if ((err = tree.read(paths[i % opt.keys], val)) == ESP_OK && val != i % opt.keys)
+	    err = ESP_ERR_INVALID_STATE;
+    printf("read_path_ns %.1f\n", ns_since(start, opt.iterations));
+    printf("read_path_lookups %.2f\n", double(nvs_emul::get_stats().lookups) / opt.iterations);
+    nvs_emul::reset_stats();
+    start = clock::now();
+    for (unsigned i = 0; i < opt.iterations && err == ESP_OK; i++)
+	if ((err = flat.read(key_of(i % opt.keys), val)) == ESP_OK && val != i % opt.keys)
+	    err = ESP_ERR_INVALID_STATE;
+    printf("read_key_ns %.1f\n", ns_since(start, opt.iterations));
+    printf("read_key_lookups %.2f\n", double(nvs_emul::get_stats().lookups) / opt.iterations);
+
+    // the items of one device: the listings of its subtree against the scan of the namespace
+	std::vector<nvs::path> items;
+	size_t found = 0;
+
+    nvs_emul::reset_stats();
+    start = clock::now();
+    if (err == ESP_OK)
+	err = tree.list(nvs::path("device3"), items);
+    printf("list_prefix_us %.1f\n", ns_since(start, 1000));
+    printf("list_prefix_items %zu\n", items.size());
+    printf("list_prefix_gets %" PRIu64 "\n", nvs_emul::get_stats().gets);
+    printf("list_prefix_entries_read %" PRIu64 "\n", nvs_emul::get_stats().entries_read);
+    nvs_emul::reset_stats();
+    start = clock::now();
+    for (auto& item: flat)
+	if (strncmp(item.name().c_str(), "d3c", 3) == 0)
+	    found++;
+    printf("scan_prefix_us %.1f\n", ns_since(start, 1000));
+    printf("scan_prefix_items %zu\n", found);
+    printf("scan_prefix_entries_read %" PRIu64 "\n", nvs_emul::get_stats().entries_read);
+    if (err != ESP_OK || items.size() != found)
+    {
+	fprintf(stderr, "Path items are not read back: %s\n", esp_err_to_name(err));
+	return 1;
+    }; /* if err != ESP_OK || ... */
+    return 0;
+}; /* main() */
@@ -0,0 +1,188 @@
+/* @file
+ * @brief Write amplification & commit latency profile of the nvs::stream
+ *
+ * Runs a configuration-like workload over the emulated NVS partition:
+ * a set of integer and string keys, rewritten every round with some share
+ * of the values changed, each round closed by the commit.
+ *
+ * Usage: nvs_profile [--partition bytes] [--keys N] [--rounds N] [--changed percent]
+ *			[--strings percent] [--seed N] [--shadow]
+ *
+ * Output is the 'name value' lines, one metric per line; the build with the
+ * NVS_LATENCY adds the latency histograms of the operations.
+ *
+ * @section LICENCE
+ *
+ * This code is in the Public Domain (or CC0 licensed, at your option.)
+ *
+ * Unless required by applicable law or agreed to in writing, this
+ * software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <nvs.h>
+#include <nvs_emul.h>
+
+#include "nvs_device"
+#include "nvstream"
+#include "bench.h"
+
+
+namespace
+{
+
+    struct options
+    {
+	size_t partition = 0x10000;
+	unsigned keys = 200;
+	unsigned rounds = 50;
+	unsigned changed = 10;		///< percent of the values changed per round
+	unsigned strings = 20;		///< percent of the string keys
+	unsigned seed = 1;
+	nvs::shadow_mode shadow = nvs::noshadow;
+    }; /* struct options */
+
+
+    /// p-th percentile of the samples, 'samples' is reordered
+    uint64_t percentile(std::vector<uint64_t>& samples, unsigned p)
+    {
+	if (samples.empty())
+	    return 0;
+
+	    size_t n = (samples.size() - 1) * p / 100;
+
+	std::nth_element(samples.begin(), samples.begin() + n, samples.end());
+	return samples[n];
+    }; /* percentile() */
+
+
+    void report(const char name[], std::vector<uint64_t>& samples)
+    {
+	printf("%s_p50 %" PRIu64 "\n", name, percentile(samples, 50));
+	printf("%s_p99 %" PRIu64 "\n", name, percentile(samples, 99));
+	printf("%s_max %" PRIu64 "\n", name, samples.empty()? 0: *std::max_element(samples.begin(), samples.end()));
+    }; /* report() */
+
+}; /* namespace */
+
+
+
+int main(int argc, char* argv[])
+{
+	options opt;
+	int rc;
+
+    if (!bench::parse(argc, argv, {
+	    {"--partition", opt.partition},
+	    {"--keys", opt.keys},
+	    {"--rounds", opt.rounds},
+	    {"--changed", opt.changed},
+	    {"--strings", opt.strings},
+	    {"--seed", opt.seed},
+	    {"--shadow", opt.shadow, nvs::shadowed}}))
+	return 2;
+
+    if ((rc = bench::device(opt.partition)) != 0)
+	return rc;
+
+	std::mt19937 rnd(opt.seed);
+	std::vector<std::string> keys;
+	std::vector<uint32_t> ints(opt.keys);
+	std::vector<std::string> strs(opt.keys);
+	std::vector<uint64_t> round_flash, round_wall, commit_wall;
+	nvs::stream space("profile", nvs::readwrite, opt.shadow);
+	esp_err_t err = space.status();
+	uint64_t requested = 0;
+
+    for (unsigned k = 0; k < opt.keys; k++)
+    {
+	keys.push_back("key" + std::to_string(k));
+	strs[k] = "value of the key " + std::to_string(k);
+    }; /* for unsigned k = 0; k < opt.keys; k++ */
+
+    nvs_emul::reset_stats();
+    for (unsigned r = 0; r < opt.rounds && err == ESP_OK; r++)
+    {
+	    uint64_t flash = nvs_emul::get_stats().flash_time_ns;
+	    auto start = std::chrono::steady_clock::now();
+
+	for (unsigned k = 0; k < opt.keys && err == ESP_OK; k++)
+	{
+		bool change = r == 0 || rnd() % 100 < opt.changed;
+
+	    if (k * 100 / opt.keys < opt.strings)
+	    {
+		if (change)
+		    strs[k] = "value " + std::to_string(rnd()) + " of the key " + std::to_string(k);
+		err = space.write<const std::string&>(keys[k], strs[k]);
+	    }
+	    else
+	    {
+		if (change)
+		    ints[k] = rnd();
+		err = space.write<uint32_t>(keys[k], ints[k]);
+	    }; /* else if k * 100 / opt.keys < opt.strings */
+	    requested++;
+	}; /* for unsigned k = 0; k < opt.keys && err == ESP_OK; k++ */
+
+	    auto committing = std::chrono::steady_clock::now();
+
+	if (err == ESP_OK)
+	    err = space.commit();
+
+	    auto end = std::chrono::steady_clock::now();
+
+	round_wall.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+	commit_wall.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(end - committing).count());
+	round_flash.push_back(nvs_emul::get_stats().flash_time_ns - flash);
+    }; /* for unsigned r = 0; r < opt.rounds && err == ESP_OK; r++ */
+
+    if (err != ESP_OK)
+    {
+	fprintf(stderr, "Workload failed: %s\n", esp_err_to_name(err));
+	return 1;
+    }; /* if err != ESP_OK */
+
+	nvs_emul::stats st = nvs_emul::get_stats();
+
+    printf("partition_bytes %zu\n", opt.partition);
+    printf("keys %u\n", opt.keys);
+    printf("rounds %u\n", opt.rounds);
+    printf("writes_requested %" PRIu64 "\n", requested);
+    printf("nvs_lookups %" PRIu64 "\n", st.lookups);
+    printf("nvs_sets %" PRIu64 "\n", st.sets);
+    printf("nvs_sets_unchanged %" PRIu64 "\n", st.sets_unchanged);
+    printf("nvs_commits %" PRIu64 "\n", st.commits);
+    printf("payload_bytes %" PRIu64 "\n", st.payload_bytes);
+    printf("entries_written %" PRIu64 "\n", st.entries_written);
+    printf("entries_relocated %" PRIu64 "\n", st.entries_relocated);
+    printf("gc_runs %" PRIu64 "\n", st.gc_runs);
+    printf("page_erases %" PRIu64 "\n", st.page_erases);
+    printf("max_page_erases %" PRIu32 "\n", nvs_emul::max_page_erases());
+    printf("write_amplification %.3f\n", st.write_amplification());
+    report("round_flash_ns", round_flash);
+    report("round_wall_ns", round_wall);
+    report("commit_wall_ns", commit_wall);
+    // latency histograms of the operations, with the NVS_LATENCY build only
+    for (int op = 0; nvs::latency::compiled && op < nvs::latency::ops; op++)
+    {
+	    nvs::latency::histogram h = nvs::latency::get(nvs::latency::op(op));
+
+	if (h.count == 0)
+	    continue;
+	printf("latency_%s_count %" PRIu32 "\n", nvs::latency::name(nvs::latency::op(op)), h.count);
+	printf("latency_%s_p50_ns %" PRIu32 "\n", nvs::latency::name(nvs::latency::op(op)), h.percentile(50));
+	printf("latency_%s_p99_ns %" PRIu32 "\n", nvs::latency::name(nvs::latency::op(op)), h.percentile(99));
+	printf("latency_%s_max_ns %" PRIu32 "\n", nvs::latency::name(nvs::latency::op(op)), h.max_ns);
+    }; /* for int op = 0; ... */
+    return 0;
+}; /* main() */
@@ -0,0 +1,122 @@
+/* @file
+ * @brief Short-lived streams of the request handlers: the pooled namespace handles
+ *
+ * Each "request" constructs the nvs::stream of one of the namespaces, reads
+ * a few keys and destroys the stream, as the HTTP or the console handlers do.
+ * The namespace handles are reused by the nvs::pool; '--no-pool' sets the
+ * idle limit to 0, so every stream opens and closes its handle, as before the pool.
+ *
+ * Usage: nvs_requests [--requests N] [--spaces N] [--reads N] [--no-pool]
+ *
+ * Output is the 'name value' lines, one metric per line.
+ *
+ * @section LICENCE
+ *
+ * This code is in the Public Domain (or CC0 licensed, at your option.)
+ *
+ * Unless required by applicable law or agreed to in writing, this
+ * software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include <nvs.h>
+#include <nvs_emul.h>
+
+#include "nvs_device"
+#include "nvstream"
+#include "bench.h"
+
+
+namespace
+{
+
+    struct options
+    {
+	unsigned requests = 10000;
+	unsigned spaces = 4;		///< namespaces used by the handlers
+	unsigned reads = 3;		///< keys read by one request
+	bool nopool = false;		///< close the handle at the end of each request
+    }; /* struct options */
+
+
+}; /* namespace */
+
+
+
+int main(int argc, char* argv[])
+{
+	options opt;
+	int rc;
+	std::vector<std::string> spaces;
+	esp_err_t err = ESP_OK;
+
+    if (!bench::parse(argc, argv, {
+	    {"--requests", opt.requests},
+	    {"--spaces", opt.spaces},
+	    {"--reads", opt.reads},
+	    {"--no-pool", opt.nopool}}))
+	return 2;
+
+    if ((rc = bench::device()) != 0)
+	return rc;
+    if (opt.nopool)
+	nvs::pool::idle_limit(0);
+
+    for (unsigned s = 0; s < opt.spaces && err == ESP_OK; s++)
+    {
+	spaces.push_back("handler" + std::to_string(s));
+
+	    nvs::stream space(spaces[s], nvs::readwrite);
+
+	for (unsigned k = 0; k < opt.reads && err == ESP_OK; k++)
+	    err = space.write<uint32_t>("opt" + std::to_string(k), s * 100 + k);
+	if (err == ESP_OK)
+	    err = space.commit();
+    }; /* for unsigned s = 0; s < opt.spaces && err == ESP_OK; s++ */
+    if (err != ESP_OK)
+    {
+	fprintf(stderr, "Namespace fill failed: %s\n", esp_err_to_name(err));
+	return 1;
+    }; /* if err != ESP_OK */
+
+    nvs::pool::reset_stats();
+    nvs_emul::reset_stats();
+
+	unsigned failures = 0;
+	auto start = std::chrono::steady_clock::now();
+
+    for (unsigned r = 0; r < opt.requests; r++)
+    {
+	    unsigned s = r % opt.spaces;
+	    nvs::stream space(spaces[s], nvs::readonly);
+
+	for (unsigned k = 0; k < opt.reads; k++)
+	{
+		uint32_t val = 0;
+
+	    if (space.read("opt" + std::to_string(k), val) != ESP_OK || val != s * 100 + k)
+		failures++;
+	}; /* for unsigned k = 0; k < opt.reads; k++ */
+    }; /* for unsigned r = 0; r < opt.requests; r++ */
+
+	auto end = std::chrono::steady_clock::now();
+	nvs::pool::stats st = nvs::pool::get_stats();
+
+    printf("mode %s\n", opt.nopool? "no_pool": "pool");
+    printf("requests %u\n", opt.requests);
+    printf("pool_opens %" PRIu32 "\n", st.opens);
+    printf("pool_reuses %" PRIu32 "\n", st.reuses);
+    printf("pool_closes %" PRIu32 "\n", st.closes);
+    printf("pool_idle %" PRIu32 "\n", st.idle);
+    printf("nvs_opens %" PRIu64 "\n", nvs_emul::get_stats().opens);
+    printf("request_wall_ns %" PRIu64 "\n",
+	    uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count() / (opt.requests? opt.requests: 1)));
+    printf("failures %u\n", failures);
+    return failures? 1: 0;
+}; /* main() */
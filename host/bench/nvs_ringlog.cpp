@@ -0,0 +1,150 @@
+/* @file
+ * @brief Append cost of the ring log in the NVS namespace: single & batched appends
+ *
+ * The fault records of the fixed size are appended to the nvs::ring_log of the
+ * '--capacity' records, by one or by the '--batch' records per commit. Reported
+ * are the NVS operations & the flash entries per record, the append time, the
+ * lookups of the reopening and the records read back by the iterator, which
+ * are checked: the newest ones, from the oldest to the newest.
+ *
+ * Usage: nvs_ringlog [--partition bytes] [--capacity N] [--records N] [--batch N] [--size bytes]
+ *
+ * Output is the 'name value' lines, one metric per line.
+ *
+ * @section LICENCE
+ *
+ * This code is in the Public Domain (or CC0 licensed, at your option.)
+ *
+ * Unless required by applicable law or agreed to in writing, this
+ * software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <nvs.h>
+#include <nvs_emul.h>
+
+#include "nvs_device"
+#include "nvstream"
+#include "bench.h"
+
+
+namespace
+{
+
+    struct options
+    {
+	size_t partition = 0x10000;
+	uint32_t capacity = 64;		///< records kept by the log
+	unsigned records = 2000;	///< records appended
+	unsigned batch = 1;		///< records per commit
+	size_t size = 48;		///< bytes of the record
+    }; /* struct options */
+
+
+    /// the record 'n': its number, then the pattern
+    std::vector<uint8_t> fault(unsigned n, size_t size)
+    {
+	    std::vector<uint8_t> rec(size);
+
+	memcpy(rec.data(), &n, sizeof(n));
+	for (size_t i = sizeof(n); i < size; i++)
+	    rec[i] = uint8_t(n + i);
+	return rec;
+    }; /* fault() */
+
+}; /* namespace */
+
+
+
+int main(int argc, char* argv[])
+{
+	options opt;
+	int rc;
+
+    if (!bench::parse(argc, argv, {
+	    {"--partition", opt.partition},
+	    {"--capacity", opt.capacity},
+	    {"--records", opt.records},
+	    {"--batch", opt.batch},
+	    {"--size", opt.size}}))
+	return 2;
+
+    if ((rc = bench::device(opt.partition)) != 0)
+	return rc;
+
+	nvs::stream space("faults", nvs::readwrite);
+	esp_err_t err = space.status();
+	uint64_t append_ns = 0;
+
+    nvs_emul::reset_stats();
+    {
+	    nvs::ring_log log(space, "log", opt.capacity);
+
+	for (unsigned n = 0; n < opt.records && err == ESP_OK; )
+	{
+		auto start = std::chrono::steady_clock::now();
+
+	    if (opt.batch == 1)
+		err = log.append(fault(n++, opt.size).data(), opt.size);
+	    else
+	    {
+		    nvs::ring_log::batch many(log);
+
+		for (unsigned b = 0; b < opt.batch && n < opt.records && err == ESP_OK; b++)
+		    err = many.append(fault(n++, opt.size).data(), opt.size);
+		if (err == ESP_OK)
+		    err = many.commit();
+	    }; /* else if opt.batch == 1 */
+	    append_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+	}; /* for unsigned n = 0; n < opt.records && err == ESP_OK; */
+    }
+    if (err != ESP_OK)
+    {
+	fprintf(stderr, "Append failed: %s\n", esp_err_to_name(err));
+	return 1;
+    }; /* if err != ESP_OK */
+
+	nvs_emul::stats st = nvs_emul::get_stats();
+
+    printf("capacity %" PRIu32 "\n", opt.capacity);
+    printf("records %u\n", opt.records);
+    printf("batch %u\n", opt.batch);
+    printf("record_bytes %zu\n", opt.size);
+    printf("sets_per_record %.2f\n", double(st.sets) / opt.records);
+    printf("gets_per_record %.2f\n", double(st.gets) / opt.records);
+    printf("commits_per_record %.2f\n", double(st.commits) / opt.records);
+    printf("entries_per_record %.2f\n", double(st.entries_written) / opt.records);
+    printf("page_erases %" PRIu64 "\n", st.page_erases);
+    printf("append_ns_per_record %" PRIu64 "\n", append_ns / opt.records);
+
+    // reopening after the reboot: one read of the index; then the records, checked
+    nvs_emul::reset_stats();
+
+	nvs::ring_log log(space, "log", opt.capacity);
+	uint64_t open_gets = nvs_emul::get_stats().gets;
+	unsigned expect = opt.records - std::min<unsigned>(opt.records, opt.capacity);
+	unsigned read = 0;
+	auto it = log.begin();
+
+    for (; it != log.end(); ++it, ++read)
+	if (it->data != fault(expect + read, opt.size))
+	{
+	    fprintf(stderr, "Record %" PRIu32 " is wrong\n", it->seq);
+	    return 1;
+	}; /* if it->data != fault(expect + read, opt.size) */
+    printf("open_gets %" PRIu64 "\n", open_gets);
+    printf("records_read %u\n", read);
+    if (it.status() != ESP_OK || read != std::min<unsigned>(opt.records, opt.capacity))
+    {
+	fprintf(stderr, "Log is not read back: %u records, %s\n", read, esp_err_to_name(it.status()));
+	return 1;
+    }; /* if it.status() != ESP_OK || ... */
+    return 0;
+}; /* main() */
@@ -0,0 +1,239 @@
+/* @file
+ * @brief Export & restore of the namespace snapshot against the key by key copy
+ *
+ * The namespace of '--keys' items of the mixed types (integers, strings, small
+ * blobs) is exported by the stream::export_snapshot() into the file, which is
+ * mapped into memory by the nvs::snapshot::mapped and restored by the
+ * stream::import_snapshot() into the empty namespace, then once more over the
+ * restored one (nothing changes). The baseline is the custom code: the items
+ * loaded by the stream::load() & written by the stream::write() one by one,
+ * committed once. Reported are the snapshot size, the times of the export &
+ * of the restores (the CPU; the flash time is modelled separately), the NVS
+ * operations of each restore; the restored namespaces are checked.
+ *
+ * Usage: nvs_snapshot [--partition bytes] [--keys N] [--file path]
+ *
+ * Output is the 'name value' lines, one metric per line.
+ *
+ * @section LICENCE
+ *
+ * This code is in the Public Domain (or CC0 licensed, at your option.)
+ *
+ * Unless required by applicable law or agreed to in writing, this
+ * software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <map>
+#include <string>
+#include <variant>
+#include <vector>
+
+#include <nvs.h>
+#include <nvs_emul.h>
+
+#include "nvs_device"
+#include "nvstream"
+#include "bench.h"
+
+
+namespace
+{
+
+    struct options
+    {
+	size_t partition = 0x40000;
+	unsigned keys = 500;
+	std::string file = "/tmp/nvs_snapshot.bin";
+    }; /* struct options */
+
+
+    /// the configuration: 60% integers of all widths, 25% strings, 15% blobs of 64 bytes
+    esp_err_t fill(nvs::stream& space, unsigned keys)
+    {
+	    char name[16];
+	    esp_err_t err = ESP_OK;
+
+	for (unsigned i = 0; i < keys && err == ESP_OK; i++)
+	{
+	    snprintf(name, sizeof(name), "cfg%05u", i);
+	    switch (i % 20)
+	    {
+	    case 0: case 1: case 2: case 3: case 4:
+		err = space.write(name, "value of the setting " + std::to_string(i));
+		break;
+	    case 5: case 6: case 7:
+	    {
+		    std::vector<uint8_t> blob(64);
+
+		for (size_t b = 0; b < blob.size(); b++)
+		    blob[b] = uint8_t(i + b);
+		err = space.write_blob(name, blob.data(), blob.size());
+		break;
+	    }
+	    case 8: case 9: case 10:
+		err = space.write(name, uint8_t(i));
+		break;
+	    case 11: case 12: case 13:
+		err = space.write(name, int16_t(-int(i)));
+		break;
+	    case 14: case 15: case 16: case 17:
+		err = space.write(name, uint32_t(i * 1000));
+		break;
+	    default:
+		err = space.write(name, int64_t(i) * -100000000);
+		break;
+	    }; /* switch i % 20 */
+	}; /* for unsigned i = 0; i < keys && err == ESP_OK; i++ */
+	return (err == ESP_OK)? space.commit(): err;
+    }; /* fill() */
+
+
+    using clock = std::chrono::steady_clock;
+
+    uint64_t since(clock::time_point start)
+    {
+	return std::chrono::duration_cast<std::chrono::microseconds>(clock::now() - start).count();
+    }; /* since() */
+
+
+    /// the NVS operations since the last reset
+    void report(const char prefix[], uint64_t us)
+    {
+	    nvs_emul::stats st = nvs_emul::get_stats();
+
+	printf("%s_us %" PRIu64 "\n", prefix, us);
+	printf("%s_sets %" PRIu64 "\n", prefix, st.sets);
+	printf("%s_sets_unchanged %" PRIu64 "\n", prefix, st.sets_unchanged);
+	printf("%s_gets %" PRIu64 "\n", prefix, st.gets);
+	printf("%s_commits %" PRIu64 "\n", prefix, st.commits);
+	printf("%s_flash_ms %.1f\n", prefix, st.flash_time_ns / 1e6);
+    }; /* report() */
+
+
+    /// the same items in both namespaces
+    bool same(nvs::stream& a, nvs::stream& b)
+    {
+	    std::map<nvs::key, nvs::value> left, right;
+
+	return a.load(left) == ESP_OK && b.load(right) == ESP_OK && left == right;
+    }; /* same() */
+
+}; /* namespace */
+
+
+
+int main(int argc, char* argv[])
+{
+	options opt;
+	int rc;
+
+    if (!bench::parse(argc, argv, {
+	    {"--partition", opt.partition},
+	    {"--keys", opt.keys},
+	    {"--file", opt.file}}))
+	return 2;
+
+    if ((rc = bench::device(opt.partition)) != 0)
+	return rc;
+
+	nvs::stream config("config", nvs::readwrite);
+	nvs::stream restored("restored", nvs::readwrite);
+	nvs::stream manual("manual", nvs::readwrite);
+	std::vector<uint8_t> image;
+	nvs::snapshot::buffer sink(image);
+	esp_err_t err = fill(config, opt.keys);
+	FILE* f;
+
+    if (err != ESP_OK)
+    {
+	fprintf(stderr, "Namespace is not filled: %s\n", esp_err_to_name(err));
+	return 1;
+    }; /* if err != ESP_OK */
+
+    // export: into the memory & into the file
+	auto start = clock::now();
+
+    err = config.export_snapshot(sink);
+
+	uint64_t export_us = since(start);
+
+    if (err == ESP_OK && (f = fopen(opt.file.c_str(), "wb")) != nullptr)
+    {
+	    nvs::snapshot::file out(f);
+
+	err = config.export_snapshot(out);
+	fclose(f);
+    }
+    else if (err == ESP_OK)
+	err = ESP_ERR_NOT_FOUND;
+    if (err != ESP_OK)
+    {
+	fprintf(stderr, "Export failed: %s\n", esp_err_to_name(err));
+	return 1;
+    }; /* if err != ESP_OK */
+    printf("keys %u\n", opt.keys);
+    printf("snapshot_bytes %zu\n", image.size());
+    printf("bytes_per_key %.1f\n", double(image.size()) / opt.keys);
+    printf("export_us %" PRIu64 "\n", export_us);
+
+    // restore from the mapped file: into the empty namespace, then over the same items
+    for (const char* pass: {"restore", "restore_unchanged"})
+    {
+	    nvs::snapshot::mapped in(opt.file);
+
+	nvs_emul::reset_stats();
+	start = clock::now();
+	if ((err = in.status()) == ESP_OK)
+	    err = restored.import_snapshot(in);
+	report(pass, since(start));
+	if (err != ESP_OK || !same(config, restored))
+	{
+	    fprintf(stderr, "Snapshot is not restored: %s\n", esp_err_to_name(err));
+	    return 1;
+	}; /* if err != ESP_OK || ... */
+    }; /* for const char* pass: {...} */
+
+    // baseline: the key by key copy
+	std::map<nvs::key, nvs::value> items;
+
+    nvs_emul::reset_stats();
+    start = clock::now();
+    err = config.load(items);
+    for (auto it = items.begin(); it != items.end() && err == ESP_OK; it++)
+	err = std::visit([&](auto& val) -> esp_err_t
+	    {
+		using T = std::decay_t<decltype(val)>;
+
+		if constexpr (std::is_same_v<T, std::monostate>)
+		    return ESP_ERR_NVS_TYPE_MISMATCH;
+		else if constexpr (std::is_same_v<T, std::vector<uint8_t>>)
+		    return manual.write_blob(it->first, val.data(), val.size());
+		else
+		    return manual.write(it->first, val);
+	    }, it->second);
+    if (err == ESP_OK)
+	err = manual.commit();
+    report("key_by_key", since(start));
+    if (err != ESP_OK || !same(config, manual))
+    {
+	fprintf(stderr, "Key by key copy failed: %s\n", esp_err_to_name(err));
+	return 1;
+    }; /* if err != ESP_OK || ... */
+
+    // the damaged snapshot is rejected before the first write
+    image[image.size() / 2] ^= 0x55;
+    {
+	    nvs::snapshot::memory in(image);
+
+	nvs_emul::reset_stats();
+	err = restored.import_snapshot(in);
+	printf("damaged_status %s\n", esp_err_to_name(err));
+	printf("damaged_sets %" PRIu64 "\n", nvs_emul::get_stats().sets);
+    }
+    remove(opt.file.c_str());
+    return 0;
+}; /* main() */
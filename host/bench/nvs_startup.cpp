@@ -0,0 +1,180 @@
+/* @file
+ * @brief Startup load profile of the nvs::stream: per-key reads vs. the one-sweep loaders
+ *
+ * The namespace holds a configuration table of integer and string keys,
+ * part of them stored (others are left at the defaults, as the firmware
+ * stores only the changed values). The table is loaded at "boot" by:
+ *
+ *	per_key	- stream::read() of each key of the table
+ *	table	- stream::load() of the nvs::binding table
+ *	map	- stream::load() of all the entries into the std::map
+ *
+ * Usage: nvs_startup [--partition bytes] [--keys N] [--stored percent] [--strings percent]
+ *
+ * Output is the 'name value' lines, one metric per line.
+ *
+ * @section LICENCE
+ *
+ * This code is in the Public Domain (or CC0 licensed, at your option.)
+ *
+ * Unless required by applicable law or agreed to in writing, this
+ * software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <array>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <nvs.h>
+#include <nvs_emul.h>
+
+#include "nvs_device"
+#include "nvstream"
+#include "bench.h"
+
+
+namespace
+{
+
+    struct options
+    {
+	size_t partition = 0x10000;
+	unsigned keys = 300;
+	unsigned stored = 60;		///< percent of the table keys, stored in the namespace
+	unsigned strings = 20;		///< percent of the string keys
+    }; /* struct options */
+
+
+    /// The configuration table: the integer or the string value of each key
+    struct table
+    {
+	std::vector<std::string> names;
+	std::vector<uint32_t> ints;
+	std::vector<std::array<char, 32>> strs;
+	std::vector<bool> is_str;
+    }; /* struct table */
+
+
+    /// Run the 'load' on the freshly opened stream, print its metrics with the prefix 'name';
+    /// return the number of the items loaded
+    template <typename Load>
+    unsigned measure(const char name[], Load&& load)
+    {
+		nvs::stream space("config", nvs::readonly);
+		nvs_emul::stats before = nvs_emul::get_stats();
+		auto start = std::chrono::steady_clock::now();
+		unsigned loaded = load(space);
+		auto end = std::chrono::steady_clock::now();
+		nvs_emul::stats after = nvs_emul::get_stats();
+
+	printf("%s_loaded %u\n", name, loaded);
+	printf("%s_lookups %" PRIu64 "\n", name, after.lookups - before.lookups);
+	printf("%s_entries_read %" PRIu64 "\n", name, after.entries_read - before.entries_read);
+	printf("%s_flash_ns %" PRIu64 "\n", name, after.flash_time_ns - before.flash_time_ns);
+	printf("%s_wall_ns %" PRIu64 "\n", name,
+		uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count()));
+	return loaded;
+    }; /* measure() */
+
+}; /* namespace */
+
+
+
+int main(int argc, char* argv[])
+{
+	options opt;
+	int rc;
+
+    if (!bench::parse(argc, argv, {
+	    {"--partition", opt.partition},
+	    {"--keys", opt.keys},
+	    {"--stored", opt.stored},
+	    {"--strings", opt.strings}}))
+	return 2;
+
+    if ((rc = bench::device(opt.partition)) != 0)
+	return rc;
+
+	table tbl;
+	esp_err_t err = ESP_OK;
+
+    // fill the namespace: every key of the table is stored with the 'stored' share
+    {
+	    nvs::stream space("config", nvs::readwrite);
+
+	for (unsigned k = 0; k < opt.keys && err == ESP_OK; k++)
+	{
+		bool str = k * 100 / opt.keys < opt.strings;
+
+	    tbl.names.push_back("cfg" + std::to_string(k));
+	    tbl.is_str.push_back(str);
+	    tbl.ints.push_back(0);
+	    tbl.strs.push_back({});
+	    if ((k * 37) % 100 >= opt.stored)
+		continue;
+	    if (str)
+		err = space.write<const std::string&>(tbl.names[k], "value of the key " + std::to_string(k));
+	    else
+		err = space.write<uint32_t>(tbl.names[k], k * 1000 + 1);
+	}; /* for unsigned k = 0; k < opt.keys && err == ESP_OK; k++ */
+	if (err == ESP_OK)
+	    err = space.commit();
+    }
+    if (err != ESP_OK)
+    {
+	fprintf(stderr, "Namespace fill failed: %s\n", esp_err_to_name(err));
+	return 1;
+    }; /* if err != ESP_OK */
+
+    printf("partition_bytes %zu\n", opt.partition);
+    printf("keys %u\n", opt.keys);
+    printf("stored_percent %u\n", opt.stored);
+
+	unsigned per_key = measure("per_key", [&](nvs::stream& space) {
+		unsigned loaded = 0;
+
+	    for (unsigned k = 0; k < opt.keys; k++)
+	    {
+		    size_t length = tbl.strs[k].size();
+
+		if (tbl.is_str[k])
+		    loaded += space.read_str(tbl.names[k], tbl.strs[k].data(), length) == ESP_OK;
+		else
+		    loaded += space.read(tbl.names[k], tbl.ints[k]) == ESP_OK;
+	    }; /* for unsigned k = 0; k < opt.keys; k++ */
+	    return loaded;
+	});
+
+	std::vector<nvs::binding> bindings;
+
+    for (unsigned k = 0; k < opt.keys; k++)
+	bindings.push_back(tbl.is_str[k]? nvs::bind_str(tbl.names[k], tbl.strs[k].data(), tbl.strs[k].size()):
+					    nvs::bind(tbl.names[k], tbl.ints[k]));
+
+	unsigned table = measure("table", [&](nvs::stream& space) {
+		unsigned loaded = 0;
+
+	    space.load(bindings.data(), bindings.size());
+	    for (auto& b: bindings)
+		loaded += b.err == ESP_OK;
+	    return loaded;
+	});
+	unsigned map = measure("map", [&](nvs::stream& space) {
+		std::map<nvs::key, nvs::value> items;
+
+	    space.load(items);
+	    return unsigned(items.size());
+	});
+
+    if (table != per_key || map != per_key)
+    {
+	fprintf(stderr, "Loaders disagree: per_key %u, table %u, map %u\n", per_key, table, map);
+	return 1;
+    }; /* if table != per_key || map != per_key */
+    return 0;
+}; /* main() */
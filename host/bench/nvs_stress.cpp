@@ -0,0 +1,187 @@
+/* @file
+ * @brief Concurrency stress of the nvs::stream in the 'multi_task' mode
+ *
+ * Several threads share one shadowed stream: each thread reads & rewrites
+ * its own keys and the keys shared by all threads, most of the writes are
+ * unchanged values (as the periodic configuration save). The run is repeated
+ * for 1, 2, 4 ... threads; the own keys of each thread are verified at the end
+ * by the fresh stream. The '--baseline' runs the 'single_task' stream under
+ * one global mutex, as the callers had to do before.
+ *
+ * Usage: nvs_stress [--threads N] [--ops N] [--keys N] [--shared N] [--write percent]
+ *			[--change percent] [--baseline]
+ *
+ * Output is the 'name value' lines, one metric per line. Build with the
+ * NVS_SANITIZE_THREAD=ON to run it under the ThreadSanitizer.
+ *
+ * @section LICENCE
+ *
+ * This code is in the Public Domain (or CC0 licensed, at your option.)
+ *
+ * Unless required by applicable law or agreed to in writing, this
+ * software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <nvs.h>
+
+#include "nvs_device"
+#include "nvstream"
+#include "bench.h"
+
+
+namespace
+{
+
+    struct options
+    {
+	unsigned threads = 8;		///< the largest number of the threads
+	unsigned ops = 20000;		///< operations per thread
+	unsigned keys = 16;		///< own keys of each thread
+	unsigned shared = 8;		///< keys shared by all the threads
+	unsigned write = 30;		///< percent of the writes
+	unsigned change = 2;		///< percent of the writes with the changed value
+	bool baseline = false;		///< 'single_task' stream under the global mutex
+    }; /* struct options */
+
+
+    std::string own_key(unsigned thread, unsigned k) { return "t" + std::to_string(thread) + "k" + std::to_string(k); };
+    std::string shared_key(unsigned k) { return "s" + std::to_string(k); };
+
+
+    /// Workload of one thread; 'values' - the last values of its own keys
+    void worker(const options& opt, nvs::stream& space, std::mutex* global, unsigned id,
+		std::vector<uint32_t>& values, std::atomic<unsigned>& failures)
+    {
+	    std::mt19937 rnd(id + 1);
+	    std::vector<nvs::key> own, common;
+
+	for (unsigned k = 0; k < opt.keys; k++)
+	    own.push_back(own_key(id, k));
+	for (unsigned k = 0; k < opt.shared; k++)
+	    common.push_back(shared_key(k));
+	for (unsigned n = 0; n < opt.ops; n++)
+	{
+		bool is_own = rnd() % 2;
+		unsigned k = rnd() % (is_own? opt.keys: opt.shared);
+		const nvs::key& name = is_own? own[k]: common[k];
+		uint32_t val = is_own? values[k]: k;
+		esp_err_t rc;
+		std::unique_lock<std::mutex> guard;
+
+	    if (global)
+		guard = std::unique_lock<std::mutex>(*global);
+	    if (rnd() % 100 >= opt.write)
+	    {
+		    uint32_t got = 0;
+
+		rc = space.read(name, got);
+		if (rc == ESP_OK && got != val)
+		    rc = ESP_ERR_INVALID_STATE;
+	    }
+	    else
+	    {
+		if (is_own && rnd() % 100 < opt.change)
+		    values[k] = val = rnd();
+		rc = space.write(name, val);
+	    }; /* else if rnd() % 100 >= opt.write */
+	    if (rc != ESP_OK)
+		failures++;
+	}; /* for unsigned n = 0; n < opt.ops; n++ */
+    }; /* worker() */
+
+
+    /// Run the workload by 'threads' threads, return the operations per second
+    double run(const options& opt, unsigned threads, unsigned& failures)
+    {
+		nvs::stream space("stress", nvs::readwrite, nvs::shadowed, opt.baseline? nvs::single_task: nvs::multi_task);
+		std::mutex global;
+		std::vector<std::vector<uint32_t>> values(threads, std::vector<uint32_t>(opt.keys));
+		std::vector<std::thread> pool;
+		std::atomic<unsigned> failed{0};
+
+	// initial values of all the keys
+	for (unsigned t = 0; t < threads; t++)
+	    for (unsigned k = 0; k < opt.keys; k++)
+		space.write<uint32_t>(own_key(t, k), values[t][k] = t * 1000 + k);
+	for (unsigned k = 0; k < opt.shared; k++)
+	    space.write<uint32_t>(shared_key(k), k);
+	space.commit();
+
+	    auto start = std::chrono::steady_clock::now();
+
+	for (unsigned t = 0; t < threads; t++)
+	    pool.emplace_back(worker, std::cref(opt), std::ref(space), opt.baseline? &global: nullptr, t,
+				std::ref(values[t]), std::ref(failed));
+	for (auto& th: pool)
+	    th.join();
+
+	    auto end = std::chrono::steady_clock::now();
+	    double secs = std::chrono::duration<double>(end - start).count();
+
+	space.commit();
+	space.close();
+
+	// the own keys hold the last written values, as seen by the fresh stream
+	    nvs::stream check("stress", nvs::readonly);
+
+	for (unsigned t = 0; t < threads; t++)
+	    for (unsigned k = 0; k < opt.keys; k++)
+	    {
+		    uint32_t got = 0;
+
+		if (check.read(own_key(t, k), got) != ESP_OK || got != values[t][k])
+		    failed++;
+	    }; /* for unsigned k = 0; k < opt.keys; k++ */
+	failures = failed;
+	return (secs > 0)? threads * double(opt.ops) / secs: 0;
+    }; /* run() */
+
+}; /* namespace */
+
+
+
+int main(int argc, char* argv[])
+{
+	options opt;
+	int rc;
+	unsigned failures = 0;
+	double single = 0;
+
+    if (!bench::parse(argc, argv, {
+	    {"--threads", opt.threads},
+	    {"--ops", opt.ops},
+	    {"--keys", opt.keys},
+	    {"--shared", opt.shared},
+	    {"--write", opt.write},
+	    {"--change", opt.change},
+	    {"--baseline", opt.baseline}}))
+	return 2;
+
+    if ((rc = bench::device()) != 0)
+	return rc;
+
+    printf("mode %s\n", opt.baseline? "global_mutex": "multi_task");
+    printf("hardware_threads %u\n", std::thread::hardware_concurrency());
+    for (unsigned threads = 1; threads <= opt.threads && failures == 0; threads *= 2)
+    {
+	    double rate = run(opt, threads, failures);
+
+	if (threads == 1)
+	    single = rate;
+	printf("threads_%u_ops_per_sec %.0f\n", threads, rate);
+	printf("threads_%u_speedup %.2f\n", threads, single? rate / single: 0);
+    }; /* for unsigned threads = 1; ... */
+    printf("failures %u\n", failures);
+    return failures? 1: 0;
+}; /* main() */
@@ -0,0 +1,102 @@
+/* @file
+ * @brief Host (Linux) implementation of the ESP-IDF logging & error naming
+ *
+ * @section LICENCE
+ *
+ * This code is in the Public Domain (or CC0 licensed, at your option.)
+ *
+ * Unless required by applicable law or agreed to in writing, this
+ * software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <atomic>
+#include <cstdio>
+#include <cstdarg>
+
+#include <esp_err.h>
+#include <esp_log.h>
+#include <nvs.h>
+
+
+namespace
+{
+
+    std::atomic<esp_log_level_t> runtime_level{ESP_LOG_INFO};
+
+    const char letter[] = "NEWIDV";
+
+}; /* namespace */
+
+
+extern "C"
+{
+
+void esp_log_level_set(const char *tag, esp_log_level_t level)
+{
+    (void)tag;
+    runtime_level = level;
+} /* esp_log_level_set() */
+
+esp_log_level_t esp_log_level_get(const char *tag)
+{
+    (void)tag;
+    return runtime_level;
+} /* esp_log_level_get() */
+
+void esp_log_write(esp_log_level_t level, const char *tag, const char *format, ...)
+{
+	va_list args;
+	char line[512];
+
+    if (level > runtime_level)
+	return;
+    va_start(args, format);
+    vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+    fprintf(stderr, "%c (%s): %s\n", letter[level], tag, line);
+} /* esp_log_write() */
+
+
+const char *esp_err_to_name(esp_err_t code)
+{
+#define ERR_NAME(e) case e: return #e
+    switch (code)
+    {
+	ERR_NAME(ESP_OK);
+	ERR_NAME(ESP_FAIL);
+	ERR_NAME(ESP_ERR_NO_MEM);
+	ERR_NAME(ESP_ERR_INVALID_ARG);
+	ERR_NAME(ESP_ERR_INVALID_STATE);
+	ERR_NAME(ESP_ERR_INVALID_SIZE);
+	ERR_NAME(ESP_ERR_NOT_FOUND);
+	ERR_NAME(ESP_ERR_NOT_SUPPORTED);
+	ERR_NAME(ESP_ERR_TIMEOUT);
+	ERR_NAME(ESP_ERR_INVALID_RESPONSE);
+	ERR_NAME(ESP_ERR_INVALID_CRC);
+	ERR_NAME(ESP_ERR_INVALID_VERSION);
+	ERR_NAME(ESP_ERR_INVALID_MAC);
+	ERR_NAME(ESP_ERR_NOT_FINISHED);
+	ERR_NAME(ESP_ERR_NVS_NOT_INITIALIZED);
+	ERR_NAME(ESP_ERR_NVS_NOT_FOUND);
+	ERR_NAME(ESP_ERR_NVS_TYPE_MISMATCH);
+	ERR_NAME(ESP_ERR_NVS_READ_ONLY);
+	ERR_NAME(ESP_ERR_NVS_NOT_ENOUGH_SPACE);
+	ERR_NAME(ESP_ERR_NVS_INVALID_NAME);
+	ERR_NAME(ESP_ERR_NVS_INVALID_HANDLE);
+	ERR_NAME(ESP_ERR_NVS_REMOVE_FAILED);
+	ERR_NAME(ESP_ERR_NVS_KEY_TOO_LONG);
+	ERR_NAME(ESP_ERR_NVS_PAGE_FULL);
+	ERR_NAME(ESP_ERR_NVS_INVALID_STATE);
+	ERR_NAME(ESP_ERR_NVS_INVALID_LENGTH);
+	ERR_NAME(ESP_ERR_NVS_NO_FREE_PAGES);
+	ERR_NAME(ESP_ERR_NVS_VALUE_TOO_LONG);
+	ERR_NAME(ESP_ERR_NVS_PART_NOT_FOUND);
+	ERR_NAME(ESP_ERR_NVS_NEW_VERSION_FOUND);
+    default:
+	return "UNKNOWN ERROR";
+    }; /* switch code */
+#undef ERR_NAME
+} /* esp_err_to_name() */
+
+} /* extern "C" */
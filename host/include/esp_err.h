@@ -0,0 +1,58 @@
+/* @file
+ * @brief Host (Linux) stand-in for the ESP-IDF 'esp_err.h'
+ *
+ * @section LICENCE
+ *
+ * This code is in the Public Domain (or CC0 licensed, at your option.)
+ *
+ * Unless required by applicable law or agreed to in writing, this
+ * software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#ifndef __HOST_ESP_ERR_H__
+#define __HOST_ESP_ERR_H__
+
+#include <stdint.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef int esp_err_t;
+
+/* Definitions for error constants, values are the same as in the ESP-IDF. */
+#define ESP_OK			0
+#define ESP_FAIL		-1
+
+#define ESP_ERR_NO_MEM		0x101
+#define ESP_ERR_INVALID_ARG	0x102
+#define ESP_ERR_INVALID_STATE	0x103
+#define ESP_ERR_INVALID_SIZE	0x104
+#define ESP_ERR_NOT_FOUND	0x105
+#define ESP_ERR_NOT_SUPPORTED	0x106
+#define ESP_ERR_TIMEOUT		0x107
+#define ESP_ERR_INVALID_RESPONSE 0x108
+#define ESP_ERR_INVALID_CRC	0x109
+#define ESP_ERR_INVALID_VERSION	0x10A
+#define ESP_ERR_INVALID_MAC	0x10B
+#define ESP_ERR_NOT_FINISHED	0x10C
+
+/// Returns the symbolic name of the error code
+const char *esp_err_to_name(esp_err_t code);
+
+#ifdef __cplusplus
+}
+#endif
+
+/// Log the error (if any) and hand the code over, as the ESP-IDF does
+#define ESP_ERROR_CHECK_WITHOUT_ABORT(x) ({					\
+	esp_err_t err_rc_ = (x);						\
+	if (err_rc_ != ESP_OK)							\
+	    fprintf(stderr, "ESP_ERROR_CHECK_WITHOUT_ABORT failed: esp_err_t 0x%x (%s) at %s:%d\n",	\
+		    err_rc_, esp_err_to_name(err_rc_), __FILE__, __LINE__);	\
+	err_rc_;								\
+    })
+
+#endif // __HOST_ESP_ERR_H__
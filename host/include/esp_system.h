@@ -0,0 +1,18 @@
+/* @file
+ * @brief Host (Linux) stand-in for the ESP-IDF 'esp_system.h'
+ *
+ * @section LICENCE
+ *
+ * This code is in the Public Domain (or CC0 licensed, at your option.)
+ *
+ * Unless required by applicable law or agreed to in writing, this
+ * software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#ifndef __HOST_ESP_SYSTEM_H__
+#define __HOST_ESP_SYSTEM_H__
+
+#include "esp_err.h"
+
+#endif // __HOST_ESP_SYSTEM_H__
@@ -0,0 +1,95 @@
+/* @file
+ * @brief Emulated NVS flash partitions for the host (Linux) build
+ *
+ * The emulator keeps the partitions in RAM and models the NVS page layout:
+ * 4096-byte pages of 126 32-byte entries, one spare page reserved for the
+ * garbage collection, strings and blobs occupying one header entry plus
+ * their data entries. Each flash program and page erase is counted and
+ * charged to a virtual flash clock, so write amplification and the GC stalls
+ * can be measured without the board.
+ *
+ * @section LICENCE
+ *
+ * This code is in the Public Domain (or CC0 licensed, at your option.)
+ *
+ * Unless required by applicable law or agreed to in writing, this
+ * software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#ifndef __NVS_EMUL_H__
+#define __NVS_EMUL_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "nvs.h"
+
+namespace nvs_emul
+{
+
+    constexpr size_t page_size = 4096;		///< size of the flash sector/NVS page
+    constexpr size_t entry_size = 32;		///< size of the NVS entry
+    constexpr size_t page_entries = 126;	///< entries per page, excluding the page header & the state bitmap
+    constexpr size_t default_size = 0x6000;	///< size of the default partition, as in the default partition table
+
+    /// Timing model of the emulated flash
+    struct timing
+    {
+	uint32_t entry_write_ns = 60000;	///< time of one entry program, including the state bitmap update
+	uint32_t page_erase_ns = 45000000;	///< time of one sector erase
+	uint32_t lookup_ns = 15000;		///< time of the item lookup (hash list search & entry read)
+	uint32_t entry_read_ns = 4000;		///< time of the sequential entry read by the entry iterator & the init scan
+	bool realtime = false;			///< spend the modelled time for real, not only account it
+    }; /* struct nvs_emul::timing */
+
+    /// Counters of the emulated partition
+    struct stats
+    {
+	uint64_t lookups = 0;		///< item lookups (every get, set, find & erase)
+	uint64_t gets = 0;		///< nvs_get_*() calls
+	uint64_t entries_read = 0;	///< item headers read by the entry iterators
+	uint64_t sets = 0;		///< nvs_set_*() calls
+	uint64_t sets_unchanged = 0;	///< nvs_set_*() calls skipped by the NVS itself, as the stored value is the same
+	uint64_t erases = 0;		///< nvs_erase_key() calls, which erased an item
+	uint64_t commits = 0;		///< nvs_commit() calls
+	uint64_t opens = 0;		///< nvs_open*() calls
+	uint64_t payload_bytes = 0;	///< bytes of the values stored, the unchanged ones excluded
+	uint64_t entries_written = 0;	///< entries programmed to the flash, including the GC relocations
+	uint64_t entries_relocated = 0;	///< entries moved by the garbage collector
+	uint64_t gc_runs = 0;		///< garbage collector passes
+	uint64_t page_erases = 0;	///< flash sector erases
+	uint64_t flash_time_ns = 0;	///< virtual time spent by the flash operations
+
+	/// flash bytes programmed per one payload byte
+	double write_amplification() const {
+	    return payload_bytes? double(entries_written * entry_size) / payload_bytes: 0.0; };
+    }; /* struct nvs_emul::stats */
+
+
+    /// Create (or recreate empty) the partition 'label' with the size 'size' bytes;
+    /// the size is rounded down to the whole pages. Partition must be initialized
+    /// by nvs_flash_init_partition() before use, as on the target; the init scans
+    /// the header & the written entries of every page, charged as the entry reads.
+    esp_err_t partition(const std::string& label, size_t size);
+    /// Size of the partition 'label', 0 if partition does not exists
+    size_t partition_size(const std::string& label = NVS_DEFAULT_PART_NAME);
+
+    /// Set the flash timing model for all partitions
+    void set_timing(const timing&);
+    timing get_timing();
+
+    /// Counters of the partition 'label'
+    stats get_stats(const std::string& label = NVS_DEFAULT_PART_NAME);
+    /// Zeroing counters of the partition 'label'
+    void reset_stats(const std::string& label = NVS_DEFAULT_PART_NAME);
+    /// Erase counter of the most worn page of the partition 'label'
+    uint32_t max_page_erases(const std::string& label = NVS_DEFAULT_PART_NAME);
+
+    /// Drop all partitions and handles, recreate empty default partition
+    void reset();
+
+}; /* namespace nvs_emul */
+
+#endif // __NVS_EMUL_H__
@@ -0,0 +1,21 @@
+/* @file
+ * @brief Host (Linux) stand-in for the ESP-IDF 'nvs_handle.hpp'
+ *
+ * The nvs::NVSHandle C++ interface of the ESP-IDF is not used by this component,
+ * the header exists only to satisfy the includes.
+ *
+ * @section LICENCE
+ *
+ * This code is in the Public Domain (or CC0 licensed, at your option.)
+ *
+ * Unless required by applicable law or agreed to in writing, this
+ * software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#ifndef __HOST_NVS_HANDLE_HPP__
+#define __HOST_NVS_HANDLE_HPP__
+
+#include "nvs.h"
+
+#endif // __HOST_NVS_HANDLE_HPP__
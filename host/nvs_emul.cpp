@@ -0,0 +1,875 @@
+/* @file
+ * @brief Emulated NVS flash partitions for the host (Linux) build
+ *
+ * Implementation of the ESP-IDF NVS C API over the in-RAM partitions.
+ *
+ * @section LICENCE
+ *
+ * This code is in the Public Domain (or CC0 licensed, at your option.)
+ *
+ * Unless required by applicable law or agreed to in writing, this
+ * software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <chrono>
+#include <vector>
+
+#include <nvs_flash.h>
+#include <nvs.h>
+
+#include "nvs_emul.h"
+
+
+/// Iterator over the entries of the partition, a snapshot made by nvs_entry_find()
+struct nvs_opaque_iterator_t
+{
+    std::vector<nvs_entry_info_t> entries;
+    size_t pos = 0;
+}; /* struct nvs_opaque_iterator_t */
+
+
+namespace nvs_emul
+{
+
+    namespace
+    {
+
+	constexpr size_t max_str_size = 4000;		///< maximum length of the string, including the terminating zero
+	constexpr size_t max_blob_size = 508000;	///< maximum length of the blob
+	constexpr size_t max_chunk_size = (page_entries - 1) * entry_size;	///< maximum data of the one blob chunk
+	constexpr size_t max_namespaces = 254;
+
+	/// Part of the item stored in one page
+	struct chunk
+	{
+	    uint32_t page;
+	    uint32_t span;		///< entries occupied
+	}; /* struct chunk */
+
+	struct item
+	{
+	    nvs_type_t type;
+	    std::string data;
+	    std::vector<chunk> chunks;
+	}; /* struct item */
+
+	struct page
+	{
+	    enum state_t { empty, active, full } state = empty;
+	    uint32_t used = 0;		///< entries written, including erased ones
+	    uint32_t erased = 0;	///< entries erased, reclaimable by the GC
+	    uint32_t erase_count = 0;	///< wear of the sector
+	}; /* struct page */
+
+	/// Namespace index 0 keeps the namespace entries, as in the NVS
+	using item_key = std::pair<uint8_t, std::string>;
+
+	struct part
+	{
+	    bool initialized = false;
+	    std::vector<page> pages;
+	    int active = -1;
+	    std::map<std::string, uint8_t> spaces;
+	    std::map<item_key, item> items;
+	    std::vector<chunk> pending;	///< chunks of the item being written, not yet in 'items'
+	    struct stats st;
+	}; /* struct part */
+
+	struct handle_rec
+	{
+	    std::string label;
+	    uint8_t ns;
+	    bool readonly;
+	}; /* struct handle_rec */
+
+
+	std::recursive_mutex lock;
+	std::map<std::string, part> parts;
+	std::map<nvs_handle_t, handle_rec> handles;
+	nvs_handle_t next_handle = 1;
+	timing tm;
+
+
+	/// Account the flash time and spend it, if realtime timing is requested
+	void charge(part& p, uint64_t writes, uint64_t erases, uint64_t lookups = 0, uint64_t reads = 0)
+	{
+		uint64_t ns = writes * tm.entry_write_ns + erases * tm.page_erase_ns + lookups * tm.lookup_ns
+				+ reads * tm.entry_read_ns;
+
+	    p.st.flash_time_ns += ns;
+	    if (tm.realtime && ns)
+		std::this_thread::sleep_for(std::chrono::nanoseconds(ns));
+	}; /* charge() */
+
+
+	part* find_part(const char label[])
+	{
+	    auto it = parts.find(label? label: NVS_DEFAULT_PART_NAME);
+
+	    if (it == parts.end() && (!label || strcmp(label, NVS_DEFAULT_PART_NAME) == 0))
+		it = parts.emplace(NVS_DEFAULT_PART_NAME, part{}).first, it->second.pages.resize(default_size / page_size);
+	    return (it == parts.end())? nullptr: &it->second;
+	}; /* find_part() */
+
+
+	/// Move the live entries of the 'victim' page into the 'spare' one and erase the victim
+	void collect(part& p, int victim, int spare)
+	{
+		uint32_t live = p.pages[victim].used - p.pages[victim].erased;
+
+	    for (auto& it: p.items)
+		for (auto& c: it.second.chunks)
+		    if (c.page == uint32_t(victim))
+			c.page = spare;
+	    for (auto& c: p.pending)
+		if (c.page == uint32_t(victim))
+		    c.page = spare;
+
+	    p.pages[spare].state = page::active;
+	    p.pages[spare].used = live;
+	    p.pages[spare].erased = 0;
+	    p.active = spare;
+
+	    p.pages[victim].state = page::empty;
+	    p.pages[victim].used = 0;
+	    p.pages[victim].erased = 0;
+	    p.pages[victim].erase_count++;
+
+	    p.st.gc_runs++;
+	    p.st.page_erases++;
+	    p.st.entries_relocated += live;
+	    p.st.entries_written += live;
+	    charge(p, live, 1);
+	}; /* collect() */
+
+
+	/// Allocate 'span' entries in one page, with the garbage collection if needed
+	esp_err_t reserve(part& p, uint32_t span, chunk& out)
+	{
+		size_t avail = 0;
+		size_t empties = 0;
+
+	    for (auto& pg: p.pages)
+	    {
+		avail += pg.erased;
+		if (pg.state == page::empty)
+		    empties++;
+	    }; /* for auto& pg: p.pages */
+	    if (empties)
+		avail += (empties - 1) * page_entries;
+	    if (p.active >= 0)
+		avail += page_entries - p.pages[p.active].used;
+	    if (avail < span)
+		return ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+
+	    for (;;)
+	    {
+		if (p.active >= 0 && page_entries - p.pages[p.active].used >= span)
+		{
+		    p.pages[p.active].used += span;
+		    out = {uint32_t(p.active), span};
+		    p.pending.push_back(out);
+		    return ESP_OK;
+		}; /* if p.active >= 0 && ... */
+		if (p.active >= 0)
+		    p.pages[p.active].state = page::full;
+
+		    int empty = -1;
+		    int victim = -1;
+
+		empties = 0;
+		for (size_t i = 0; i < p.pages.size(); i++)
+		    switch (p.pages[i].state)
+		    {
+		    case page::empty:
+			if (empty < 0)
+			    empty = i;
+			empties++;
+			break;
+		    case page::full:
+			if (p.pages[i].erased && (victim < 0 || p.pages[i].erased > p.pages[victim].erased))
+			    victim = i;
+			break;
+		    default:
+			break;
+		    }; /* switch p.pages[i].state */
+
+		// one empty page is always kept for the garbage collector
+		if (empties > 1)
+		{
+		    p.active = empty;
+		    p.pages[empty].state = page::active;
+		    continue;
+		}; /* if empties > 1 */
+		if (victim < 0 || empty < 0)
+		{
+		    p.active = -1;
+		    return ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+		}; /* if victim < 0 || empty < 0 */
+		collect(p, victim, empty);
+	    }; /* for ;; */
+	}; /* reserve() */
+
+
+	void release(part& p, const std::vector<chunk>& chunks)
+	{
+	    for (auto& c: chunks)
+		p.pages[c.page].erased += c.span;
+	    charge(p, chunks.size(), 0);
+	}; /* release() */
+
+
+	/// Entries layout of the item
+	std::vector<uint32_t> layout(nvs_type_t type, size_t size)
+	{
+		std::vector<uint32_t> spans;
+
+	    switch (type)
+	    {
+	    case NVS_TYPE_STR:
+		spans.push_back(1 + (size + entry_size - 1) / entry_size);
+		break;
+	    case NVS_TYPE_BLOB:
+		spans.push_back(1);	// blob index
+		do {
+			size_t part = std::min(size, max_chunk_size);
+
+		    spans.push_back(1 + (part + entry_size - 1) / entry_size);
+		    size -= part;
+		} while (size);
+		break;
+	    default:
+		spans.push_back(1);
+		break;
+	    }; /* switch type */
+	    return spans;
+	}; /* layout() */
+
+
+	esp_err_t check_key(const char key[])
+	{
+	    if (!key || !*key)
+		return ESP_ERR_NVS_INVALID_NAME;
+	    if (strlen(key) > NVS_KEY_NAME_MAX_SIZE - 1)
+		return ESP_ERR_NVS_KEY_TOO_LONG;
+	    return ESP_OK;
+	}; /* check_key() */
+
+
+	/// Write the item into the partition, as the NVS does: new version first, then erase the old one
+	esp_err_t store(part& p, uint8_t ns, const std::string& key, nvs_type_t type, std::string&& data)
+	{
+	    p.st.sets++;
+	    p.st.lookups++;
+	    charge(p, 0, 0, 1);
+
+		auto old = p.items.find({ns, key});
+
+	    if (old != p.items.end() && old->second.type == type && old->second.data == data)
+	    {
+		p.st.sets_unchanged++;
+		return ESP_OK;
+	    }; /* if old != p.items.end() && ... */
+
+		uint64_t written = 0;
+
+	    p.pending.clear();
+	    for (auto span: layout(type, data.size()))
+	    {
+		    chunk c;
+		    esp_err_t err = reserve(p, span, c);
+
+		if (err != ESP_OK)
+		{
+		    release(p, p.pending);
+		    p.pending.clear();
+		    return err;
+		}; /* if err != ESP_OK */
+		written += span;
+	    }; /* for auto span: layout(...) */
+
+	    p.st.payload_bytes += data.size();
+	    p.st.entries_written += written;
+	    charge(p, written, 0);
+
+	    old = p.items.find({ns, key});	// iterator is valid, but the chunks may be moved by the GC
+	    if (old != p.items.end())
+		release(p, old->second.chunks);
+	    p.items[{ns, key}] = item{type, std::move(data), std::move(p.pending)};
+	    p.pending.clear();
+	    return ESP_OK;
+	}; /* store() */
+
+
+	esp_err_t get_handle(nvs_handle_t handle, part*& p, handle_rec*& h)
+	{
+		auto it = handles.find(handle);
+
+	    if (it == handles.end())
+		return ESP_ERR_NVS_INVALID_HANDLE;
+	    h = &it->second;
+	    p = find_part(h->label.c_str());
+	    if (!p || !p->initialized)
+		return ESP_ERR_NVS_INVALID_HANDLE;
+	    return ESP_OK;
+	}; /* get_handle() */
+
+
+	esp_err_t set_value(nvs_handle_t handle, const char key[], nvs_type_t type, const void* value, size_t length)
+	{
+		std::lock_guard<std::recursive_mutex> guard(lock);
+		part* p;
+		handle_rec* h;
+		esp_err_t err = get_handle(handle, p, h);
+
+	    if (err != ESP_OK)
+		return err;
+	    if (h->readonly)
+		return ESP_ERR_NVS_READ_ONLY;
+	    if ((err = check_key(key)) != ESP_OK)
+		return err;
+	    if ((type == NVS_TYPE_STR && length > max_str_size) || (type == NVS_TYPE_BLOB && length > max_blob_size))
+		return ESP_ERR_NVS_VALUE_TOO_LONG;
+	    return store(*p, h->ns, key, type, std::string(static_cast<const char*>(value), length));
+	}; /* set_value() */
+
+
+	/// Find the item; an item with other type is not found, as in the NVS
+	esp_err_t find_value(nvs_handle_t handle, const char key[], nvs_type_t type, const item*& out)
+	{
+		part* p;
+		handle_rec* h;
+		esp_err_t err = get_handle(handle, p, h);
+
+	    if (err != ESP_OK)
+		return err;
+	    if ((err = check_key(key)) != ESP_OK)
+		return err;
+	    p->st.gets++;
+	    p->st.lookups++;
+	    charge(*p, 0, 0, 1);
+
+		auto it = p->items.find({h->ns, key});
+
+	    if (it == p->items.end() || (type != NVS_TYPE_ANY && it->second.type != type))
+		return ESP_ERR_NVS_NOT_FOUND;
+	    out = &it->second;
+	    return ESP_OK;
+	}; /* find_value() */
+
+
+	template <typename T>
+	esp_err_t get_value(nvs_handle_t handle, const char key[], nvs_type_t type, T* out)
+	{
+		std::lock_guard<std::recursive_mutex> guard(lock);
+		const item* it;
+		esp_err_t err = find_value(handle, key, type, it);
+
+	    if (err == ESP_OK)
+		memcpy(out, it->data.data(), sizeof(T));
+	    return err;
+	}; /* get_value() */
+
+
+	esp_err_t get_sized(nvs_handle_t handle, const char key[], nvs_type_t type, void* out, size_t* length)
+	{
+		std::lock_guard<std::recursive_mutex> guard(lock);
+		const item* it;
+		esp_err_t err = find_value(handle, key, type, it);
+
+	    if (err != ESP_OK)
+		return err;
+	    if (!length)
+		return ESP_ERR_NVS_INVALID_LENGTH;
+	    if (!out)
+	    {
+		*length = it->data.size();
+		return ESP_OK;
+	    }; /* if !out */
+	    if (*length < it->data.size())
+	    {
+		*length = it->data.size();
+		return ESP_ERR_NVS_INVALID_LENGTH;
+	    }; /* if *length < it->data.size() */
+	    *length = it->data.size();
+	    memcpy(out, it->data.data(), it->data.size());
+	    return ESP_OK;
+	}; /* get_sized() */
+
+
+	esp_err_t find_entries(part* p, const char spacename[], nvs_type_t type, nvs_iterator_t* output)
+	{
+	    if (!output)
+		return ESP_ERR_INVALID_ARG;
+	    *output = nullptr;
+	    if (!p)
+		return ESP_ERR_NVS_PART_NOT_FOUND;
+	    if (!p->initialized)
+		return ESP_ERR_NVS_NOT_INITIALIZED;
+
+		auto* it = new nvs_opaque_iterator_t;
+		std::map<uint8_t, const std::string*> names;
+
+	    for (auto& ns: p->spaces)
+		names[ns.second] = &ns.first;
+	    // the iterator reads every item header of the partition, page by page
+	    p->st.entries_read += p->items.size();
+	    charge(*p, 0, 0, 0, p->items.size());
+	    for (auto& rec: p->items)
+	    {
+		if (rec.first.first == 0 || (type != NVS_TYPE_ANY && rec.second.type != type))
+		    continue;
+		    const std::string& nsname = *names[rec.first.first];
+
+		if (spacename && nsname != spacename)
+		    continue;
+
+		    nvs_entry_info_t info = {};
+
+		strncpy(info.namespace_name, nsname.c_str(), sizeof(info.namespace_name) - 1);
+		strncpy(info.key, rec.first.second.c_str(), sizeof(info.key) - 1);
+		info.type = rec.second.type;
+		it->entries.push_back(info);
+	    }; /* for auto& rec: p->items */
+	    if (it->entries.empty())
+	    {
+		delete it;
+		return ESP_ERR_NVS_NOT_FOUND;
+	    }; /* if it->entries.empty() */
+	    *output = it;
+	    return ESP_OK;
+	}; /* find_entries() */
+
+    }; /* namespace */
+
+
+    esp_err_t partition(const std::string& label, size_t size)
+    {
+	    std::lock_guard<std::recursive_mutex> guard(lock);
+
+	if (label.empty() || label.length() > NVS_PART_NAME_MAX_SIZE - 1)
+	    return ESP_ERR_INVALID_ARG;
+	if (size / page_size < 2)
+	    return ESP_ERR_INVALID_SIZE;
+	for (auto it = handles.begin(); it != handles.end();)
+	    it = (it->second.label == label)? handles.erase(it): std::next(it);
+	parts[label] = part{};
+	parts[label].pages.resize(size / page_size);
+	return ESP_OK;
+    }; /* nvs_emul::partition() */
+
+
+    size_t partition_size(const std::string& label)
+    {
+	    std::lock_guard<std::recursive_mutex> guard(lock);
+	    auto it = parts.find(label);
+
+	return (it == parts.end())? 0: it->second.pages.size() * page_size;
+    }; /* nvs_emul::partition_size() */
+
+
+    void set_timing(const timing& t)
+    {
+	std::lock_guard<std::recursive_mutex> guard(lock);
+	tm = t;
+    }; /* nvs_emul::set_timing() */
+
+    timing get_timing()
+    {
+	std::lock_guard<std::recursive_mutex> guard(lock);
+	return tm;
+    }; /* nvs_emul::get_timing() */
+
+
+    stats get_stats(const std::string& label)
+    {
+	    std::lock_guard<std::recursive_mutex> guard(lock);
+	    part* p = find_part(label.c_str());
+
+	return p? p->st: stats{};
+    }; /* nvs_emul::get_stats() */
+
+    void reset_stats(const std::string& label)
+    {
+	    std::lock_guard<std::recursive_mutex> guard(lock);
+	    part* p = find_part(label.c_str());
+
+	if (p)
+	    p->st = stats{};
+    }; /* nvs_emul::reset_stats() */
+
+
+    uint32_t max_page_erases(const std::string& label)
+    {
+	    std::lock_guard<std::recursive_mutex> guard(lock);
+	    part* p = find_part(label.c_str());
+	    uint32_t worn = 0;
+
+	if (p)
+	    for (auto& pg: p->pages)
+		worn = std::max(worn, pg.erase_count);
+	return worn;
+    }; /* nvs_emul::max_page_erases() */
+
+
+    void reset()
+    {
+	std::lock_guard<std::recursive_mutex> guard(lock);
+	handles.clear();
+	parts.clear();
+	find_part(NVS_DEFAULT_PART_NAME);
+    }; /* nvs_emul::reset() */
+
+}; /* namespace nvs_emul */
+
+
+
+using namespace nvs_emul;
+
+extern "C"
+{
+
+esp_err_t nvs_flash_init_partition(const char *partition_label)
+{
+	std::lock_guard<std::recursive_mutex> guard(lock);
+	part* p = find_part(partition_label);
+
+    if (!p)
+	return ESP_ERR_NOT_FOUND;
+    if (!p->initialized)
+    {
+	    uint64_t scan = 0;
+
+	// the pages are scanned at the init: the header of each page & all its written entries
+	for (const page& pg: p->pages)
+	    scan += 1 + pg.used;
+	charge(*p, 0, 0, 0, scan);
+    }; /* if !p->initialized */
+    p->initialized = true;
+    return ESP_OK;
+} /* nvs_flash_init_partition() */
+
+esp_err_t nvs_flash_init(void)
+{
+    return nvs_flash_init_partition(NVS_DEFAULT_PART_NAME);
+} /* nvs_flash_init() */
+
+
+esp_err_t nvs_flash_deinit_partition(const char *partition_label)
+{
+	std::lock_guard<std::recursive_mutex> guard(lock);
+	part* p = find_part(partition_label);
+
+    if (!p || !p->initialized)
+	return ESP_ERR_NVS_NOT_INITIALIZED;
+    for (auto it = handles.begin(); it != handles.end();)
+	it = (it->second.label == partition_label)? handles.erase(it): std::next(it);
+    p->initialized = false;
+    return ESP_OK;
+} /* nvs_flash_deinit_partition() */
+
+esp_err_t nvs_flash_deinit(void)
+{
+    return nvs_flash_deinit_partition(NVS_DEFAULT_PART_NAME);
+} /* nvs_flash_deinit() */
+
+
+esp_err_t nvs_flash_erase_partition(const char *part_name)
+{
+	std::lock_guard<std::recursive_mutex> guard(lock);
+	part* p = find_part(part_name);
+
+    if (!p)
+	return ESP_ERR_NOT_FOUND;
+    if (p->initialized)
+	nvs_flash_deinit_partition(part_name);
+    for (auto& pg: p->pages)
+	if (pg.state != page::empty || pg.used)
+	{
+	    pg = page{page::empty, 0, 0, pg.erase_count + 1};
+	    p->st.page_erases++;
+	    charge(*p, 0, 1);
+	}; /* if pg.state != page::empty || pg.used */
+    p->active = -1;
+    p->spaces.clear();
+    p->items.clear();
+    return ESP_OK;
+} /* nvs_flash_erase_partition() */
+
+esp_err_t nvs_flash_erase(void)
+{
+    return nvs_flash_erase_partition(NVS_DEFAULT_PART_NAME);
+} /* nvs_flash_erase() */
+
+
+
+esp_err_t nvs_open_from_partition(const char *part_name, const char *namespace_name, nvs_open_mode_t open_mode, nvs_handle_t *out_handle)
+{
+	std::lock_guard<std::recursive_mutex> guard(lock);
+	part* p = find_part(part_name);
+
+    if (!p)
+	return ESP_ERR_NVS_PART_NOT_FOUND;
+    if (!p->initialized)
+	return ESP_ERR_NVS_NOT_INITIALIZED;
+    if (!namespace_name || !*namespace_name || strlen(namespace_name) > NVS_NS_NAME_MAX_SIZE - 1)
+	return ESP_ERR_NVS_INVALID_NAME;
+    if (!out_handle)
+	return ESP_ERR_INVALID_ARG;
+    p->st.opens++;
+
+	auto ns = p->spaces.find(namespace_name);
+
+    if (ns == p->spaces.end())
+    {
+	if (open_mode == NVS_READONLY)
+	    return ESP_ERR_NVS_NOT_FOUND;
+	if (p->spaces.size() >= max_namespaces)
+	    return ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+
+	    uint8_t index = p->spaces.size() + 1;
+	    esp_err_t err = store(*p, 0, namespace_name, NVS_TYPE_U8, std::string(1, char(index)));
+
+	p->st.sets--;	// namespace entry is not a user request
+	p->st.payload_bytes -= (err == ESP_OK);
+	if (err != ESP_OK)
+	    return err;
+	ns = p->spaces.emplace(namespace_name, index).first;
+    }; /* if ns == p->spaces.end() */
+
+    handles[next_handle] = handle_rec{part_name, ns->second, open_mode == NVS_READONLY};
+    *out_handle = next_handle++;
+    return ESP_OK;
+} /* nvs_open_from_partition() */
+
+esp_err_t nvs_open(const char *namespace_name, nvs_open_mode_t open_mode, nvs_handle_t *out_handle)
+{
+    return nvs_open_from_partition(NVS_DEFAULT_PART_NAME, namespace_name, open_mode, out_handle);
+} /* nvs_open() */
+
+void nvs_close(nvs_handle_t handle)
+{
+    std::lock_guard<std::recursive_mutex> guard(lock);
+    handles.erase(handle);
+} /* nvs_close() */
+
+esp_err_t nvs_commit(nvs_handle_t handle)
+{
+	std::lock_guard<std::recursive_mutex> guard(lock);
+	part* p;
+	handle_rec* h;
+	esp_err_t err = get_handle(handle, p, h);
+
+    if (err == ESP_OK)
+	p->st.commits++;
+    return err;
+} /* nvs_commit() */
+
+
+esp_err_t nvs_set_i8  (nvs_handle_t handle, const char *key, int8_t value)   { return set_value(handle, key, NVS_TYPE_I8,  &value, sizeof(value)); }
+esp_err_t nvs_set_u8  (nvs_handle_t handle, const char *key, uint8_t value)  { return set_value(handle, key, NVS_TYPE_U8,  &value, sizeof(value)); }
+esp_err_t nvs_set_i16 (nvs_handle_t handle, const char *key, int16_t value)  { return set_value(handle, key, NVS_TYPE_I16, &value, sizeof(value)); }
+esp_err_t nvs_set_u16 (nvs_handle_t handle, const char *key, uint16_t value) { return set_value(handle, key, NVS_TYPE_U16, &value, sizeof(value)); }
+esp_err_t nvs_set_i32 (nvs_handle_t handle, const char *key, int32_t value)  { return set_value(handle, key, NVS_TYPE_I32, &value, sizeof(value)); }
+esp_err_t nvs_set_u32 (nvs_handle_t handle, const char *key, uint32_t value) { return set_value(handle, key, NVS_TYPE_U32, &value, sizeof(value)); }
+esp_err_t nvs_set_i64 (nvs_handle_t handle, const char *key, int64_t value)  { return set_value(handle, key, NVS_TYPE_I64, &value, sizeof(value)); }
+esp_err_t nvs_set_u64 (nvs_handle_t handle, const char *key, uint64_t value) { return set_value(handle, key, NVS_TYPE_U64, &value, sizeof(value)); }
+
+esp_err_t nvs_set_str(nvs_handle_t handle, const char *key, const char *value)
+{
+    if (!value)
+	return ESP_ERR_INVALID_ARG;
+    return set_value(handle, key, NVS_TYPE_STR, value, strlen(value) + 1);
+} /* nvs_set_str() */
+
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char *key, const void *value, size_t length)
+{
+    if (!value && length)
+	return ESP_ERR_INVALID_ARG;
+    return set_value(handle, key, NVS_TYPE_BLOB, value, length);
+} /* nvs_set_blob() */
+
+
+esp_err_t nvs_get_i8  (nvs_handle_t handle, const char *key, int8_t *out_value)   { return get_value(handle, key, NVS_TYPE_I8,  out_value); }
+esp_err_t nvs_get_u8  (nvs_handle_t handle, const char *key, uint8_t *out_value)  { return get_value(handle, key, NVS_TYPE_U8,  out_value); }
+esp_err_t nvs_get_i16 (nvs_handle_t handle, const char *key, int16_t *out_value)  { return get_value(handle, key, NVS_TYPE_I16, out_value); }
+esp_err_t nvs_get_u16 (nvs_handle_t handle, const char *key, uint16_t *out_value) { return get_value(handle, key, NVS_TYPE_U16, out_value); }
+esp_err_t nvs_get_i32 (nvs_handle_t handle, const char *key, int32_t *out_value)  { return get_value(handle, key, NVS_TYPE_I32, out_value); }
+esp_err_t nvs_get_u32 (nvs_handle_t handle, const char *key, uint32_t *out_value) { return get_value(handle, key, NVS_TYPE_U32, out_value); }
+esp_err_t nvs_get_i64 (nvs_handle_t handle, const char *key, int64_t *out_value)  { return get_value(handle, key, NVS_TYPE_I64, out_value); }
+esp_err_t nvs_get_u64 (nvs_handle_t handle, const char *key, uint64_t *out_value) { return get_value(handle, key, NVS_TYPE_U64, out_value); }
+
+esp_err_t nvs_get_str(nvs_handle_t handle, const char *key, char *out_value, size_t *length)
+{
+    return get_sized(handle, key, NVS_TYPE_STR, out_value, length);
+} /* nvs_get_str() */
+
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char *key, void *out_value, size_t *length)
+{
+    return get_sized(handle, key, NVS_TYPE_BLOB, out_value, length);
+} /* nvs_get_blob() */
+
+
+esp_err_t nvs_find_key(nvs_handle_t handle, const char *key, nvs_type_t *out_type)
+{
+	std::lock_guard<std::recursive_mutex> guard(lock);
+	const item* it;
+	esp_err_t err = find_value(handle, key, NVS_TYPE_ANY, it);
+
+    if (err == ESP_OK && out_type)
+	*out_type = it->type;
+    return err;
+} /* nvs_find_key() */
+
+
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char *key)
+{
+	std::lock_guard<std::recursive_mutex> guard(lock);
+	part* p;
+	handle_rec* h;
+	esp_err_t err = get_handle(handle, p, h);
+
+    if (err != ESP_OK)
+	return err;
+    if (h->readonly)
+	return ESP_ERR_NVS_READ_ONLY;
+    if ((err = check_key(key)) != ESP_OK)
+	return err;
+    p->st.lookups++;
+    charge(*p, 0, 0, 1);
+
+	auto it = p->items.find({h->ns, key});
+
+    if (it == p->items.end())
+	return ESP_ERR_NVS_NOT_FOUND;
+    release(*p, it->second.chunks);
+    p->items.erase(it);
+    p->st.erases++;
+    return ESP_OK;
+} /* nvs_erase_key() */
+
+
+esp_err_t nvs_erase_all(nvs_handle_t handle)
+{
+	std::lock_guard<std::recursive_mutex> guard(lock);
+	part* p;
+	handle_rec* h;
+	esp_err_t err = get_handle(handle, p, h);
+
+    if (err != ESP_OK)
+	return err;
+    if (h->readonly)
+	return ESP_ERR_NVS_READ_ONLY;
+    for (auto it = p->items.begin(); it != p->items.end();)
+	if (it->first.first == h->ns)
+	{
+	    release(*p, it->second.chunks);
+	    p->st.erases++;
+	    it = p->items.erase(it);
+	}
+	else
+	    ++it;
+    return ESP_OK;
+} /* nvs_erase_all() */
+
+
+esp_err_t nvs_get_stats(const char *part_name, nvs_stats_t *nvs_stats)
+{
+	std::lock_guard<std::recursive_mutex> guard(lock);
+	part* p = find_part(part_name);
+
+    if (!nvs_stats)
+	return ESP_ERR_INVALID_ARG;
+    *nvs_stats = {};
+    if (!p)
+	return ESP_ERR_NVS_PART_NOT_FOUND;
+    if (!p->initialized)
+	return ESP_ERR_NVS_NOT_INITIALIZED;
+    nvs_stats->total_entries = p->pages.size() * page_entries;
+    for (auto& pg: p->pages)
+	nvs_stats->used_entries += pg.used - pg.erased;
+    nvs_stats->free_entries = nvs_stats->total_entries - nvs_stats->used_entries;
+    nvs_stats->available_entries = nvs_stats->free_entries - page_entries;
+    nvs_stats->namespace_count = p->spaces.size();
+    return ESP_OK;
+} /* nvs_get_stats() */
+
+
+esp_err_t nvs_get_used_entry_count(nvs_handle_t handle, size_t *used_entries)
+{
+	std::lock_guard<std::recursive_mutex> guard(lock);
+	part* p;
+	handle_rec* h;
+	esp_err_t err = get_handle(handle, p, h);
+
+    if (!used_entries)
+	return ESP_ERR_INVALID_ARG;
+    *used_entries = 0;
+    if (err != ESP_OK)
+	return err;
+    for (auto& it: p->items)
+	if (it.first.first == h->ns)
+	    for (auto& c: it.second.chunks)
+		*used_entries += c.span;
+    return ESP_OK;
+} /* nvs_get_used_entry_count() */
+
+
+esp_err_t nvs_entry_find(const char *part_name, const char *namespace_name, nvs_type_t type, nvs_iterator_t *output_iterator)
+{
+    std::lock_guard<std::recursive_mutex> guard(lock);
+    if (!part_name)
+	return ESP_ERR_INVALID_ARG;
+    return find_entries(find_part(part_name), namespace_name, type, output_iterator);
+} /* nvs_entry_find() */
+
+
+esp_err_t nvs_entry_find_in_handle(nvs_handle_t handle, nvs_type_t type, nvs_iterator_t *output_iterator)
+{
+	std::lock_guard<std::recursive_mutex> guard(lock);
+	part* p;
+	handle_rec* h;
+	esp_err_t err = get_handle(handle, p, h);
+
+    if (err != ESP_OK)
+	return err;
+    for (auto& ns: p->spaces)
+	if (ns.second == h->ns)
+	    return find_entries(p, ns.first.c_str(), type, output_iterator);
+    return ESP_ERR_NVS_NOT_FOUND;
+} /* nvs_entry_find_in_handle() */
+
+
+esp_err_t nvs_entry_next(nvs_iterator_t *iterator)
+{
+    if (!iterator || !*iterator)
+	return ESP_ERR_INVALID_ARG;
+    if (++(*iterator)->pos < (*iterator)->entries.size())
+	return ESP_OK;
+    delete *iterator;
+    *iterator = nullptr;
+    return ESP_ERR_NVS_NOT_FOUND;
+} /* nvs_entry_next() */
+
+
+esp_err_t nvs_entry_info(const nvs_iterator_t iterator, nvs_entry_info_t *out_info)
+{
+    if (!iterator || !out_info)
+	return ESP_ERR_INVALID_ARG;
+    *out_info = iterator->entries[iterator->pos];
+    return ESP_OK;
+} /* nvs_entry_info() */
+
+
+void nvs_release_iterator(nvs_iterator_t iterator)
+{
+    delete iterator;
+} /* nvs_release_iterator() */
+
+} /* extern "C" */
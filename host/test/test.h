@@ -0,0 +1,78 @@
+/* @file
+ * @brief Minimal assertions of the host tests
+ *
+ * Each test program is one ctest case: a failed CHECK prints its place and
+ * the expression and the program goes on; test::result() is the exit code.
+ * The emulated default partition is fresh in every program.
+ *
+ * @section LICENCE
+ *
+ * This code is in the Public Domain (or CC0 licensed, at your option.)
+ *
+ * Unless required by applicable law or agreed to in writing, this
+ * software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#ifndef __NVS_TEST_H__
+#define __NVS_TEST_H__
+
+#include <cstdio>
+
+#include <nvs_flash.h>
+#include <esp_log.h>
+#include <nvs_emul.h>
+
+#include "nvs_device"
+
+namespace test
+{
+
+    inline unsigned checks = 0;
+    inline unsigned failures = 0;
+
+    /// count the check, report the failed one
+    inline bool check(bool ok, const char file[], int line, const char expr[])
+    {
+	checks++;
+	if (!ok)
+	{
+	    failures++;
+	    fprintf(stderr, "%s:%d: check failed: %s\n", file, line, expr);
+	}; /* if !ok */
+	return ok;
+    }; /* check() */
+
+    /// count the check of the status, report the other one than expected
+    inline bool check_err(esp_err_t rc, esp_err_t expected, const char file[], int line, const char expr[])
+    {
+	checks++;
+	if (rc != expected)
+	{
+	    failures++;
+	    fprintf(stderr, "%s:%d: %s is %s, not %s\n", file, line, expr, esp_err_to_name(rc), esp_err_to_name(expected));
+	}; /* if rc != expected */
+	return rc == expected;
+    }; /* check_err() */
+
+    /// the default partition of 'size' bytes, initialized; the log is limited to the errors
+    inline bool device(size_t size)
+    {
+	esp_log_level_set("*", ESP_LOG_ERROR);
+	return nvs_emul::partition(NVS_DEFAULT_PART_NAME, size) == ESP_OK && nvs::dev::check();
+    }; /* device() */
+
+    /// summary of the program & its exit code
+    inline int result(const char name[])
+    {
+	printf("%s: %u checks, %u failed\n", name, checks, failures);
+	return failures? 1: 0;
+    }; /* result() */
+
+}; /* namespace test */
+
+#define CHECK(cond) test::check((cond), __FILE__, __LINE__, #cond)
+#define CHECK_ERR(expr, expected) test::check_err((expr), (expected), __FILE__, __LINE__, #expr)
+#define CHECK_OK(expr) CHECK_ERR(expr, ESP_OK)
+
+#endif // __NVS_TEST_H__
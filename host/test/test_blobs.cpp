@@ -0,0 +1,262 @@
+/* @file
+ * @brief Large blobs of the stream: chunked, delta & compressed ones
+ *
+ * @section LICENCE
+ *
+ * This code is in the Public Domain (or CC0 licensed, at your option.)
+ *
+ * Unless required by applicable law or agreed to in writing, this
+ * software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include <nvs.h>
+
+#include "nvstream"
+#include "test.h"
+
+
+namespace
+{
+
+    /// the payload of 'size' bytes, different by the 'seed'
+    std::vector<uint8_t> payload(size_t size, uint8_t seed)
+    {
+	    std::vector<uint8_t> out(size);
+
+	for (size_t i = 0; i < size; i++)
+	    out[i] = uint8_t(i * 7 + seed + (i >> 8));
+	return out;
+    }; /* payload() */
+
+    /// read the chunked blob whole, by the parts of 'part' bytes
+    esp_err_t read_chunked(nvs::stream& strm, const nvs::key& name, std::vector<uint8_t>& out, size_t part = 300)
+    {
+	    nvs::stream::blob_reader in(strm, name);
+	    std::vector<uint8_t> buff(part);
+	    size_t length;
+
+	out.clear();
+	if (in.status() != ESP_OK)
+	    return in.status();
+	do
+	{
+	    length = buff.size();
+	    if (in.read(buff.data(), length) != ESP_OK)
+		return in.status();
+	    out.insert(out.end(), buff.begin(), buff.begin() + length);
+	} while (length);
+	return ESP_OK;
+    }; /* read_chunked() */
+
+
+    void chunked()
+    {
+	    nvs::stream strm("chunked", nvs::readwrite);
+	    std::vector<uint8_t> first = payload(5000, 1), second = payload(2500, 2), got;
+
+	{
+		nvs::stream::blob_writer out(strm, "big", 1000);
+
+	    CHECK_OK(out.write(first.data(), 1234));
+	    CHECK_OK(out.write(first.data() + 1234, first.size() - 1234));
+	    CHECK_OK(out.finish());
+	    CHECK(out.size() == first.size());
+	}
+	CHECK_OK(read_chunked(strm, "big", got));
+	CHECK(got == first);
+
+	{
+		nvs::stream::blob_writer out(strm, "big", 1000);
+
+	    CHECK_OK(out.write(second.data(), second.size()));
+	    CHECK_OK(read_chunked(strm, "big", got));	// the previous blob is intact till the finish
+	    CHECK(got == first);
+	}	// unfinished: its chunks are dropped
+	CHECK_OK(read_chunked(strm, "big", got));
+	CHECK(got == first);
+
+	{
+		nvs::stream::blob_writer out(strm, "big", 1000);
+
+	    out.write(second.data(), second.size());
+	    CHECK_OK(out.finish());
+	}
+	CHECK_OK(read_chunked(strm, "big", got, 64));
+	CHECK(got == second);
+
+	// "cfg" & "cfg/bigdsyc" are of the same hash: the chunk keys are of the first one
+	{
+		nvs::stream::blob_writer out(strm, "cfg", 1000);
+
+	    out.write(first.data(), first.size());
+	    CHECK_OK(out.finish());
+	}
+	{
+		nvs::stream::blob_writer out(strm, "cfg/bigdsyc", 1000);
+
+	    CHECK_ERR(out.write(second.data(), second.size()), ESP_ERR_INVALID_STATE);
+	    CHECK_ERR(out.finish(), ESP_ERR_INVALID_STATE);
+	}
+	CHECK_OK(read_chunked(strm, "cfg", got));
+	CHECK(got == first);
+
+	strm.write_blob("plain", first.data(), 100);
+	CHECK_ERR(read_chunked(strm, "plain", got), ESP_ERR_NVS_TYPE_MISMATCH);
+	CHECK_ERR(read_chunked(strm, "none", got), ESP_ERR_NVS_NOT_FOUND);
+    }; /* chunked() */
+
+
+    void delta()
+    {
+	    nvs::stream strm("delta", nvs::readwrite);
+	    std::vector<uint8_t> table = payload(8192, 3), got;
+	    nvs::delta_stats st;
+
+	CHECK_OK(strm.write_blob_delta("table", table.data(), table.size(), &st));
+	CHECK(st.chunks > 1 && st.written == st.chunks);
+	CHECK_OK(strm.read_blob_delta("table", got));
+	CHECK(got == table);
+
+	table[100] ^= 0xFF;	// one parameter tweaked: one chunk rewritten
+	CHECK_OK(strm.write_blob_delta("table", table.data(), table.size(), &st));
+	CHECK(st.written == 1);
+	CHECK_OK(strm.write_blob_delta("table", table.data(), table.size(), &st));
+	CHECK(st.written == 0 && st.bytes == 0);
+
+	table.resize(3000);	// shrunk
+	CHECK_OK(strm.write_blob_delta("table", table.data(), table.size(), &st));
+	CHECK_OK(strm.read_blob_delta("table", got));
+	CHECK(got == table);
+
+	    std::vector<uint8_t> small(100);
+	    size_t length = small.size();
+
+	CHECK_ERR(strm.read_blob_delta("table", small.data(), length), ESP_ERR_NVS_INVALID_LENGTH);
+
+	CHECK_OK(strm.write_blob_delta("cfg", table.data(), table.size()));
+	CHECK_ERR(strm.write_blob_delta("cfg/bigdsyc", table.data(), table.size()), ESP_ERR_INVALID_STATE);
+	CHECK_OK(strm.read_blob_delta("cfg", got));
+	CHECK(got == table);
+    }; /* delta() */
+
+
+    /// bytes of the blob as stored
+    size_t stored_size(const char space[], const char name[])
+    {
+	    nvs_handle_t h;
+	    size_t size = 0;
+
+	if (nvs_open(space, NVS_READONLY, &h) == ESP_OK)
+	{
+	    nvs_get_blob(h, name, nullptr, &size);
+	    nvs_close(h);
+	}; /* if nvs_open(...) == ESP_OK */
+	return size;
+    }; /* stored_size() */
+
+
+    void packed()
+    {
+	    std::vector<uint8_t> text(2048), got;
+	    std::string str;
+
+	for (size_t i = 0; i < text.size(); i++)
+	    text[i] = "sensor=42;state=idle;"[i % 21];
+	{
+		nvs::stream strm("packed", nvs::readwrite);
+
+	    strm.compress();
+	    CHECK_OK(strm.write_blob("text", text.data(), text.size()));
+	    CHECK_OK(strm.write_str("line", "repeat repeat repeat repeat repeat repeat repeat"));
+	}
+	CHECK(stored_size("packed", "text") < text.size() / 2);
+	{
+		nvs::stream strm("packed", nvs::readonly);	// decoded in any mode
+
+	    CHECK_OK(strm.read_blob("text", got));
+	    CHECK(got == text);
+	    CHECK_OK(strm.read("line", str));
+	    CHECK(str == "repeat repeat repeat repeat repeat repeat repeat");
+	}
+
+	// the plain blob, which starts by the header of the compressed one, stays plain
+	    const uint8_t legacy[] = {0xA7, 'N', 'Z', 0x01, 4, 0, 0, 0, 'a', 'b', 'c', 'd'};
+
+	{
+		nvs::stream strm("legacy", nvs::readwrite);
+
+	    CHECK_OK(strm.write_blob("old", legacy, sizeof(legacy)));
+	    CHECK_OK(strm.read_blob("old", got));
+	    CHECK(got == std::vector<uint8_t>(legacy, legacy + sizeof(legacy)));
+	    strm.compress();
+	    CHECK_OK(strm.write_blob("text", text.data(), text.size()));	// the namespace is not marked
+	    CHECK_OK(strm.read_blob("text", got));
+	    CHECK(got == text);
+	    CHECK_OK(strm.read_blob("old", got));
+	    CHECK(got == std::vector<uint8_t>(legacy, legacy + sizeof(legacy)));
+	}
+	CHECK(stored_size("legacy", "text") == text.size());
+    }; /* packed() */
+
+
+    struct settings
+    {
+	uint32_t mode;
+	uint8_t table[60];	// compressible
+    }; /* struct settings */
+
+    // The write-behind of the compressing stream stores the items as its direct writes
+    void packed_behind()
+    {
+	    std::vector<uint8_t> text(2048), got;
+	    settings cfg{}, back{};
+	    std::string str;
+	    const std::string line(100, 'r');
+
+	for (size_t i = 0; i < text.size(); i++)
+	    text[i] = "sensor=42;state=idle;"[i % 21];
+	cfg.mode = 3;
+	{
+		nvs::stream strm("packbehind", nvs::readwrite);
+
+	    strm.compress();
+	    {
+		    nvs::stream::write_behind behind(strm);
+
+		CHECK_OK(behind.write("cfg", cfg));
+		CHECK_OK(behind.write_blob("text", text.data(), text.size()));
+		CHECK_OK(behind.write_str("line", line.c_str()));
+		CHECK_OK(behind.flush().get());
+		CHECK_OK(behind.write("cfg", cfg));	// unchanged: skipped
+		CHECK_OK(behind.flush().get());
+	    }
+	    CHECK_OK(strm.read("cfg", back));	// the fixed object is the plain blob
+	    CHECK(back.mode == 3 && memcmp(&back, &cfg, sizeof(cfg)) == 0);
+	    CHECK_OK(strm.read_blob("text", got));
+	    CHECK(got == text);
+	    CHECK_OK(strm.read("line", str));
+	    CHECK(str == line);
+	}
+	CHECK(stored_size("packbehind", "cfg") == sizeof(cfg));
+	CHECK(stored_size("packbehind", "text") < text.size() / 2);
+    }; /* packed_behind() */
+
+}; /* namespace */
+
+
+
+int main()
+{
+    if (!test::device(0x100000))
+	return 1;
+    chunked();
+    delta();
+    packed();
+    packed_behind();
+    return test::result("test_blobs");
+}
@@ -0,0 +1,133 @@
+/* @file
+ * @brief Persistent counters: the policy, the recovery of the value after the reset,
+ *	the slot keys of the names of the same hash
+ *
+ * The reset is modelled by the counter, which is never destroyed: its pending
+ * increments are lost, the persisted ones are recovered by the next counter.
+ *
+ * @section LICENCE
+ *
+ * This code is in the Public Domain (or CC0 licensed, at your option.)
+ *
+ * Unless required by applicable law or agreed to in writing, this
+ * software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <cstdint>
+
+#include <nvs.h>
+
+#include "nvstream"
+#include "test.h"
+
+
+namespace
+{
+
+    void policy()
+    {
+	    nvs::stream strm("counter", nvs::readwrite);
+	    nvs::counter::policy pol;
+
+	pol.every = 10;
+	pol.slots = 4;
+	{
+		nvs::counter cnt(strm, "cycles", pol);
+
+	    CHECK_OK(cnt.status());
+	    CHECK(cnt.value() == 0);
+	    for (int i = 0; i < 25; i++)
+		CHECK_OK(cnt.add());
+	    CHECK(cnt.value() == 25);
+	    CHECK(cnt.stored() == 20);	// persisted by every 10 units
+	    CHECK(cnt.get_stats().persists == 2);
+	}	// the destructor persists the rest
+	{
+		nvs::counter cnt(strm, "cycles", pol);
+
+	    CHECK(cnt.value() == 25 && cnt.stored() == 25);
+	}
+    }; /* policy() */
+
+
+    void recovery()
+    {
+	    nvs::stream strm("counter", nvs::readwrite);
+	    nvs::counter::policy pol;
+
+	pol.every = 100;
+	pol.slots = 3;
+	{
+		nvs::counter* lost = new nvs::counter(strm, "uptime", pol);	// the reset: never destroyed
+
+	    for (int i = 0; i < 1050; i++)
+		lost->add();	// the ring of 3 slots is passed several times
+	    CHECK(lost->stored() == 1000);
+	}
+	{
+		nvs::counter cnt(strm, "uptime", pol);	// the latest slot is the highest
+
+	    CHECK_OK(cnt.status());
+	    CHECK(cnt.value() == 1000);
+	    CHECK_OK(cnt.add(5));
+	    CHECK_OK(cnt.flush());
+	}
+	pol.slots = 2;	// the ring is resized between the boots: all the slots are scanned
+	{
+		nvs::counter cnt(strm, "uptime", pol);
+
+	    CHECK(cnt.value() == 1005);
+	    CHECK_OK(cnt.reset(7));
+	}
+	pol.slots = 5;
+	{
+		nvs::counter cnt(strm, "uptime", pol);
+
+	    CHECK(cnt.value() == 7);	// the reset wrote all the stored slots
+	}
+    }; /* recovery() */
+
+
+    void collision()
+    {
+	    nvs::stream strm("counter", nvs::readwrite);
+
+	// "cfg" & "cfg/bigdsyc" are of the same hash: the slot keys are of the first one
+	{
+		nvs::counter first(strm, "cfg");
+
+	    CHECK_OK(first.add(3));
+	    CHECK_OK(first.flush());
+	}
+	{
+		nvs::counter second(strm, "cfg/bigdsyc");
+
+	    CHECK_ERR(second.status(), ESP_ERR_INVALID_STATE);
+	    CHECK(second.value() == 0);	// the slots of the first one are not recovered
+	    CHECK_OK(second.add(5));	// accumulated in RAM
+	    CHECK_ERR(second.flush(), ESP_ERR_INVALID_STATE);
+	    CHECK_ERR(second.reset(), ESP_ERR_INVALID_STATE);
+	    CHECK(second.get_stats().errors == 2);
+	}
+	{
+		nvs::counter first(strm, "cfg");
+
+	    CHECK_OK(first.status());
+	    CHECK(first.value() == 3);	// not written over
+	}
+    }; /* collision() */
+
+}; /* namespace */
+
+
+
+int main()
+{
+    if (!test::device(0x10000))
+	return 1;
+    policy();
+    recovery();
+    collision();
+    return test::result("test_counter");
+}
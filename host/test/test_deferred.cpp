@@ -0,0 +1,85 @@
+/* @file
+ * @brief Deferred & concurrent initialization of the partitions
+ *
+ * The last deferred partition is still initialized, when main() returns:
+ * its task is joined at the exit.
+ *
+ * @section LICENCE
+ *
+ * This code is in the Public Domain (or CC0 licensed, at your option.)
+ *
+ * Unless required by applicable law or agreed to in writing, this
+ * software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <cstdint>
+
+#include <nvs.h>
+
+#include "nvstream"
+#include "test.h"
+
+
+namespace
+{
+
+    void deferred()
+    {
+	    esp_err_t rc;
+
+	CHECK_OK(nvs_emul::partition("late", 0x10000));
+	CHECK_ERR(nvs::dev::status("late"), ESP_ERR_NVS_INVALID_HANDLE);	// not registered yet
+	nvs::dev::start({"late"});
+	rc = nvs::dev::status("late");
+	CHECK(rc == ESP_ERR_NOT_FINISHED || rc == ESP_OK);
+	CHECK_OK(nvs::dev::ready("late").get());
+	CHECK_OK(nvs::dev::status("late"));
+
+	    nvs::stream strm;
+	    uint32_t val = 0;
+
+	CHECK_OK(strm.open_partition("late", "space", nvs::readwrite));
+	CHECK_OK(strm.write("boots", uint32_t(1)));
+	CHECK_OK(strm.read("boots", val));
+	CHECK(val == 1);
+
+	nvs::dev::start({"late"});	// no effect on the initialized device
+	CHECK_OK(nvs::dev::status("late"));
+    }; /* deferred() */
+
+
+    void failed()
+    {
+	    nvs::stream strm;
+
+	nvs::dev::start({"absent"});	// no such partition
+	CHECK(nvs::dev::ready("absent").get() != ESP_OK);
+	CHECK(!nvs::dev::check("absent"));
+	CHECK(strm.open_partition("absent", "space", nvs::readwrite) != ESP_OK);
+    }; /* failed() */
+
+
+    void concurrent()
+    {
+	CHECK_OK(nvs_emul::partition("first", 0x10000));
+	CHECK_OK(nvs_emul::partition("second", 0x10000));
+	CHECK_OK(nvs::dev::init({"first", "second"}));
+	CHECK(nvs::dev::check("first") && nvs::dev::check("second"));
+    }; /* concurrent() */
+
+}; /* namespace */
+
+
+
+int main()
+{
+    if (!test::device(0x6000))
+	return 1;
+    deferred();
+    failed();
+    concurrent();
+    CHECK_OK(nvs_emul::partition("unwaited", 0x40000));
+    nvs::dev::start({"unwaited"});	// joined at the exit
+    return test::result("test_deferred");
+}
@@ -0,0 +1,183 @@
+/* @file
+ * @brief Delta blobs: the update interrupted by the reset, the corrupted chunk,
+ *	the change of the chunk size & the flash wear against the plain blob
+ *
+ * The reset during the update is modelled by the chunk, written by the NVS C API
+ * to its other slot without the index: the index is written last by the stream.
+ *
+ * @section LICENCE
+ *
+ * This code is in the Public Domain (or CC0 licensed, at your option.)
+ *
+ * Unless required by applicable law or agreed to in writing, this
+ * software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <cinttypes>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include <nvs.h>
+
+#include "nvstream"
+#include "test.h"
+
+
+namespace
+{
+
+    constexpr size_t chunk = 256;
+
+    /// the payload of 'size' bytes, different by the 'seed'
+    std::vector<uint8_t> payload(size_t size, uint8_t seed)
+    {
+	    std::vector<uint8_t> out(size);
+
+	for (size_t i = 0; i < size; i++)
+	    out[i] = uint8_t(i * 7 + seed + (i >> 8));
+	return out;
+    }; /* payload() */
+
+    /// key of the chunk 'index' of the blob 'name' in the slot 'set': '~', FNV-1a of the name, the slot, the index
+    std::string chunk_key(const char name[], char set, uint32_t index)
+    {
+	    uint32_t hash = 2166136261u;
+	    char buff[NVS_KEY_NAME_MAX_SIZE];
+
+	for (const char* c = name; *c; c++)
+	    hash = (hash ^ uint8_t(*c)) * 16777619u;
+	snprintf(buff, sizeof(buff), "~%08" PRIx32 "%c%05" PRIx32, hash, set, index);
+	return buff;
+    }; /* chunk_key() */
+
+    /// write the blob into the namespace by the NVS C API, bypassing the stream
+    esp_err_t set_raw(const char space[], const std::string& name, const uint8_t data[], size_t size)
+    {
+	    nvs_handle_t h;
+	    esp_err_t rc = nvs_open(space, NVS_READWRITE, &h);
+
+	if (rc != ESP_OK)
+	    return rc;
+	if ((rc = nvs_set_blob(h, name.c_str(), data, size)) == ESP_OK)
+	    rc = nvs_commit(h);
+	nvs_close(h);
+	return rc;
+    }; /* set_raw() */
+
+    /// items of the namespace, the reserved ones included
+    int entries(const char space[])
+    {
+	    nvs_iterator_t it = nullptr;
+	    int count = 0;
+
+	for (esp_err_t rc = nvs_entry_find(NVS_DEFAULT_PART_NAME, space, NVS_TYPE_ANY, &it); rc == ESP_OK;
+		rc = nvs_entry_next(&it))
+	    count++;
+	nvs_release_iterator(it);
+	return count;
+    }; /* entries() */
+
+
+    // The chunk of the interrupted update is in the other slot, not indexed: the previous blob is read
+    void interrupted()
+    {
+	    nvs::stream strm("delta", nvs::readwrite);
+	    std::vector<uint8_t> table = payload(8 * chunk, 1), tweaked = table, got;
+	    nvs::delta_stats st;
+
+	CHECK_OK(strm.write_blob_delta("table", table.data(), table.size(), &st, chunk));
+	CHECK(st.chunks == 8 && st.written == 8);
+
+	tweaked[3 * chunk + 10] ^= 0x5A;
+	CHECK_OK(set_raw("delta", chunk_key("table", 'd', 3), tweaked.data() + 3 * chunk, chunk));	// the reset
+	CHECK_OK(strm.read_blob_delta("table", got));
+	CHECK(got == table);
+
+	CHECK_OK(strm.write_blob_delta("table", tweaked.data(), tweaked.size(), &st, chunk));	// repeated
+	CHECK(st.written == 1);
+	CHECK_OK(strm.read_blob_delta("table", got));
+	CHECK(got == tweaked);
+	CHECK(entries("delta") == 1 + 1 + 8);	// the owner, the index, the chunks: the previous slot is dropped
+    }; /* interrupted() */
+
+
+    // The chunk is checked by its hash of the index: the corrupted one is not returned
+    void corrupted()
+    {
+	    nvs::stream strm("delta", nvs::readwrite);
+	    std::vector<uint8_t> table = payload(4 * chunk, 2), got;
+
+	CHECK_OK(strm.write_blob_delta("params", table.data(), table.size(), nullptr, chunk));
+
+	    std::vector<uint8_t> bad(table.begin() + chunk, table.begin() + 2 * chunk);
+
+	bad[0] ^= 1;
+	CHECK_OK(set_raw("delta", chunk_key("params", 'c', 1), bad.data(), bad.size()));
+	CHECK_ERR(strm.read_blob_delta("params", got), ESP_ERR_INVALID_CRC);
+
+	table[chunk + 1] ^= 1;	// the update of the chunk writes it over
+	CHECK_OK(strm.write_blob_delta("params", table.data(), table.size(), nullptr, chunk));
+	CHECK_OK(strm.read_blob_delta("params", got));
+	CHECK(got == table);
+    }; /* corrupted() */
+
+
+    // The other chunk size rewrites all the chunks, the previous ones are dropped
+    void resized()
+    {
+	    nvs::stream strm("resized", nvs::readwrite);
+	    std::vector<uint8_t> table = payload(16 * chunk, 3), got;
+	    nvs::delta_stats st;
+
+	CHECK_OK(strm.write_blob_delta("table", table.data(), table.size(), &st, chunk));
+	CHECK(entries("resized") == 1 + 1 + 16);
+	CHECK_OK(strm.write_blob_delta("table", table.data(), table.size(), &st, 4 * chunk));
+	CHECK(st.chunks == 4 && st.written == 4);
+	CHECK(entries("resized") == 1 + 1 + 4);
+	CHECK_OK(strm.read_blob_delta("table", got));
+	CHECK(got == table);
+    }; /* resized() */
+
+
+    // One tweaked parameter: the plain blob is rewritten whole, the delta one - by its chunk & the index
+    void wear()
+    {
+	    nvs::stream strm("wear", nvs::readwrite);
+	    std::vector<uint8_t> table = payload(32 * chunk, 4);
+	    nvs::delta_stats st;
+
+	CHECK_OK(strm.write_blob("plain", table.data(), table.size()));
+	CHECK_OK(strm.write_blob_delta("delta", table.data(), table.size(), &st, chunk));
+	table[5000] ^= 0xFF;
+
+	nvs_emul::reset_stats();
+	CHECK_OK(strm.write_blob("plain", table.data(), table.size()));
+
+	    uint64_t plain = nvs_emul::get_stats().entries_written;
+
+	nvs_emul::reset_stats();
+	CHECK_OK(strm.write_blob_delta("delta", table.data(), table.size(), &st, chunk));
+
+	    uint64_t delta = nvs_emul::get_stats().entries_written;
+
+	CHECK(st.written == 1 && st.bytes < 2 * chunk);
+	CHECK(delta * 8 < plain);
+    }; /* wear() */
+
+}; /* namespace */
+
+
+
+int main()
+{
+    if (!test::device(0x40000))
+	return 1;
+    interrupted();
+    corrupted();
+    resized();
+    wear();
+    return test::result("test_delta");
+}
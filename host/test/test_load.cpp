@@ -0,0 +1,120 @@
+/* @file
+ * @brief Sweep of the namespace: the entry iterator, the loads into the map & into
+ *	the table, the load of the stream shared with the committing task
+ *
+ * @section LICENCE
+ *
+ * This code is in the Public Domain (or CC0 licensed, at your option.)
+ *
+ * Unless required by applicable law or agreed to in writing, this
+ * software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <thread>
+#include <variant>
+
+#include <nvs.h>
+
+#include "nvstream"
+#include "test.h"
+
+
+namespace
+{
+
+    void sweep()
+    {
+	    nvs::stream strm("load", nvs::readwrite);
+
+	CHECK_OK(strm.write("gain", int16_t(-3)));
+	CHECK_OK(strm.write("port", uint32_t(8080)));
+	CHECK_OK(strm.write("ssid", std::string("field")));
+	{
+		nvs::stream::transaction tx(strm);	// the reserved keys of the journal are not seen
+
+	    CHECK_OK(tx.write("mode", uint8_t(2)));
+	    CHECK_OK(tx.commit());
+	}
+
+	    int visible = 0;
+
+	for (auto& e: strm)
+	{
+	    CHECK(e.name().c_str()[0] != nvs::stream::reserved_prefix);
+	    visible++;
+	}; /* for auto& e: strm */
+	CHECK(visible == 4);
+
+	    std::map<nvs::key, nvs::value> items;
+
+	CHECK_OK(strm.load(items));
+	CHECK(items.size() == 4);
+	CHECK(std::get<int16_t>(items["gain"]) == -3);
+	CHECK(std::get<std::string>(items["ssid"]) == "field");
+
+	    uint32_t port = 0;
+	    uint8_t mode = 0;
+	    uint16_t absent = 7;
+	    char ssid[16] = "";
+	    nvs::binding table[] = {nvs::bind("port", port), nvs::bind("mode", mode), nvs::bind("absent", absent),
+		    nvs::bind("ssid", ssid)};
+
+	CHECK_OK(strm.load(table));
+	CHECK(port == 8080 && mode == 2 && std::string(ssid) == "field");
+	CHECK_ERR(table[2].err, ESP_ERR_NVS_NOT_FOUND);
+	CHECK(absent == 7);	// the absent item keeps its value
+    }; /* sweep() */
+
+
+    // The load holds the stream shared: the transaction of the other task is seen whole or not at all
+    void shared()
+    {
+	    nvs::stream strm("loadshared", nvs::readwrite, nvs::noshadow, nvs::multi_task);
+	    std::atomic<bool> done = false;
+	    esp_err_t rc = ESP_OK;	// the checks are of the main task
+	    std::thread writer([&strm, &done, &rc]()
+	    {
+		for (uint32_t i = 0; !done && rc == ESP_OK; i++)
+		{
+			nvs::stream::transaction tx(strm);
+
+		    tx.write("first", i);
+		    tx.write("second", i);
+		    rc = tx.commit();
+		}; /* for uint32_t i = 0; !done && rc == ESP_OK; i++ */
+	    });
+	    int torn = 0;
+
+	for (int i = 0; i < 5000; i++)
+	{
+		uint32_t first = 0, second = 0;
+		nvs::binding table[] = {nvs::bind("first", first), nvs::bind("second", second)};
+
+	    if (strm.load(table) != ESP_OK || first != second)
+		torn++;
+	    std::this_thread::sleep_for(std::chrono::microseconds(20));	// the commits of the writer get in
+	}; /* for int i = 0; i < 5000; i++ */
+	done = true;
+	writer.join();
+	CHECK_OK(rc);
+	CHECK(torn == 0);
+    }; /* shared() */
+
+}; /* namespace */
+
+
+
+int main()
+{
+    if (!test::device(0x20000))
+	return 1;
+    sweep();
+    shared();
+    return test::result("test_load");
+}
@@ -0,0 +1,149 @@
+/* @file
+ * @brief Path keys: the hashing, its collisions, the normalization, the listing,
+ *	the named items & the linking by the several tasks
+ *
+ * @section LICENCE
+ *
+ * This code is in the Public Domain (or CC0 licensed, at your option.)
+ *
+ * Unless required by applicable law or agreed to in writing, this
+ * software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include <nvs.h>
+
+#include "nvstream"
+#include "test.h"
+
+
+namespace
+{
+
+    void items()
+    {
+	    nvs::stream strm("paths", nvs::readwrite);
+	    uint32_t val = 0;
+	    std::string str;
+
+	CHECK(nvs::path("/net//wifi/").str() == "net/wifi");
+	CHECK(nvs::path("net") / "wifi" == nvs::path("net/wifi"));
+	CHECK_OK(strm.write(nvs::path("net/wifi/ap2/retry_ms"), uint32_t(1500)));
+	CHECK_OK(strm.write(nvs::path("net/wifi/ssid"), std::string("home")));
+	CHECK_OK(strm.read(nvs::path("/net/wifi/ap2/retry_ms/"), val));
+	CHECK(val == 1500);
+	CHECK_OK(strm.read(nvs::path("net/wifi/ssid"), str));
+	CHECK(str == "home");
+	CHECK_OK(strm.write(nvs::path("net/wifi/ap2/retry_ms"), uint32_t(2500)));
+	CHECK_OK(strm.read(nvs::path("net/wifi/ap2/retry_ms"), val));
+	CHECK(val == 2500);
+
+	CHECK_ERR(strm.read(nvs::path("net/wifi"), val), ESP_ERR_NVS_NOT_FOUND);	// the directory only
+	CHECK_ERR(strm.read(nvs::path("net/eth"), val), ESP_ERR_NVS_NOT_FOUND);
+	CHECK_ERR(strm.write(nvs::path("//"), uint32_t(1)), ESP_ERR_NVS_INVALID_NAME);
+	CHECK_ERR(strm.write(nvs::path(std::string(nvs::path::max_length + 1, 'x')), uint32_t(1)), ESP_ERR_NVS_KEY_TOO_LONG);
+
+	    int visible = 0;
+
+	for ([[maybe_unused]] auto& e: strm)
+	    visible++;
+	CHECK(visible == 0);	// the path items are at the reserved keys, hidden from the iterator
+    }; /* items() */
+
+
+    void collisions()
+    {
+	    nvs::stream strm("paths", nvs::readwrite);
+	    const nvs::path one("net/k179599"), two("net/k362382");	// the same FNV-1a hash
+	    const nvs::path parent("cfg"), child("cfg/bigdsyc");	// the same hash, the one under the other
+	    uint32_t a = 0, b = 0;
+
+	CHECK_OK(strm.write(one, uint32_t(1)));
+	CHECK_OK(strm.write(two, uint32_t(2)));
+	CHECK_OK(strm.read(one, a));
+	CHECK_OK(strm.read(two, b));
+	CHECK(a == 1 && b == 2);
+
+	CHECK_OK(strm.write(parent, uint32_t(3)));
+	CHECK_OK(strm.write(child, uint32_t(4)));
+	CHECK_OK(strm.read(parent, a));
+	CHECK_OK(strm.read(child, b));
+	CHECK(a == 3 && b == 4);
+    }; /* collisions() */
+
+
+    void listing()
+    {
+	    nvs::stream strm("paths", nvs::readwrite);
+	    std::vector<nvs::path> found;
+
+	CHECK_OK(strm.list(nvs::path("net/wifi"), found));
+	CHECK(found == (std::vector<nvs::path>{nvs::path("net/wifi/ap2/retry_ms"), nvs::path("net/wifi/ssid")}));
+	found.clear();
+	CHECK_OK(strm.list(nvs::path("cfg"), found));
+	CHECK(found == (std::vector<nvs::path>{nvs::path("cfg"), nvs::path("cfg/bigdsyc")}));
+	found.clear();
+	CHECK_OK(strm.list(nvs::path(), found));
+	CHECK(found.size() == 6);
+    }; /* listing() */
+
+
+    void named()
+    {
+	    nvs::stream strm("paths", nvs::readwrite);
+	    uint32_t retry = 0;
+	    uint16_t port = 0;
+
+	static_assert(std::is_trivially_destructible_v<decltype(nvs::name("port", port))>, "the key item is allocated");
+	strm << nvs::name("port", uint16_t(8080)) << nvs::name(nvs::path("net/http/port"), uint16_t(8081));
+	CHECK_OK(strm.status());
+	strm >> nvs::name("port", port);
+	CHECK(port == 8080);
+	strm >> nvs::name(nvs::path("net/http/port"), port) >> nvs::name(nvs::path("net/wifi/ap2/retry_ms"), retry);
+	CHECK(port == 8081 && retry == 2500);
+    }; /* named() */
+
+
+    // The new paths of the tasks are linked one at a time: none of the shared listings loses a child
+    void tasks()
+    {
+	    nvs::stream strm("linking", nvs::readwrite, nvs::noshadow, nvs::multi_task);
+	    std::vector<std::thread> writers;
+	    esp_err_t rc[4] = {};	// the checks are of the main task
+	    std::vector<nvs::path> found;
+
+	for (int t = 0; t < 4; t++)
+	    writers.emplace_back([&strm, &rc, t]()
+	    {
+		for (int i = 0; i < 8 && rc[t] == ESP_OK; i++)
+		    rc[t] = strm.write(nvs::path("dev") / std::to_string(i) / ("t" + std::to_string(t)), uint32_t(t * 8 + i));
+	    });
+	for (auto& w: writers)
+	    w.join();
+	for (esp_err_t r: rc)
+	    CHECK_OK(r);
+	CHECK_OK(strm.list(nvs::path("dev"), found));
+	CHECK(found.size() == 32);
+    }; /* tasks() */
+
+}; /* namespace */
+
+
+
+int main()
+{
+    if (!test::device(0x40000))
+	return 1;
+    items();
+    collisions();
+    listing();
+    named();
+    tasks();
+    return test::result("test_paths");
+}
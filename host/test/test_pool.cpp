@@ -0,0 +1,103 @@
+/* @file
+ * @brief Pool of the namespace handles: the reuse, the sharing by the streams,
+ *	the idle limit & the flush
+ *
+ * @section LICENCE
+ *
+ * This code is in the Public Domain (or CC0 licensed, at your option.)
+ *
+ * Unless required by applicable law or agreed to in writing, this
+ * software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <cstdint>
+
+#include <nvs.h>
+
+#include "nvstream"
+#include "test.h"
+
+
+namespace
+{
+
+    void reuse()
+    {
+	nvs::pool::flush();
+	nvs::pool::reset_stats();
+	nvs_emul::reset_stats();
+	for (int i = 0; i < 10; i++)
+	{
+		nvs::stream strm("pool", nvs::readwrite);	// the short-lived stream of the handler
+
+	    CHECK_OK(strm.write("hits", uint32_t(i)));
+	}; /* for int i = 0; i < 10; i++ */
+
+	    nvs::pool::stats st = nvs::pool::get_stats();
+
+	CHECK(st.opens == 1 && st.reuses == 9 && st.closes == 0);
+	CHECK(st.active == 0 && st.idle == 1);
+	CHECK(nvs_emul::get_stats().opens == 1);
+    }; /* reuse() */
+
+
+    // The streams of the same namespace & mode share the handle; the other mode is the other handle
+    void sharing()
+    {
+	nvs::pool::reset_stats();
+	{
+		nvs::stream first("pool", nvs::readwrite), second("pool", nvs::readwrite);
+		nvs::stream reader("pool", nvs::readonly);
+		uint32_t hits = 0;
+
+	    CHECK(nvs::pool::get_stats().active == 2);
+	    CHECK(nvs::pool::get_stats().opens == 1);	// the readonly handle
+	    CHECK_OK(first.close());
+	    CHECK_OK(second.write("hits", uint32_t(42)));	// still open for the second stream
+	    CHECK_OK(second.commit());
+	    CHECK_OK(reader.read("hits", hits));
+	    CHECK(hits == 42);
+	    CHECK_ERR(reader.write("hits", uint32_t(1)), ESP_ERR_NVS_READ_ONLY);
+	}
+	CHECK(nvs::pool::get_stats().active == 0 && nvs::pool::get_stats().idle == 2);
+    }; /* sharing() */
+
+
+    // The least recently released handles over the limit are closed, the flush closes the rest
+    void idle()
+    {
+	nvs::pool::flush();
+	nvs::pool::reset_stats();
+	nvs::pool::idle_limit(2);
+	{ nvs::stream a("idle_a", nvs::readwrite); }
+	{ nvs::stream b("idle_b", nvs::readwrite); }
+	{ nvs::stream c("idle_c", nvs::readwrite); }	// "idle_a" is closed
+	CHECK(nvs::pool::get_stats().closes == 1 && nvs::pool::get_stats().idle == 2);
+	{ nvs::stream b("idle_b", nvs::readwrite); }
+	{ nvs::stream a("idle_a", nvs::readwrite); }	// opened again, "idle_c" is closed
+	CHECK(nvs::pool::get_stats().opens == 4 && nvs::pool::get_stats().reuses == 1);
+	CHECK(nvs::pool::get_stats().closes == 2);
+
+	nvs::pool::idle_limit(0);	// closed on the release
+	{ nvs::stream d("idle_d", nvs::readwrite); }
+	CHECK(nvs::pool::get_stats().idle == 0 && nvs::pool::get_stats().closes == 5);
+	nvs::pool::idle_limit(nvs::pool::default_idle);
+	{ nvs::stream d("idle_d", nvs::readwrite); }
+	nvs::pool::flush();
+	CHECK(nvs::pool::get_stats().idle == 0 && nvs::pool::get_stats().closes == 6);
+    }; /* idle() */
+
+}; /* namespace */
+
+
+
+int main()
+{
+    if (!test::device(0x10000))
+	return 1;
+    reuse();
+    sharing();
+    idle();
+    return test::result("test_pool");
+}
@@ -0,0 +1,164 @@
+/* @file
+ * @brief Ring log: the wraparound, the batch, the reopening, the clear & the foreign index,
+ *	the clear of the stream shared by the tasks
+ *
+ * @section LICENCE
+ *
+ * This code is in the Public Domain (or CC0 licensed, at your option.)
+ *
+ * Unless required by applicable law or agreed to in writing, this
+ * software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <nvs.h>
+
+#include "nvstream"
+#include "test.h"
+
+
+namespace
+{
+
+    /// texts of the records, from the oldest
+    std::vector<std::string> records(nvs::ring_log& log)
+    {
+	    std::vector<std::string> out;
+
+	for (auto& rec: log)
+	    out.emplace_back(rec.data.begin(), rec.data.end());
+	return out;
+    }; /* records() */
+
+    /// entries of the namespace, the reserved ones included
+    size_t entries(const char space[])
+    {
+	    nvs_iterator_t it = nullptr;
+	    size_t n = 0;
+
+	for (esp_err_t rc = nvs_entry_find(NVS_DEFAULT_PART_NAME, space, NVS_TYPE_ANY, &it); rc == ESP_OK; rc = nvs_entry_next(&it))
+	    n++;
+	nvs_release_iterator(it);
+	return n;
+    }; /* entries() */
+
+
+    void wraparound()
+    {
+	    nvs::stream strm("ringlog", nvs::readwrite);
+	    std::vector<std::string> expected;
+
+	{
+		nvs::ring_log log(strm, "events", 16);
+
+	    CHECK_OK(log.status());
+	    for (int i = 0; i < 40; i++)
+		CHECK_OK(log.append("event " + std::to_string(i)));
+	    CHECK(log.size() == 16);
+	    CHECK(log.head() == 24 && log.tail() == 40);
+	}
+	for (int i = 24; i < 40; i++)
+	    expected.push_back("event " + std::to_string(i));
+	{
+		nvs::ring_log log(strm, "events", 4);	// the stored capacity is kept till the clear
+
+	    CHECK(log.capacity() == 16);
+	    CHECK(records(log) == expected);
+	    {
+		    nvs::ring_log::batch many(log);
+
+		for (int i = 40; i < 45; i++)
+		    CHECK_OK(many.append("event " + std::to_string(i)));
+		CHECK_OK(many.commit());
+	    }
+	    CHECK(log.tail() == 45 && log.head() == 29);
+	    CHECK(records(log).back() == "event 44");
+	    CHECK(entries("ringlog") == 16 + 2);	// the records, the index & the owner
+
+	    CHECK_OK(log.clear());
+	    CHECK(log.capacity() == 4 && log.size() == 0);
+	    CHECK(entries("ringlog") == 2);	// the records are erased
+	    CHECK_OK(log.append("after"));
+	    CHECK(records(log) == std::vector<std::string>{"after"});
+	}
+    }; /* wraparound() */
+
+
+    void foreign()
+    {
+	    nvs::stream strm("ringlog", nvs::readwrite);
+	    const char blob[] = "not the index of the log";
+
+	CHECK_OK(strm.write_blob("config", blob, sizeof(blob)));
+	{
+		nvs::ring_log log(strm, "config", 4);
+
+	    CHECK_ERR(log.status(), ESP_ERR_NVS_TYPE_MISMATCH);
+	    CHECK_ERR(log.append("x"), ESP_ERR_NVS_TYPE_MISMATCH);
+	    CHECK_ERR(log.clear(), ESP_ERR_NVS_TYPE_MISMATCH);
+	}
+
+	    std::vector<uint8_t> got;
+
+	CHECK_OK(strm.read_blob("config", got));
+	CHECK(got == std::vector<uint8_t>(blob, blob + sizeof(blob)));
+
+	// "cfg" & "cfg/bigdsyc" are of the same hash: the record keys are of the first one
+	    nvs::ring_log first(strm, "cfg", 4);
+
+	CHECK_OK(first.append("mine"));
+	{
+		nvs::ring_log second(strm, "cfg/bigdsyc", 4);
+
+	    CHECK_ERR(second.append("other"), ESP_ERR_INVALID_STATE);
+	}
+	CHECK(records(first) == std::vector<std::string>{"mine"});
+    }; /* foreign() */
+
+
+    // The clear erases the records under the lock of the stream, the other task writes on meanwhile
+    void shared()
+    {
+	    nvs::stream strm("ringshared", nvs::readwrite, nvs::noshadow, nvs::multi_task);
+	    nvs::ring_log log(strm, "faults", 4);
+	    esp_err_t rc = ESP_OK;	// the checks are of the main task
+	    std::thread writer([&strm, &rc]()
+	    {
+		for (uint32_t i = 0; i < 64 && rc == ESP_OK; i++)
+		    rc = strm.write("uptime", i);
+	    });
+
+	for (int i = 0; i < 16; i++)
+	{
+	    CHECK_OK(log.append("fault"));
+	    CHECK_OK(log.append("fault"));
+	    CHECK_OK(log.clear());
+	}; /* for int i = 0; i < 16; i++ */
+	writer.join();
+	CHECK_OK(rc);
+	CHECK(records(log).empty());
+
+	    uint32_t uptime = 0;
+
+	CHECK_OK(strm.read("uptime", uptime));
+	CHECK(uptime == 63);
+    }; /* shared() */
+
+}; /* namespace */
+
+
+
+int main()
+{
+    if (!test::device(0x20000))
+	return 1;
+    wraparound();
+    foreign();
+    shared();
+    return test::result("test_ringlog");
+}
@@ -0,0 +1,117 @@
+/* @file
+ * @brief Snapshot of the namespace: the round trip, the replace & the damaged snapshot
+ *
+ * @section LICENCE
+ *
+ * This code is in the Public Domain (or CC0 licensed, at your option.)
+ *
+ * Unless required by applicable law or agreed to in writing, this
+ * software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <nvs.h>
+
+#include "nvstream"
+#include "test.h"
+
+
+namespace
+{
+
+    void fill(nvs::stream& strm)
+    {
+	    const uint8_t blob[] = {1, 2, 3, 4, 5};
+
+	strm.write("i8", int8_t(-5));
+	strm.write("u32", uint32_t(0xDEADBEEF));
+	strm.write("i64", int64_t(-1234567890123LL));
+	strm.write_str("name", "device-42");
+	strm.write_blob("blob", blob, sizeof(blob));
+	strm.compress();
+	strm.write_str("long", std::string(200, 'z').c_str());	// kept compressed by the snapshot
+	strm.compress(false);
+	CHECK_OK(strm.commit());
+    }; /* fill() */
+
+
+    void round_trip()
+    {
+	    nvs::stream from("snapfrom", nvs::readwrite);
+	    nvs::stream to("snapto", nvs::readwrite);
+	    std::vector<uint8_t> image;
+	    nvs::snapshot::buffer out(image);
+	    std::map<nvs::key, nvs::value> src, dst;
+
+	fill(from);
+	CHECK_OK(from.export_snapshot(out));
+	CHECK(image.size() > 4);
+
+	to.write("stale", uint8_t(1));
+	{
+		nvs::snapshot::memory in(image);
+
+	    CHECK_OK(to.import_snapshot(in));
+	}
+	CHECK_OK(from.load(src));
+	CHECK_OK(to.load(dst));
+	CHECK(dst.size() == src.size() + 1);	// the item absent from the snapshot is kept
+	{
+		nvs::snapshot::memory in(image);
+
+	    CHECK_OK(to.import_snapshot(in, true));	// replace: it is erased
+	}
+	dst.clear();
+	CHECK_OK(to.load(dst));
+	CHECK(dst == src);
+
+	    std::string str;
+
+	CHECK_OK(to.read("long", str));
+	CHECK(str == std::string(200, 'z'));
+    }; /* round_trip() */
+
+
+    void damaged()
+    {
+	    nvs::stream from("snapfrom", nvs::readwrite);
+	    nvs::stream to("snapbad", nvs::readwrite);
+	    std::vector<uint8_t> image;
+	    nvs::snapshot::buffer out(image);
+	    std::map<nvs::key, nvs::value> dst;
+
+	CHECK_OK(from.export_snapshot(out));
+	image[image.size() / 2] ^= 0x55;
+	{
+		nvs::snapshot::memory in(image);	// rewindable: checked before the first write
+
+	    CHECK_ERR(to.import_snapshot(in), ESP_ERR_INVALID_CRC);
+	}
+	CHECK_OK(to.load(dst));
+	CHECK(dst.empty());
+
+	image.resize(image.size() / 2);
+	{
+		nvs::snapshot::memory in(image);
+
+	    CHECK_ERR(to.import_snapshot(in), ESP_ERR_INVALID_SIZE);
+	}
+    }; /* damaged() */
+
+}; /* namespace */
+
+
+
+int main()
+{
+    if (!test::device(0x40000))
+	return 1;
+    round_trip();
+    damaged();
+    return test::result("test_snapshot");
+}
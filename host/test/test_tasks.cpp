@@ -0,0 +1,111 @@
+/* @file
+ * @brief Stream shared by the tasks: the concurrent writes & reads of the own and
+ *	of the common keys, the task mode of the reopened stream
+ *
+ * Run it by the ThreadSanitizer build (-DNVS_SANITIZE_THREAD=ON) to check the races.
+ *
+ * @section LICENCE
+ *
+ * This code is in the Public Domain (or CC0 licensed, at your option.)
+ *
+ * Unless required by applicable law or agreed to in writing, this
+ * software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <nvs.h>
+
+#include "nvstream"
+#include "test.h"
+
+
+namespace
+{
+
+    constexpr int tasks = 4;
+    constexpr uint32_t rounds = 500;
+
+
+    // Each task writes & reads back its own key, all of them write the common one
+    void shared(nvs::shadow_mode shmode)
+    {
+	    nvs::stream strm("tasks", nvs::readwrite, shmode, nvs::multi_task);
+	    std::vector<std::thread> workers;
+	    int failed[tasks] = {};	// the checks are of the main task
+
+	CHECK(strm.is_shared());
+	for (int t = 0; t < tasks; t++)
+	    workers.emplace_back([&strm, &failed, t]()
+	    {
+		    const std::string own = "own" + std::to_string(t);
+
+		for (uint32_t i = 0; i < rounds; i++)
+		{
+			uint32_t back = 0;
+			std::string label;
+
+		    if (strm.write(own, i) != ESP_OK || strm.read(own, back) != ESP_OK || back != i)
+			failed[t]++;	// the result of the call is of this call, not of the other task
+		    if (strm.write("common", uint32_t(t)) != ESP_OK)
+			failed[t]++;
+		    if (strm.write("label", std::string(8, char('a' + t))) != ESP_OK
+			    || strm.read("label", label) != ESP_OK || label != std::string(8, label[0]))
+			failed[t]++;	// the string is written whole, never mixed
+		}; /* for uint32_t i = 0; i < rounds; i++ */
+	    });
+	for (auto& w: workers)
+	    w.join();
+	for (int t = 0; t < tasks; t++)
+	    CHECK(failed[t] == 0);
+	CHECK(strm.changed());	// set by the writes of all the tasks
+	CHECK_OK(strm.commit());
+
+	    uint32_t common = tasks;
+
+	CHECK_OK(strm.read("common", common));
+	CHECK(common < uint32_t(tasks));
+	for (int t = 0; t < tasks; t++)
+	{
+		uint32_t own = 0;
+
+	    CHECK_OK(strm.read("own" + std::to_string(t), own));
+	    CHECK(own == rounds - 1);
+	}; /* for int t = 0; t < tasks; t++ */
+    }; /* shared() */
+
+
+    // The locks of the open stream are not replaced: the other task mode needs the close first
+    void mode()
+    {
+	    nvs::stream strm("tasks", nvs::readwrite, nvs::noshadow, nvs::multi_task);
+	    uint32_t own = 0;
+
+	CHECK_ERR(strm.open("tasks", nvs::readwrite, nvs::noshadow, nvs::single_task), ESP_ERR_INVALID_STATE);
+	CHECK(strm.is_shared());
+	CHECK_OK(strm.read("own0", own));	// still open
+	CHECK_OK(strm.open("tasks", nvs::readonly, nvs::noshadow, nvs::multi_task));	// the same mode is reopened
+	CHECK_OK(strm.close());
+	CHECK_OK(strm.open("tasks", nvs::readwrite, nvs::noshadow, nvs::single_task));
+	CHECK(!strm.is_shared());
+	CHECK_OK(strm.read("own0", own));
+	CHECK(own == rounds - 1);
+    }; /* mode() */
+
+}; /* namespace */
+
+
+
+int main()
+{
+    if (!test::device(0x20000))
+	return 1;
+    shared(nvs::noshadow);
+    shared(nvs::shadowed);
+    mode();
+    return test::result("test_tasks");
+}
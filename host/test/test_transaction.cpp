@@ -0,0 +1,280 @@
+/* @file
+ * @brief Transactions of the stream: the batch, its limit, the recovery of the interrupted one
+ *
+ * The reset during the commit is modelled by the journal, written by the NVS C API
+ * into the namespace before its first opening: the opening completes it or, if it
+ * is broken, drops it without touching the items.
+ *
+ * @section LICENCE
+ *
+ * This code is in the Public Domain (or CC0 licensed, at your option.)
+ *
+ * Unless required by applicable law or agreed to in writing, this
+ * software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include <nvs.h>
+
+#include "nvstream"
+#include "test.h"
+
+
+namespace
+{
+
+    constexpr uint32_t journal_magic = 0x5854564E;	// "NVTX"
+
+    /// CRC-32 of the journal (IEEE 802.3)
+    uint32_t crc32(const std::string& data)
+    {
+	    uint32_t crc = ~0u;
+
+	for (unsigned char c: data)
+	{
+	    crc ^= c;
+	    for (int bit = 0; bit < 8; bit++)
+		crc = (crc >> 1) ^ (0xEDB88320u & -(crc & 1));
+	}; /* for unsigned char c: data */
+	return ~crc;
+    }; /* crc32() */
+
+    template <typename T>
+    void put(std::string& out, T val)
+    {
+	out.append(reinterpret_cast<const char*>(&val), sizeof(val));
+    }; /* put() */
+
+    /// the journal entry of the u32 item
+    void put_u32(std::string& journal, const char name[], uint32_t val)
+    {
+	put(journal, uint8_t(NVS_TYPE_U32));
+	put(journal, uint8_t(std::string(name).size()));
+	journal += name;
+	put(journal, uint32_t(sizeof(val)));
+	put(journal, val);
+    }; /* put_u32() */
+
+    /// store the journal into the namespace, as it was left by the reset
+    void leave_journal(const char space[], const std::string& journal)
+    {
+	    nvs_handle_t h;
+
+	CHECK_OK(nvs_open(space, NVS_READWRITE, &h));
+	CHECK_OK(nvs_set_blob(h, nvs::stream::transaction::journal_key, journal.data(), journal.size()));
+	CHECK_OK(nvs_commit(h));
+	nvs_close(h);
+    }; /* leave_journal() */
+
+    bool journal_left(const char space[])
+    {
+	    nvs_handle_t h;
+	    size_t size = 0;
+	    esp_err_t rc = nvs_open(space, NVS_READONLY, &h);
+
+	if (rc == ESP_OK)
+	{
+	    rc = nvs_get_blob(h, nvs::stream::transaction::journal_key, nullptr, &size);
+	    nvs_close(h);
+	}; /* if rc == ESP_OK */
+	return rc == ESP_OK;
+    }; /* journal_left() */
+
+
+    void batch()
+    {
+	    nvs::stream strm("txn", nvs::readwrite);
+	    nvs::stream::transaction tx(strm);
+	    uint32_t a = 0;
+	    std::string s;
+
+	CHECK_OK(tx.write("a", uint32_t(1)));
+	CHECK_OK(tx.write("a", uint32_t(2)));	// the last write of the key wins
+	CHECK_OK(tx.write_str("s", "text"));
+	CHECK(tx.staged() == 2);
+	CHECK_ERR(strm.read("a", a), ESP_ERR_NVS_NOT_FOUND);	// nothing is written before the commit
+	CHECK_OK(tx.commit());
+	CHECK(tx.staged() == 0);
+	CHECK(tx.generation() == 1);
+	CHECK_OK(strm.read("a", a));
+	CHECK(a == 2);
+	CHECK_OK(strm.read("s", s));
+	CHECK(s == "text");
+
+	tx.write("a", uint32_t(3));
+	tx.rollback();
+	CHECK_OK(tx.commit());
+	CHECK_OK(strm.read("a", a));
+	CHECK(a == 2);
+
+	tx.write("a", uint32_t(2));	// unchanged: no journal, no generation
+	CHECK_OK(tx.commit());
+	CHECK(tx.generation() == 1);
+	CHECK(!journal_left("txn"));
+    }; /* batch() */
+
+
+    void limit()
+    {
+	    nvs::stream strm("txbig", nvs::readwrite);
+	    nvs::stream::transaction tx(strm);
+	    uint8_t val = 0;
+
+	for (size_t i = 0; i <= nvs::stream::transaction::max_items; i++)
+	    tx.write(nvs::key(("k" + std::to_string(i)).c_str()), uint8_t(1));
+	CHECK_ERR(tx.commit(), ESP_ERR_INVALID_SIZE);
+	CHECK_ERR(strm.read("k5", val), ESP_ERR_NVS_NOT_FOUND);
+	CHECK(!journal_left("txbig"));
+    }; /* limit() */
+
+
+    void recovery()
+    {
+	    std::string journal;
+	    uint32_t a = 0, b = 0, gen = 0;
+
+	put(journal, journal_magic);
+	put(journal, uint32_t(7));
+	put(journal, uint16_t(2));
+	put_u32(journal, "a", 10);
+	put_u32(journal, "b", 20);
+	put(journal, crc32(journal));
+	leave_journal("txrec", journal);
+	{
+		nvs::stream strm("txrec", nvs::readwrite);	// the first opening completes the transaction
+
+	    CHECK_OK(strm.status());
+	    CHECK_OK(strm.read("a", a));
+	    CHECK_OK(strm.read("b", b));
+	    CHECK_OK(strm.read(nvs::stream::transaction::generation_key, gen));
+	}
+	CHECK(a == 10 && b == 20);
+	CHECK(gen == 7);
+	CHECK(!journal_left("txrec"));
+    }; /* recovery() */
+
+
+    void broken()
+    {
+	    std::string torn, corrupted;
+	    uint32_t a = 0;
+
+	// torn: the CRC does not match, the transaction was not started
+	put(torn, journal_magic);
+	put(torn, uint32_t(1));
+	put(torn, uint16_t(1));
+	put_u32(torn, "a", 10);
+	put(torn, uint32_t(0));
+	leave_journal("txtorn", torn);
+	{
+		nvs::stream strm("txtorn", nvs::readwrite);
+
+	    CHECK_ERR(strm.read("a", a), ESP_ERR_NVS_NOT_FOUND);
+	}
+	CHECK(!journal_left("txtorn"));
+
+	// the CRC is right, the count is of two entries: nothing is applied
+	put(corrupted, journal_magic);
+	put(corrupted, uint32_t(1));
+	put(corrupted, uint16_t(2));
+	put_u32(corrupted, "a", 10);
+	put(corrupted, crc32(corrupted));
+	leave_journal("txbad", corrupted);
+	{
+		nvs::stream strm("txbad", nvs::readwrite);
+
+	    CHECK_ERR(strm.read("a", a), ESP_ERR_NVS_NOT_FOUND);
+	}
+	CHECK(!journal_left("txbad"));
+    }; /* broken() */
+
+
+    /// fill the partition of the handle by the 1000-byte blobs; the number of them
+    int fill(nvs_handle_t h)
+    {
+	    const std::string blob(1000, 'f');
+	    int n = 0;
+
+	while (nvs_set_blob(h, ("f" + std::to_string(n)).c_str(), blob.data(), blob.size()) == ESP_OK)
+	    n++;
+	nvs_commit(h);
+	return n;
+    }; /* fill() */
+
+    /// the items of the batch, stored whole
+    int applied(nvs::stream& strm, int items)
+    {
+	    std::vector<uint8_t> got;
+	    int n = 0;
+
+	for (int i = 0; i < items; i++)
+	    n += strm.read_blob(nvs::key(("a" + std::to_string(i)).c_str()), got) == ESP_OK;
+	return n;
+    }; /* applied() */
+
+    // The batch fails on the full partition after its journal is written: the next commit
+    // completes it before its own batch, the first batch is not left half-applied
+    void failed_replay()
+    {
+	    constexpr int items = 8;
+	    nvs::stream strm;
+	    nvs_handle_t h;
+	    std::vector<uint8_t> blob(600, 'a');
+	    int fillers, first;
+
+	CHECK_OK(nvs_emul::partition("small", 0x6000));
+	CHECK(nvs::dev::check("small"));
+	CHECK_OK(nvs_open_from_partition("small", "filler", NVS_READWRITE, &h));
+	fillers = fill(h);
+	for (int i = 0; i < 9; i++)	// room for the journal & a half of the items
+	    nvs_erase_key(h, ("f" + std::to_string(i)).c_str());
+	nvs_commit(h);
+	CHECK_OK(strm.open_partition("small", "txfull", nvs::readwrite));
+
+	    nvs::stream::transaction tx(strm);
+
+	for (int i = 0; i < items; i++)
+	    tx.write_blob(nvs::key(("a" + std::to_string(i)).c_str()), blob.data(), blob.size());
+	CHECK_ERR(tx.commit(), ESP_ERR_NVS_NOT_ENOUGH_SPACE);
+	first = applied(strm, items);
+	CHECK(first > 0 && first < items);	// the failure is in the middle of the batch
+
+	// no room still: the journal is not replaced, the next batch is refused
+	tx.write("b", uint32_t(1));
+	CHECK_ERR(tx.commit(), ESP_ERR_NVS_NOT_ENOUGH_SPACE);
+	CHECK(applied(strm, items) < items);
+
+	for (int i = 9; i < fillers; i++)
+	    nvs_erase_key(h, ("f" + std::to_string(i)).c_str());
+	nvs_commit(h);
+	nvs_close(h);
+	tx.write("b", uint32_t(2));
+	CHECK_OK(tx.commit());
+	CHECK(applied(strm, items) == items);
+
+	    uint32_t b = 0;
+
+	CHECK_OK(strm.read("b", b));
+	CHECK(b == 2);
+    }; /* failed_replay() */
+
+}; /* namespace */
+
+
+
+int main()
+{
+    if (!test::device(0x80000))
+	return 1;
+    batch();
+    limit();
+    recovery();
+    broken();
+    failed_replay();
+    return test::result("test_transaction");
+}
@@ -0,0 +1,193 @@
+/* @file
+ * @brief Write-behind of the stream: the merge, the flush barrier, the policy & the stored items
+ *
+ * @section LICENCE
+ *
+ * This code is in the Public Domain (or CC0 licensed, at your option.)
+ *
+ * Unless required by applicable law or agreed to in writing, this
+ * software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <nvs.h>
+
+#include "nvstream"
+#include "test.h"
+
+
+namespace
+{
+
+    /// the item as stored: the bytes of the blob or of the string, its NVS type
+    std::vector<uint8_t> stored(const char space[], const char name[], nvs_type_t& type)
+    {
+	    nvs_handle_t h;
+	    std::vector<uint8_t> out;
+	    size_t size = 0;
+
+	type = NVS_TYPE_ANY;
+	if (nvs_open(space, NVS_READONLY, &h) != ESP_OK)
+	    return out;
+	if (nvs_get_blob(h, name, nullptr, &size) == ESP_OK)
+	{
+	    type = NVS_TYPE_BLOB;
+	    out.resize(size);
+	    nvs_get_blob(h, name, out.data(), &size);
+	}
+	else if (nvs_get_str(h, name, nullptr, &size) == ESP_OK)
+	{
+	    type = NVS_TYPE_STR;
+	    out.resize(size);
+	    nvs_get_str(h, name, reinterpret_cast<char*>(out.data()), &size);
+	}; /* else if nvs_get_str(...) == ESP_OK */
+	nvs_close(h);
+	return out;
+    }; /* stored() */
+
+
+    void merge()
+    {
+	    nvs::stream strm("behind", nvs::readwrite, nvs::noshadow, nvs::multi_task);
+	    nvs::stream::write_behind::policy pol;
+	    uint32_t val = 0;
+	    std::string str;
+
+	pol.batch = 100;
+	pol.interval_ms = 60000;	// applied by the flush only
+	{
+		nvs::stream::write_behind behind(strm, pol);
+
+	    for (uint32_t i = 0; i < 10; i++)
+		CHECK_OK(behind.write("count", i));
+	    CHECK_OK(behind.write_str("name", "first"));
+	    CHECK_OK(behind.write_str("name", "last"));
+	    CHECK(behind.pending() == 2);
+	    CHECK_ERR(strm.read("count", val), ESP_ERR_NVS_NOT_FOUND);	// queued, not applied
+
+		std::shared_future<esp_err_t> done = behind.flush();
+
+	    CHECK_OK(done.get());
+	    CHECK(behind.pending() == 0);
+	    CHECK_OK(strm.read("count", val));
+	    CHECK(val == 9);	// the last write wins
+	    CHECK_OK(strm.read("name", str));
+	    CHECK(str == "last");
+
+		nvs::stream::write_behind::stats st = behind.get_stats();
+
+	    CHECK(st.queued == 12 && st.coalesced == 10);
+	    CHECK(st.applied == 2 && st.batches == 1 && st.errors == 0);
+
+	    CHECK_OK(behind.write("count", uint32_t(100)));
+	}	// the destructor applies & commits the rest
+	CHECK_OK(strm.read("count", val));
+	CHECK(val == 100);
+    }; /* merge() */
+
+
+    void policy()
+    {
+	    nvs::stream strm("behindpol", nvs::readwrite, nvs::noshadow, nvs::multi_task);
+	    nvs::stream::write_behind::policy pol;
+
+	pol.batch = 4;
+	pol.interval_ms = 20;
+	{
+		nvs::stream::write_behind behind(strm, pol);
+
+	    behind.write("one", uint8_t(1));	// the interval
+	    for (int i = 0; i < 200 && behind.pending(); i++)
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	    CHECK(behind.pending() == 0);
+
+	    for (uint8_t i = 0; i < 4; i++)	// the full batch
+		behind.write(nvs::key(("k" + std::to_string(i)).c_str()), i);
+	    for (int i = 0; i < 200 && behind.pending(); i++)
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	    CHECK(behind.pending() == 0);
+	    CHECK_OK(behind.flush().get());
+	    CHECK(behind.get_stats().applied == 5);
+	}
+
+	// the error of the worker is returned by the next flush
+	    nvs::stream readonly("behindpol", nvs::readonly, nvs::noshadow, nvs::multi_task);
+	    nvs::stream::write_behind behind(readonly, pol);
+
+	behind.write("one", uint8_t(2));
+	CHECK(behind.flush().get() != ESP_OK);
+	CHECK(behind.get_stats().errors > 0);
+	CHECK_OK(behind.flush().get());	// since the previous flush
+    }; /* policy() */
+
+
+    struct record
+    {
+	uint16_t id;
+	char text[50];
+    }; /* struct record */
+
+    // The stored items are the same as of the direct writes, with & without the compression
+    void same_items()
+    {
+	    record rec{7, "the record, the record, the record, the record"};
+	    std::vector<uint8_t> blob(500, 'b');
+	    const std::string line(80, 's');
+
+	for (bool packing: {false, true})
+	{
+		const char* direct_space = packing? "packdirect": "direct";
+		const char* behind_space = packing? "packbehind": "behind2";
+
+	    {
+		    nvs::stream strm(direct_space, nvs::readwrite);
+
+		strm.compress(packing);
+		strm.write("rec", rec);
+		strm.write_blob("blob", blob.data(), blob.size());
+		strm.write_str("line", line.c_str());
+		strm.write("num", int16_t(-3));
+		CHECK_OK(strm.commit());
+	    }
+	    {
+		    nvs::stream strm(behind_space, nvs::readwrite, nvs::noshadow, nvs::multi_task);
+
+		strm.compress(packing);
+
+		    nvs::stream::write_behind behind(strm);
+
+		behind.write("rec", rec);
+		behind.write_blob("blob", blob.data(), blob.size());
+		behind.write_str("line", line.c_str());
+		behind.write("num", int16_t(-3));
+		CHECK_OK(behind.flush().get());
+	    }
+	    for (const char* name: {"rec", "blob", "line"})
+	    {
+		    nvs_type_t direct, queued;
+
+		CHECK(stored(direct_space, name, direct) == stored(behind_space, name, queued));
+		CHECK(direct == queued && direct != NVS_TYPE_ANY);
+	    }; /* for const char* name: ... */
+	}; /* for bool packing: ... */
+    }; /* same_items() */
+
+}; /* namespace */
+
+
+
+int main()
+{
+    if (!test::device(0x40000))
+	return 1;
+    merge();
+    policy();
+    same_items();
+    return test::result("test_write_behind");
+}
@@ -1,24 +1,27 @@
-# User submodules for micropython, C++ example 
+# MicroPython user module 'nvs' for the CMake-based ports (esp32): the nvs::stream
+# over the NVS of the ESP-IDF, e.g.
+#	make -C ports/esp32 USER_C_MODULES=<path of the 'nvs' clone>/micropython.cmake
+# The Make-based ports (unix) build it by micropython.mk, over the emulated partition.
 
-#message(WARNING "C++ example of micropython user submodules")
-message(STATUS "### Build nvs C++ example of micropython user submodules for possibly future use ###")
-#message(VERBOSE "C++ example of micropython user submodules")
+message(STATUS "### Build nvs C++ user module of micropython ###")
 
+add_library(usermod_nvs_cpp INTERFACE)
 
+target_sources(usermod_nvs_cpp INTERFACE
+    ${CMAKE_CURRENT_LIST_DIR}/nvs_device.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/micropython/nvs_mp.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/micropython/nvsmodule.c
+)
 
-## Create an INTERFACE library for our CPP module.
-#add_library(usermod_cppexample INTERFACE)
-#
-## Add our source files to the library.
-#target_sources(usermod_cppexample INTERFACE
-#    ${CMAKE_CURRENT_LIST_DIR}/example.cpp
-#    ${CMAKE_CURRENT_LIST_DIR}/examplemodule.c
-#)
-#
-## Add the current directory as an include directory.
-#target_include_directories(usermod_cppexample INTERFACE
-#    ${CMAKE_CURRENT_LIST_DIR}
-#)
-#
-## Link our INTERFACE library to the usermod target.
-#target_link_libraries(usermod INTERFACE usermod_cppexample)
+target_include_directories(usermod_nvs_cpp INTERFACE
+    ${CMAKE_CURRENT_LIST_DIR}
+    ${CMAKE_CURRENT_LIST_DIR}/micropython
+)
+
+# the tab indentation of the sources is not the error of the -Wall -Werror build
+target_compile_options(usermod_nvs_cpp INTERFACE
+    $<$<COMPILE_LANGUAGE:CXX>:-std=gnu++20>
+    $<$<COMPILE_LANGUAGE:CXX>:-Wno-misleading-indentation>
+)
+
+target_link_libraries(usermod INTERFACE usermod_nvs_cpp)
@@ -0,0 +1,19 @@
+# MicroPython user module 'nvs' for the Make-based ports (unix): the nvs::stream
+# over the emulated NVS partition of host/. The port includes the */micropython.mk
+# of the USER_C_MODULES directory: it is the parent of the 'nvs' clone, e.g. for
+# the clone ~/modules/nvs
+#	make -C ports/unix USER_C_MODULES=~/modules
+
+NVS_MOD_DIR := $(USERMOD_DIR)
+
+SRC_USERMOD_C += $(NVS_MOD_DIR)/micropython/nvsmodule.c
+SRC_USERMOD_CXX += $(NVS_MOD_DIR)/micropython/nvs_mp.cpp \
+	$(NVS_MOD_DIR)/nvs_device.cpp \
+	$(NVS_MOD_DIR)/host/nvs_emul.cpp \
+	$(NVS_MOD_DIR)/host/esp_host.cpp
+
+CFLAGS_USERMOD += -I$(NVS_MOD_DIR)/micropython
+# the port builds with -Wall -Werror: the tab indentation of the sources is not the error here
+CXXFLAGS_USERMOD += -I$(NVS_MOD_DIR) -I$(NVS_MOD_DIR)/micropython -I$(NVS_MOD_DIR)/host/include \
+	-std=gnu++20 -Wno-misleading-indentation
+LDFLAGS_USERMOD += -lstdc++ -lpthread
@@ -0,0 +1,412 @@
+/* @file
+ * @brief MicroPython module 'nvs': the calls of the nvs::stream
+ *
+ * The MicroPython raises by the longjmp: no C++ object with the destructor may
+ * be alive in the scope of the raise, so the NVS calls are done first and the
+ * errors are raised after them. The blob is read straight into the buffer of
+ * the new bytes object or into the caller's buffer, and written from the
+ * caller's buffer: no intermediate copy.
+ *
+ * @section LICENCE
+ *
+ * This code is in the Public Domain (or CC0 licensed, at your option.)
+ *
+ * Unless required by applicable law or agreed to in writing, this
+ * software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <cstring>
+#include <new>
+#include <string_view>
+#include <nvs_flash.h>
+#include <nvs.h>
+#include <esp_err.h>
+#ifndef ESP_PLATFORM
+#include <nvs_emul.h>
+#endif
+
+#include "nvs_device"
+#include "nvstream"
+
+extern "C" {
+#include "py/objstr.h"
+#include "nvsmodule.h"
+}
+
+
+namespace
+{
+
+    /// OSError(code, name) of the NVS error
+    [[noreturn]] void raise(esp_err_t rc)
+    {
+	    const char* name = esp_err_to_name(rc);
+	    mp_obj_t args[2] = {mp_obj_new_int(rc), mp_obj_new_str(name, strlen(name))};
+
+	nlr_raise(mp_obj_new_exception_args(&mp_type_OSError, 2, args));
+    }; /* raise() */
+
+    /// the value of the getter: the default of the absent item, KeyError without it
+    mp_obj_t absent(esp_err_t rc, mp_obj_t key, mp_obj_t dflt)
+    {
+	if (rc != ESP_ERR_NVS_NOT_FOUND)
+	    raise(rc);
+	if (dflt == MP_OBJ_NULL)
+	    nlr_raise(mp_obj_new_exception_arg1(&mp_type_KeyError, key));
+	return dflt;
+    }; /* absent() */
+
+
+    nvs::stream& stream_of(mp_obj_t self)
+    {
+	    nvs_mp_stream_obj_t* obj = static_cast<nvs_mp_stream_obj_t*>(MP_OBJ_TO_PTR(self));
+
+	if (!obj->strm)
+	    nvs_mp_raise_closed();
+	return *static_cast<nvs::stream*>(obj->strm);
+    }; /* stream_of() */
+
+    /// the key of the str object; the too long key fails in the stream by ESP_ERR_NVS_KEY_TOO_LONG
+    nvs::key key_of(mp_obj_t key)
+    {
+	    size_t len;
+	    const char* str = mp_obj_str_get_data(key, &len);
+
+	return nvs::key(std::string_view(str, len));
+    }; /* key_of() */
+
+
+    constexpr unsigned bits_of(int type) { return (type & 0x0F) * 8; };
+    constexpr bool is_signed(int type) { return (type & 0x10) != 0; };
+
+    /// the int object as the 64-bit pattern of the item type; OverflowError out of its range
+    uint64_t to_bits(mp_obj_t value, int type)
+    {
+	    unsigned bits = bits_of(type);
+	    int64_t lo = is_signed(type)? -(int64_t(1) << (bits - 1)): 0;
+	    uint64_t hi = is_signed(type)? (uint64_t(1) << (bits - 1)) - 1: (bits == 64)? UINT64_MAX: (uint64_t(1) << bits) - 1;
+	    mp_obj_t mask;
+
+	if (!mp_obj_is_int(value))
+	    value = mp_obj_new_int(mp_obj_get_int(value));	// bool is int, other types raise TypeError
+	if (mp_obj_is_small_int(value))
+	{
+		int64_t v = MP_OBJ_SMALL_INT_VALUE(value);
+
+	    if (v < lo || (v > 0 && uint64_t(v) > hi))
+		nvs_mp_raise_range();
+	    return uint64_t(v);
+	}; /* if mp_obj_is_small_int(value) */
+	// the long int: checked by the comparisons, taken by the 32-bit halves
+	if (mp_binary_op(MP_BINARY_OP_LESS, value, mp_obj_new_int_from_ll(lo)) == mp_const_true
+		|| mp_binary_op(MP_BINARY_OP_MORE, value, mp_obj_new_int_from_ull(hi)) == mp_const_true)
+	    nvs_mp_raise_range();
+	mask = mp_obj_new_int_from_uint(UINT32_MAX);
+	return uint64_t(uint32_t(mp_obj_get_int_truncated(mp_binary_op(MP_BINARY_OP_AND, value, mask))))
+		| uint64_t(uint32_t(mp_obj_get_int_truncated(mp_binary_op(MP_BINARY_OP_AND,
+			mp_binary_op(MP_BINARY_OP_RSHIFT, value, MP_OBJ_NEW_SMALL_INT(32)), mask)))) << 32;
+    }; /* to_bits() */
+
+
+    esp_err_t write_int(nvs::stream& strm, const nvs::key& name, uint64_t bits, int type)
+    {
+	switch (type)
+	{
+	case NVS_MP_U8:  return strm.write(name, uint8_t(bits));
+	case NVS_MP_I8:  return strm.write(name, int8_t(bits));
+	case NVS_MP_U16: return strm.write(name, uint16_t(bits));
+	case NVS_MP_I16: return strm.write(name, int16_t(bits));
+	case NVS_MP_U32: return strm.write(name, uint32_t(bits));
+	case NVS_MP_I32: return strm.write(name, int32_t(bits));
+	case NVS_MP_U64: return strm.write(name, uint64_t(bits));
+	default:	 return strm.write(name, int64_t(bits));
+	}; /* switch type */
+    }; /* write_int() */
+
+
+    template <typename T>
+    esp_err_t read_int(nvs::stream& strm, const nvs::key& name, mp_obj_t& value)
+    {
+	    T val;
+	    esp_err_t rc = strm.read(name, val);
+
+	if (rc != ESP_OK)
+	    return rc;
+	if constexpr (std::is_same_v<T, uint64_t>)
+	    value = mp_obj_new_int_from_ull(val);
+	else if constexpr (std::is_same_v<T, int64_t>)
+	    value = mp_obj_new_int_from_ll(val);
+	else if constexpr (std::is_same_v<T, uint32_t>)
+	    value = mp_obj_new_int_from_uint(val);
+	else
+	    value = mp_obj_new_int(val);
+	return ESP_OK;
+    }; /* read_int() */
+
+
+    /// the value of the update(): the int - as i32 or i64, the str - as the string, the buffer - as the blob
+    esp_err_t write_item(nvs::stream& strm, mp_obj_t key, mp_obj_t value)
+    {
+	    nvs::key name = key_of(key);
+	    mp_buffer_info_t bufinfo;
+
+	if (mp_obj_is_str(value))
+	    return strm.write_str(name, mp_obj_str_get_str(value));
+	if (mp_obj_is_int(value) || mp_obj_is_bool(value))
+	{
+		bool narrow = mp_obj_is_small_int(value) && MP_OBJ_SMALL_INT_VALUE(value) >= INT32_MIN
+			&& MP_OBJ_SMALL_INT_VALUE(value) <= INT32_MAX;
+
+	    return narrow? strm.write(name, int32_t(MP_OBJ_SMALL_INT_VALUE(value))):
+		    mp_obj_is_bool(value)? strm.write(name, int32_t(mp_obj_is_true(value))):
+		    strm.write(name, int64_t(to_bits(value, NVS_MP_I64)));
+	}; /* if mp_obj_is_int(value) || ... */
+	if (mp_get_buffer(value, &bufinfo, MP_BUFFER_READ))
+	    return strm.write_blob(name, bufinfo.buf, bufinfo.len);
+	nvs_mp_raise_item_type();
+    }; /* write_item() */
+
+}; /* namespace */
+
+
+
+///--[ Stream ]---------------------------------------------------------------------------------------------------------
+
+void* nvs_mp_open(const char* part, const char* space, int mode, bool shadow)
+{
+	nvs::stream* strm = new (std::nothrow) nvs::stream();
+	nvs::open_mode omode = (mode == NVS_MP_READWRITE)? nvs::readwrite: nvs::readonly;
+	nvs::shadow_mode smode = shadow? nvs::shadowed: nvs::noshadow;
+	esp_err_t rc = ESP_ERR_NO_MEM;
+
+    if (strm)
+	rc = part? strm->open_partition(part, space, omode, smode): strm->open(space, omode, smode);
+    if (rc != ESP_OK)
+    {
+	delete strm;
+	raise(rc);
+    }; /* if rc != ESP_OK */
+    return strm;
+}; /* nvs_mp_open() */
+
+
+/// the stream is closed by its destructor; the second close does nothing
+void nvs_mp_close(nvs_mp_stream_obj_t* self)
+{
+	nvs::stream* strm = static_cast<nvs::stream*>(self->strm);
+
+    self->strm = nullptr;
+    delete strm;
+}; /* nvs_mp_close() */
+
+
+mp_obj_t nvs_mp_get_int(mp_obj_t self, mp_obj_t key, mp_obj_t dflt, int type)
+{
+	nvs::stream& strm = stream_of(self);
+	nvs::key name = key_of(key);
+	mp_obj_t value = mp_const_none;
+	esp_err_t rc;
+
+    switch (type)
+    {
+    case NVS_MP_U8:  rc = read_int<uint8_t>(strm, name, value); break;
+    case NVS_MP_I8:  rc = read_int<int8_t>(strm, name, value); break;
+    case NVS_MP_U16: rc = read_int<uint16_t>(strm, name, value); break;
+    case NVS_MP_I16: rc = read_int<int16_t>(strm, name, value); break;
+    case NVS_MP_U32: rc = read_int<uint32_t>(strm, name, value); break;
+    case NVS_MP_I32: rc = read_int<int32_t>(strm, name, value); break;
+    case NVS_MP_U64: rc = read_int<uint64_t>(strm, name, value); break;
+    default:	     rc = read_int<int64_t>(strm, name, value); break;
+    }; /* switch type */
+    return (rc == ESP_OK)? value: absent(rc, key, dflt);
+}; /* nvs_mp_get_int() */
+
+
+void nvs_mp_set_int(mp_obj_t self, mp_obj_t key, mp_obj_t value, int type)
+{
+	nvs::stream& strm = stream_of(self);
+	esp_err_t rc = write_int(strm, key_of(key), to_bits(value, type), type);
+
+    if (rc != ESP_OK)
+	raise(rc);
+}; /* nvs_mp_set_int() */
+
+
+/// the string is read into the buffer of the new str object
+mp_obj_t nvs_mp_get_str(mp_obj_t self, mp_obj_t key, mp_obj_t dflt)
+{
+	nvs::stream& strm = stream_of(self);
+	nvs::key name = key_of(key);
+	size_t length = 0;
+	esp_err_t rc = strm.read_str(name, nullptr, length);
+	vstr_t vstr;
+
+    if (rc != ESP_OK)
+	return absent(rc, key, dflt);
+    vstr_init_len(&vstr, length? length - 1: 0);	// the room of the terminating zero is allocated by the vstr
+    if ((rc = strm.read_str(name, vstr.buf, length)) != ESP_OK)
+    {
+	vstr_clear(&vstr);
+	return absent(rc, key, dflt);
+    }; /* if (rc = strm.read_str(...)) != ESP_OK */
+    return mp_obj_new_str_from_vstr(&vstr);
+}; /* nvs_mp_get_str() */
+
+
+void nvs_mp_set_str(mp_obj_t self, mp_obj_t key, mp_obj_t value)
+{
+	nvs::stream& strm = stream_of(self);
+	esp_err_t rc = strm.write_str(key_of(key), mp_obj_str_get_str(value));
+
+    if (rc != ESP_OK)
+	raise(rc);
+}; /* nvs_mp_set_str() */
+
+
+/// the blob is read into the buffer of the new bytes object
+mp_obj_t nvs_mp_get_blob(mp_obj_t self, mp_obj_t key, mp_obj_t dflt)
+{
+	nvs::stream& strm = stream_of(self);
+	nvs::key name = key_of(key);
+	size_t length = 0;
+	esp_err_t rc = strm.read_blob(name, nullptr, length);
+	vstr_t vstr;
+
+    if (rc != ESP_OK)
+	return absent(rc, key, dflt);
+    vstr_init_len(&vstr, length);
+    if ((rc = strm.read_blob(name, vstr.buf, length)) != ESP_OK)
+    {
+	vstr_clear(&vstr);
+	return absent(rc, key, dflt);
+    }; /* if (rc = strm.read_blob(...)) != ESP_OK */
+    vstr.len = length;
+    return mp_obj_new_bytes_from_vstr(&vstr);
+}; /* nvs_mp_get_blob() */
+
+
+/// the blob is read into the caller's writable buffer; the short buffer fails by ESP_ERR_NVS_INVALID_LENGTH
+mp_obj_t nvs_mp_readinto_blob(mp_obj_t self, mp_obj_t key, mp_obj_t buf)
+{
+	nvs::stream& strm = stream_of(self);
+	mp_buffer_info_t bufinfo;
+	size_t length;
+	esp_err_t rc;
+
+    mp_get_buffer_raise(buf, &bufinfo, MP_BUFFER_WRITE);
+    length = bufinfo.len;
+    if ((rc = strm.read_blob(key_of(key), bufinfo.buf, length)) != ESP_OK)
+	absent(rc, key, MP_OBJ_NULL);
+    return mp_obj_new_int_from_uint(length);
+}; /* nvs_mp_readinto_blob() */
+
+
+void nvs_mp_set_blob(mp_obj_t self, mp_obj_t key, mp_obj_t buf)
+{
+	nvs::stream& strm = stream_of(self);
+	mp_buffer_info_t bufinfo;
+	esp_err_t rc;
+
+    mp_get_buffer_raise(buf, &bufinfo, MP_BUFFER_READ);
+    if ((rc = strm.write_blob(key_of(key), bufinfo.buf, bufinfo.len)) != ESP_OK)
+	raise(rc);
+}; /* nvs_mp_set_blob() */
+
+
+void nvs_mp_commit(mp_obj_t self)
+{
+	esp_err_t rc = stream_of(self).commit();
+
+    if (rc != ESP_OK)
+	raise(rc);
+}; /* nvs_mp_commit() */
+
+
+/// all the items are written, then committed once; the first failed write raises, the items
+/// written before it stay uncommitted. Returns the number of the items written
+mp_obj_t nvs_mp_update(mp_obj_t self, mp_obj_t items, bool commit)
+{
+	nvs::stream& strm = stream_of(self);
+	size_t count = 0;
+	esp_err_t rc = ESP_OK;
+
+    if (mp_obj_is_type(items, &mp_type_dict))
+    {
+	    mp_map_t* map = mp_obj_dict_get_map(items);
+
+	for (size_t i = 0; i < map->alloc && rc == ESP_OK; i++)
+	    if (mp_map_slot_is_filled(map, i) && (rc = write_item(strm, map->table[i].key, map->table[i].value)) == ESP_OK)
+		count++;
+    }
+    else
+    {
+	    mp_obj_iter_buf_t iter_buf;
+	    mp_obj_t iter = mp_getiter(items, &iter_buf);
+	    mp_obj_t item;
+	    mp_obj_t* pair;
+
+	while (rc == ESP_OK && (item = mp_iternext(iter)) != MP_OBJ_STOP_ITERATION)
+	{
+	    mp_obj_get_array_fixed_n(item, 2, &pair);
+	    if ((rc = write_item(strm, pair[0], pair[1])) == ESP_OK)
+		count++;
+	}; /* while rc == ESP_OK && ... */
+    }; /* else if mp_obj_is_type(items, &mp_type_dict) */
+    if (rc == ESP_OK && commit)
+	rc = strm.commit();
+    if (rc != ESP_OK)
+	raise(rc);
+    return mp_obj_new_int_from_uint(count);
+}; /* nvs_mp_update() */
+
+
+#ifndef ESP_PLATFORM
+///--[ Emulated partitions ]--------------------------------------------------------------------------------------------
+
+/// the partition is recreated empty; the device, registered already, is initialized on it again
+void nvs_mp_emul_partition(const char* label, size_t size)
+{
+	esp_err_t rc;
+
+    nvs::pool::flush();
+    rc = nvs_emul::partition(label, size);
+    if (rc == ESP_OK && nvs::dev::status(label) != ESP_ERR_NVS_INVALID_HANDLE)
+	rc = nvs::dev::partition(label).reInit();
+    if (rc != ESP_OK)
+	raise(rc);
+}; /* nvs_mp_emul_partition() */
+
+
+mp_obj_t nvs_mp_emul_stats(const char* label)
+{
+	nvs_emul::stats st = nvs_emul::get_stats(label);
+	mp_obj_t dict = mp_obj_new_dict(0);
+	auto put = [dict](const char* name, uint64_t val)
+	    {
+		mp_obj_dict_store(dict, mp_obj_new_str(name, strlen(name)), mp_obj_new_int_from_ull(val));
+	    };
+
+    put("lookups", st.lookups);
+    put("gets", st.gets);
+    put("entries_read", st.entries_read);
+    put("sets", st.sets);
+    put("sets_unchanged", st.sets_unchanged);
+    put("erases", st.erases);
+    put("commits", st.commits);
+    put("opens", st.opens);
+    put("payload_bytes", st.payload_bytes);
+    put("entries_written", st.entries_written);
+    put("entries_relocated", st.entries_relocated);
+    put("gc_runs", st.gc_runs);
+    put("page_erases", st.page_erases);
+    put("flash_time_ns", st.flash_time_ns);
+    return dict;
+}; /* nvs_mp_emul_stats() */
+
+
+void nvs_mp_emul_reset_stats(const char* label)
+{
+    nvs_emul::reset_stats(label);
+}; /* nvs_mp_emul_reset_stats() */
+#endif
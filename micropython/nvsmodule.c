@@ -0,0 +1,241 @@
+/* @file
+ * @brief MicroPython module 'nvs': the Stream type over the nvs::stream
+ *
+ *	import nvs
+ *	cfg = nvs.Stream("config", nvs.READWRITE)	# shadow=False, partition=None
+ *	cfg.set_u32("boots", cfg.get_u32("boots", 0) + 1)
+ *	cfg.set_blob("calib", buf)			# any object of the buffer protocol
+ *	n = cfg.readinto_blob("calib", buf)		# into the caller's buffer, the length
+ *	cfg.update({"ssid": "net", "channel": 6})	# all the items, then one commit
+ *
+ * Typed getters & setters: get_/set_ i8, u8, i16, u16, i32, u32, i64, u64, str,
+ * blob; the getter raises KeyError for the absent item, unless the default is
+ * given. The errors of the NVS are raised as OSError(code, name).
+ *
+ * @section LICENCE
+ *
+ * This code is in the Public Domain (or CC0 licensed, at your option.)
+ *
+ * Unless required by applicable law or agreed to in writing, this
+ * software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include "nvsmodule.h"
+
+
+NORETURN void nvs_mp_raise_closed(void)
+{
+    mp_raise_ValueError(MP_ERROR_TEXT("stream is closed"));
+} /* nvs_mp_raise_closed() */
+
+NORETURN void nvs_mp_raise_range(void)
+{
+    mp_raise_msg(&mp_type_OverflowError, MP_ERROR_TEXT("value out of range of the item type"));
+} /* nvs_mp_raise_range() */
+
+NORETURN void nvs_mp_raise_item_type(void)
+{
+    mp_raise_TypeError(MP_ERROR_TEXT("value must be int, str or buffer"));
+} /* nvs_mp_raise_item_type() */
+
+
+///--[ Type nvs.Stream ]------------------------------------------------------------------------------------------------
+
+static mp_obj_t nvs_stream_make_new(const mp_obj_type_t* type, size_t n_args, size_t n_kw, const mp_obj_t* all_args)
+{
+	enum { ARG_namespace, ARG_mode, ARG_shadow, ARG_partition };
+	static const mp_arg_t allowed_args[] = {
+	    { MP_QSTR_namespace, MP_ARG_REQUIRED | MP_ARG_OBJ, {.u_obj = MP_OBJ_NULL} },
+	    { MP_QSTR_mode, MP_ARG_INT, {.u_int = NVS_MP_READONLY} },
+	    { MP_QSTR_shadow, MP_ARG_KW_ONLY | MP_ARG_BOOL, {.u_bool = false} },
+	    { MP_QSTR_partition, MP_ARG_KW_ONLY | MP_ARG_OBJ, {.u_obj = mp_const_none} },
+	};
+	mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
+	nvs_mp_stream_obj_t* self;
+
+    mp_arg_parse_all_kw_array(n_args, n_kw, all_args, MP_ARRAY_SIZE(allowed_args), allowed_args, args);
+#ifdef mp_obj_malloc_with_finaliser
+    self = mp_obj_malloc_with_finaliser(nvs_mp_stream_obj_t, type);
+#else
+    self = m_new_obj_with_finaliser(nvs_mp_stream_obj_t);
+    self->base.type = type;
+#endif
+    self->strm = NULL;	// the finaliser of the failed open has nothing to close
+    self->strm = nvs_mp_open((args[ARG_partition].u_obj == mp_const_none)? NULL: mp_obj_str_get_str(args[ARG_partition].u_obj),
+	    mp_obj_str_get_str(args[ARG_namespace].u_obj), args[ARG_mode].u_int, args[ARG_shadow].u_bool);
+    return MP_OBJ_FROM_PTR(self);
+} /* nvs_stream_make_new() */
+
+
+/// get_<type>(key[, default]) & set_<type>(key, value) of the integer type
+#define NVS_MP_INT_METHODS(name, code)								\
+    static mp_obj_t nvs_stream_get_##name(size_t n_args, const mp_obj_t* args) {		\
+	return nvs_mp_get_int(args[0], args[1], (n_args > 2)? args[2]: MP_OBJ_NULL, code); }	\
+    static MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(nvs_stream_get_##name##_obj, 2, 3, nvs_stream_get_##name);	\
+    static mp_obj_t nvs_stream_set_##name(mp_obj_t self, mp_obj_t key, mp_obj_t value) {	\
+	nvs_mp_set_int(self, key, value, code);							\
+	return mp_const_none; }									\
+    static MP_DEFINE_CONST_FUN_OBJ_3(nvs_stream_set_##name##_obj, nvs_stream_set_##name);
+
+NVS_MP_INT_METHODS(i8,  NVS_MP_I8)
+NVS_MP_INT_METHODS(u8,  NVS_MP_U8)
+NVS_MP_INT_METHODS(i16, NVS_MP_I16)
+NVS_MP_INT_METHODS(u16, NVS_MP_U16)
+NVS_MP_INT_METHODS(i32, NVS_MP_I32)
+NVS_MP_INT_METHODS(u32, NVS_MP_U32)
+NVS_MP_INT_METHODS(i64, NVS_MP_I64)
+NVS_MP_INT_METHODS(u64, NVS_MP_U64)
+
+
+static mp_obj_t nvs_stream_get_str(size_t n_args, const mp_obj_t* args)
+{
+    return nvs_mp_get_str(args[0], args[1], (n_args > 2)? args[2]: MP_OBJ_NULL);
+} /* nvs_stream_get_str() */
+static MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(nvs_stream_get_str_obj, 2, 3, nvs_stream_get_str);
+
+static mp_obj_t nvs_stream_set_str(mp_obj_t self, mp_obj_t key, mp_obj_t value)
+{
+    nvs_mp_set_str(self, key, value);
+    return mp_const_none;
+} /* nvs_stream_set_str() */
+static MP_DEFINE_CONST_FUN_OBJ_3(nvs_stream_set_str_obj, nvs_stream_set_str);
+
+/// the new bytes object of the blob
+static mp_obj_t nvs_stream_get_blob(size_t n_args, const mp_obj_t* args)
+{
+    return nvs_mp_get_blob(args[0], args[1], (n_args > 2)? args[2]: MP_OBJ_NULL);
+} /* nvs_stream_get_blob() */
+static MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(nvs_stream_get_blob_obj, 2, 3, nvs_stream_get_blob);
+
+/// the blob into the caller's buffer; the length of the blob
+static mp_obj_t nvs_stream_readinto_blob(mp_obj_t self, mp_obj_t key, mp_obj_t buf)
+{
+    return nvs_mp_readinto_blob(self, key, buf);
+} /* nvs_stream_readinto_blob() */
+static MP_DEFINE_CONST_FUN_OBJ_3(nvs_stream_readinto_blob_obj, nvs_stream_readinto_blob);
+
+static mp_obj_t nvs_stream_set_blob(mp_obj_t self, mp_obj_t key, mp_obj_t buf)
+{
+    nvs_mp_set_blob(self, key, buf);
+    return mp_const_none;
+} /* nvs_stream_set_blob() */
+static MP_DEFINE_CONST_FUN_OBJ_3(nvs_stream_set_blob_obj, nvs_stream_set_blob);
+
+
+static mp_obj_t nvs_stream_commit(mp_obj_t self)
+{
+    nvs_mp_commit(self);
+    return mp_const_none;
+} /* nvs_stream_commit() */
+static MP_DEFINE_CONST_FUN_OBJ_1(nvs_stream_commit_obj, nvs_stream_commit);
+
+/// update(items, commit=True): the items of the dict or the (key, value) pairs, then one commit;
+/// the int is stored as i32 (i64, if it does not fit), the str - as the string, the buffer - as the blob
+static mp_obj_t nvs_stream_update(size_t n_args, const mp_obj_t* args)
+{
+    return nvs_mp_update(args[0], args[1], (n_args > 2)? mp_obj_is_true(args[2]): true);
+} /* nvs_stream_update() */
+static MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(nvs_stream_update_obj, 2, 3, nvs_stream_update);
+
+static mp_obj_t nvs_stream_close(mp_obj_t self)
+{
+    nvs_mp_close(MP_OBJ_TO_PTR(self));
+    return mp_const_none;
+} /* nvs_stream_close() */
+static MP_DEFINE_CONST_FUN_OBJ_1(nvs_stream_close_obj, nvs_stream_close);
+
+static mp_obj_t nvs_stream_exit(size_t n_args, const mp_obj_t* args)
+{
+    nvs_mp_close(MP_OBJ_TO_PTR(args[0]));
+    return mp_const_none;
+} /* nvs_stream_exit() */
+static MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(nvs_stream_exit_obj, 4, 4, nvs_stream_exit);
+
+
+static const mp_rom_map_elem_t nvs_stream_locals_dict_table[] = {
+    { MP_ROM_QSTR(MP_QSTR_get_i8), MP_ROM_PTR(&nvs_stream_get_i8_obj) },
+    { MP_ROM_QSTR(MP_QSTR_set_i8), MP_ROM_PTR(&nvs_stream_set_i8_obj) },
+    { MP_ROM_QSTR(MP_QSTR_get_u8), MP_ROM_PTR(&nvs_stream_get_u8_obj) },
+    { MP_ROM_QSTR(MP_QSTR_set_u8), MP_ROM_PTR(&nvs_stream_set_u8_obj) },
+    { MP_ROM_QSTR(MP_QSTR_get_i16), MP_ROM_PTR(&nvs_stream_get_i16_obj) },
+    { MP_ROM_QSTR(MP_QSTR_set_i16), MP_ROM_PTR(&nvs_stream_set_i16_obj) },
+    { MP_ROM_QSTR(MP_QSTR_get_u16), MP_ROM_PTR(&nvs_stream_get_u16_obj) },
+    { MP_ROM_QSTR(MP_QSTR_set_u16), MP_ROM_PTR(&nvs_stream_set_u16_obj) },
+    { MP_ROM_QSTR(MP_QSTR_get_i32), MP_ROM_PTR(&nvs_stream_get_i32_obj) },
+    { MP_ROM_QSTR(MP_QSTR_set_i32), MP_ROM_PTR(&nvs_stream_set_i32_obj) },
+    { MP_ROM_QSTR(MP_QSTR_get_u32), MP_ROM_PTR(&nvs_stream_get_u32_obj) },
+    { MP_ROM_QSTR(MP_QSTR_set_u32), MP_ROM_PTR(&nvs_stream_set_u32_obj) },
+    { MP_ROM_QSTR(MP_QSTR_get_i64), MP_ROM_PTR(&nvs_stream_get_i64_obj) },
+    { MP_ROM_QSTR(MP_QSTR_set_i64), MP_ROM_PTR(&nvs_stream_set_i64_obj) },
+    { MP_ROM_QSTR(MP_QSTR_get_u64), MP_ROM_PTR(&nvs_stream_get_u64_obj) },
+    { MP_ROM_QSTR(MP_QSTR_set_u64), MP_ROM_PTR(&nvs_stream_set_u64_obj) },
+    { MP_ROM_QSTR(MP_QSTR_get_str), MP_ROM_PTR(&nvs_stream_get_str_obj) },
+    { MP_ROM_QSTR(MP_QSTR_set_str), MP_ROM_PTR(&nvs_stream_set_str_obj) },
+    { MP_ROM_QSTR(MP_QSTR_get_blob), MP_ROM_PTR(&nvs_stream_get_blob_obj) },
+    { MP_ROM_QSTR(MP_QSTR_readinto_blob), MP_ROM_PTR(&nvs_stream_readinto_blob_obj) },
+    { MP_ROM_QSTR(MP_QSTR_set_blob), MP_ROM_PTR(&nvs_stream_set_blob_obj) },
+    { MP_ROM_QSTR(MP_QSTR_commit), MP_ROM_PTR(&nvs_stream_commit_obj) },
+    { MP_ROM_QSTR(MP_QSTR_update), MP_ROM_PTR(&nvs_stream_update_obj) },
+    { MP_ROM_QSTR(MP_QSTR_close), MP_ROM_PTR(&nvs_stream_close_obj) },
+    { MP_ROM_QSTR(MP_QSTR___del__), MP_ROM_PTR(&nvs_stream_close_obj) },
+    { MP_ROM_QSTR(MP_QSTR___enter__), MP_ROM_PTR(&mp_identity_obj) },
+    { MP_ROM_QSTR(MP_QSTR___exit__), MP_ROM_PTR(&nvs_stream_exit_obj) },
+};
+static MP_DEFINE_CONST_DICT(nvs_stream_locals_dict, nvs_stream_locals_dict_table);
+
+MP_DEFINE_CONST_OBJ_TYPE(
+    nvs_mp_stream_type,
+    MP_QSTR_Stream,
+    MP_TYPE_FLAG_NONE,
+    make_new, nvs_stream_make_new,
+    locals_dict, &nvs_stream_locals_dict
+    );
+
+
+///--[ Module nvs ]-----------------------------------------------------------------------------------------------------
+
+#ifndef ESP_PLATFORM
+/// emul_partition(size, label="nvs"): create the emulated partition empty, before its streams are opened
+static mp_obj_t nvs_emul_partition(size_t n_args, const mp_obj_t* args)
+{
+    nvs_mp_emul_partition((n_args > 1)? mp_obj_str_get_str(args[1]): "nvs", mp_obj_get_int(args[0]));
+    return mp_const_none;
+} /* nvs_emul_partition() */
+static MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(nvs_emul_partition_obj, 1, 2, nvs_emul_partition);
+
+/// stats(label="nvs"): the counters of the emulated partition, the dict
+static mp_obj_t nvs_emul_stats(size_t n_args, const mp_obj_t* args)
+{
+    return nvs_mp_emul_stats((n_args > 0)? mp_obj_str_get_str(args[0]): "nvs");
+} /* nvs_emul_stats() */
+static MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(nvs_emul_stats_obj, 0, 1, nvs_emul_stats);
+
+static mp_obj_t nvs_emul_reset_stats(size_t n_args, const mp_obj_t* args)
+{
+    nvs_mp_emul_reset_stats((n_args > 0)? mp_obj_str_get_str(args[0]): "nvs");
+    return mp_const_none;
+} /* nvs_emul_reset_stats() */
+static MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(nvs_emul_reset_stats_obj, 0, 1, nvs_emul_reset_stats);
+#endif
+
+
+static const mp_rom_map_elem_t nvs_module_globals_table[] = {
+    { MP_ROM_QSTR(MP_QSTR___name__), MP_ROM_QSTR(MP_QSTR_nvs) },
+    { MP_ROM_QSTR(MP_QSTR_Stream), MP_ROM_PTR(&nvs_mp_stream_type) },
+    { MP_ROM_QSTR(MP_QSTR_READONLY), MP_ROM_INT(NVS_MP_READONLY) },
+    { MP_ROM_QSTR(MP_QSTR_READWRITE), MP_ROM_INT(NVS_MP_READWRITE) },
+#ifndef ESP_PLATFORM
+    { MP_ROM_QSTR(MP_QSTR_emul_partition), MP_ROM_PTR(&nvs_emul_partition_obj) },
+    { MP_ROM_QSTR(MP_QSTR_stats), MP_ROM_PTR(&nvs_emul_stats_obj) },
+    { MP_ROM_QSTR(MP_QSTR_reset_stats), MP_ROM_PTR(&nvs_emul_reset_stats_obj) },
+#endif
+};
+static MP_DEFINE_CONST_DICT(nvs_module_globals, nvs_module_globals_table);
+
+const mp_obj_module_t nvs_mp_user_cmodule = {
+    .base = { &mp_type_module },
+    .globals = (mp_obj_dict_t*)&nvs_module_globals,
+};
+
+MP_REGISTER_MODULE(MP_QSTR_nvs, nvs_mp_user_cmodule);
@@ -0,0 +1,71 @@
+/* @file
+ * @brief MicroPython module 'nvs': C interface of the nvs::stream binding
+ *
+ * The module tables & the argument parsing are in nvsmodule.c (C, the QSTRs),
+ * the calls of the nvs::stream are in nvs_mp.cpp (C++). The blobs are passed by
+ * the buffer protocol: written from & read into the caller's buffer, no copy.
+ *
+ * @section LICENCE
+ *
+ * This code is in the Public Domain (or CC0 licensed, at your option.)
+ *
+ * Unless required by applicable law or agreed to in writing, this
+ * software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#ifndef __NVS_MPMODULE_H__
+#define __NVS_MPMODULE_H__
+
+#include "py/runtime.h"
+#include "py/obj.h"
+
+/// Open modes of the Stream
+#define NVS_MP_READONLY		0
+#define NVS_MP_READWRITE	1
+
+/// Integer item types, the values of the nvs_type_t
+#define NVS_MP_U8	0x01
+#define NVS_MP_I8	0x11
+#define NVS_MP_U16	0x02
+#define NVS_MP_I16	0x12
+#define NVS_MP_U32	0x04
+#define NVS_MP_I32	0x14
+#define NVS_MP_U64	0x08
+#define NVS_MP_I64	0x18
+
+/// The Stream object: the nvs::stream is on the C++ heap, deleted by the close() or by the finaliser
+typedef struct _nvs_mp_stream_obj_t
+{
+    mp_obj_base_t base;
+    void* strm;		///< nvs::stream, NULL when closed
+} nvs_mp_stream_obj_t;
+
+extern const mp_obj_type_t nvs_mp_stream_type;
+
+// nvsmodule.c: the errors with the messages
+NORETURN void nvs_mp_raise_closed(void);
+NORETURN void nvs_mp_raise_range(void);
+NORETURN void nvs_mp_raise_item_type(void);
+
+// nvs_mp.cpp: OSError(code, name) on the errors, KeyError for the absent item without the default
+void* nvs_mp_open(const char* part, const char* space, int mode, bool shadow);
+void nvs_mp_close(nvs_mp_stream_obj_t* self);
+mp_obj_t nvs_mp_get_int(mp_obj_t self, mp_obj_t key, mp_obj_t dflt, int type);
+void nvs_mp_set_int(mp_obj_t self, mp_obj_t key, mp_obj_t value, int type);
+mp_obj_t nvs_mp_get_str(mp_obj_t self, mp_obj_t key, mp_obj_t dflt);
+void nvs_mp_set_str(mp_obj_t self, mp_obj_t key, mp_obj_t value);
+mp_obj_t nvs_mp_get_blob(mp_obj_t self, mp_obj_t key, mp_obj_t dflt);
+mp_obj_t nvs_mp_readinto_blob(mp_obj_t self, mp_obj_t key, mp_obj_t buf);
+void nvs_mp_set_blob(mp_obj_t self, mp_obj_t key, mp_obj_t buf);
+void nvs_mp_commit(mp_obj_t self);
+mp_obj_t nvs_mp_update(mp_obj_t self, mp_obj_t items, bool commit);
+
+#ifndef ESP_PLATFORM
+// the emulated partitions of the host build
+void nvs_mp_emul_partition(const char* label, size_t size);
+mp_obj_t nvs_mp_emul_stats(const char* label);
+void nvs_mp_emul_reset_stats(const char* label);
+#endif
+
+#endif // __NVS_MPMODULE_H__
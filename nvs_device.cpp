@@ -10,16 +10,32 @@
  * CONDITIONS OF ANY KIND, either express or implied.
 */
 
+#include <algorithm>
 #include <type_traits>
+#include <chrono>
+#include <condition_variable>
 #include <cstring>
 #include <inttypes.h>
 #include <string>
+#include <map>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
 #include <nvs_flash.h>
 #include <nvs.h>
 #include <nvs_handle.hpp>
 #include <esp_system.h>
 #include <esp_log.h>
-
+#ifdef ESP_PLATFORM
+#include <esp_pthread.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "nvs_trace"
 #include "nvs_device"
 #include "nvstream"
 
@@ -27,6 +43,137 @@
 namespace nvs
 {
 
+    ///--[ Class nvs::latency ]---------------------------------------------------------------------------------------
+
+    uint32_t latency::histogram::upper(size_t idx)
+    {
+	if (idx == 0)
+	    return 63;
+
+	    unsigned msb = 6 + (idx - 1) / 2;
+	    uint64_t lower = (uint64_t(1) << msb) + ((idx - 1) & 1) * (uint64_t(1) << (msb - 1));
+
+	return uint32_t(std::min<uint64_t>(lower + (uint64_t(1) << (msb - 1)) - 1, UINT32_MAX));
+    }; /* latency::histogram::upper() */
+
+    uint32_t latency::histogram::percentile(unsigned p) const
+    {
+	    uint64_t total = 0, seen = 0;
+
+	for (uint32_t n: bucket)
+	    total += n;	// the counters are updated one by one: the buckets, not the count, are the total
+	if (total == 0)
+	    return 0;
+
+	    uint64_t rank = std::max<uint64_t>(1, (total * std::min(p, 100u) + 99) / 100);
+
+	for (size_t i = 0; i < buckets; i++)
+	    if ((seen += bucket[i]) >= rank)
+		return std::min(upper(i), max_ns);
+	return max_ns;
+    }; /* latency::histogram::percentile() */
+
+
+#if NVS_LATENCY
+    /// bucket of the latency 'ns': 0 - below 64 ns, then two buckets per octave
+    static size_t bucket_of(uint32_t ns)
+    {
+	if (ns < 64)
+	    return 0;
+
+	    unsigned msb = 31 - __builtin_clz(ns);
+
+	return 1 + (msb - 6) * 2 + ((ns >> (msb - 1)) & 1);
+    }; /* bucket_of() */
+
+    /// Histogram of the operation, updated by the concurrent tasks
+    struct timings
+    {
+	std::atomic<uint32_t> count;
+	std::atomic<uint32_t> max_ns;
+	std::atomic<uint32_t> bucket[latency::buckets];
+    }; /* struct timings */
+
+    static timings histograms[latency::ops];	///< static storage: zeroed, no allocation
+
+    /// Time of the operation: from the construction till the end of the scope
+    class latency_timer
+    {
+    public:
+	latency_timer(latency::op type): type(type), start(std::chrono::steady_clock::now()) {};
+	~latency_timer() {
+	    latency::record(type, std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count()); };
+
+    private:
+	latency::op type;
+	std::chrono::steady_clock::time_point start;
+    }; /* class latency_timer */
+
+# define NVS_TIME_OP(type) latency_timer nvs_op_timer(latency::type)
+#else
+# define NVS_TIME_OP(type) do {} while (0)
+#endif
+
+
+    void latency::record(op type, uint64_t ns)
+    {
+#if NVS_LATENCY
+	    timings& h = histograms[type];
+	    uint32_t val = uint32_t(std::min<uint64_t>(ns, UINT32_MAX));
+	    uint32_t seen = h.max_ns.load(std::memory_order_relaxed);
+
+	h.bucket[bucket_of(val)].fetch_add(1, std::memory_order_relaxed);
+	h.count.fetch_add(1, std::memory_order_relaxed);
+	while (val > seen && !h.max_ns.compare_exchange_weak(seen, val, std::memory_order_relaxed))
+	    ;
+#else
+	(void)type;
+	(void)ns;
+#endif
+    }; /* latency::record() */
+
+    latency::histogram latency::get(op type)
+    {
+	    histogram out;
+
+#if NVS_LATENCY
+	if (type < ops)
+	{
+		timings& h = histograms[type];
+
+	    out.count = h.count.load(std::memory_order_relaxed);
+	    out.max_ns = h.max_ns.load(std::memory_order_relaxed);
+	    for (size_t i = 0; i < buckets; i++)
+		out.bucket[i] = h.bucket[i].load(std::memory_order_relaxed);
+	}; /* if type < ops */
+#else
+	(void)type;
+#endif
+	return out;
+    }; /* latency::get() */
+
+    void latency::reset()
+    {
+#if NVS_LATENCY
+	for (timings& h: histograms)
+	{
+	    h.count.store(0, std::memory_order_relaxed);
+	    h.max_ns.store(0, std::memory_order_relaxed);
+	    for (auto& b: h.bucket)
+		b.store(0, std::memory_order_relaxed);
+	}; /* for timings& h: histograms */
+#endif
+    }; /* latency::reset() */
+
+    const char* latency::name(op type)
+    {
+	    static const char* const names[ops] = {"read", "write", "read_blob", "write_blob", "commit", "open", "init", "wait"};
+
+	return (type < ops)? names[type]: "unknown";
+    }; /* latency::name() */
+
+
+
     //--[ Class device ]-----------------------------------------------------------------------------------------------
 
     // Static class for using as singleton
@@ -35,48 +182,120 @@ namespace nvs
     // Initialize default partition
     esp_err_t dev::Init()
     {
-	ESP_LOGW(__func__, "Initialize the NVS device...");
+	    NVS_TIME_OP(init);
+
+	NVS_LOGW(__func__, "Initialize the NVS device...");
 	return nvs_flash_init();
     }; /* dev::Init */
 
     // Initialize partition with label 'partlabel'
     esp_err_t dev::Init(const std::string& partlabel)
     {
-	ESP_LOGW(__func__, "Initialize the NVS device with label \"%s\"", partlabel.c_str());
+	    NVS_TIME_OP(init);
+
+	NVS_LOGW(__func__, "Initialize the NVS device with label \"%s\"", partlabel.c_str());
 	return nvs_flash_init_partition(partlabel.c_str());
     }; /* dev::Init */
 
 
-    dev::dev()
+    namespace
     {
-	// Initialize NVS
-	ESP_LOGW(__func__, "Creating object of the NVS Device");
-	err = dev::Init();
-	ESP_ERROR_CHECK_WITHOUT_ABORT(err);
-    } /* device::device */
 
-    dev::dev(const std::string& partlabel)
+	/// Tasks of the deferred initialization: joined at the exit, after the end of main();
+	/// the devices, used by them, are never destroyed (see labels())
+	struct init_tasks
+	{
+	    std::mutex lock;
+	    std::vector<std::thread> threads;
+
+	    ~init_tasks()
+	    {
+		for (std::thread& task: threads)
+		    if (task.joinable())
+			task.join();
+	    }; /* ~init_tasks() */
+	}; /* struct init_tasks */
+
+    }; /* namespace */
+
+
+    // the deferred device is got at once, its partition is initialized by the background task
+    dev::dev(const std::string& partlabel, bool deferred):
+	plabel(partlabel), done(settle.get_future().share())
     {
-	ESP_LOGW(__func__, "Creating object of the NVS Device with label: \"%s\"", partlabel.c_str());
-	err = dev::Init(partlabel.c_str());
-	ESP_ERROR_CHECK_WITHOUT_ABORT(err);
+	NVS_LOGW(__func__, "Creating object of the NVS Device with label: \"%s\"%s", partlabel.c_str(), deferred? ", deferred": "");
+	if (!deferred)
+	{
+	    settle.set_value(initialize());
+	    return;
+	}; /* if !deferred */
+	err = ESP_ERR_NOT_FINISHED;
+#ifdef ESP_PLATFORM
+	    esp_pthread_cfg_t old;
+	    bool restore = esp_pthread_get_cfg(&old) == ESP_OK;
+	    esp_pthread_cfg_t cfg = esp_pthread_get_default_config();
+
+	cfg.stack_size = 4096;
+	cfg.thread_name = "nvs_init";
+	esp_pthread_set_cfg(&cfg);
+#endif
+	{
+		static init_tasks tasks;
+		std::lock_guard<std::mutex> guard(tasks.lock);
+
+	    tasks.threads.emplace_back([this]() { settle.set_value(initialize()); });
+	}
+#ifdef ESP_PLATFORM
+	if (restore)
+	    esp_pthread_set_cfg(&old);
+#endif
     }; /* device::device */
 
 
+    // initialize the partition of the device, the status is set & traced
+    esp_err_t dev::initialize()
+    {
+	    esp_err_t rc = (plabel == NVS_DEFAULT_PART_NAME)? dev::Init(): dev::Init(plabel);
+
+	ESP_ERROR_CHECK_WITHOUT_ABORT(rc);
+	NVS_TRACE_OP("init", "-", "partition", plabel.c_str(), rc);
+	return (err = rc);
+    }; /* device::initialize */
+
+
     // Reinitialize partition manually
     esp_err_t dev::reInit()
     {
-	ESP_LOGW(__func__, "Re-initialize the NVS device");
-	err = dev::Init();
+	NVS_LOGW(__func__, "Re-initialize the NVS device");
+	wait();		// not concurrently with the deferred initialization
+	err = (plabel == NVS_DEFAULT_PART_NAME)? dev::Init(): dev::Init(plabel);
 	ESP_ERROR_CHECK_WITHOUT_ABORT(err);
 	return err;
     }; /* device::reInit */
 
 
+    // wait for the end of the initialization; the time of the blocked task is traced
+    esp_err_t dev::wait()
+    {
+	if (done.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+	    return status();
+	{
+		NVS_TIME_OP(wait);
+		auto start = std::chrono::steady_clock::now();
+		esp_err_t rc = done.get();
+		[[maybe_unused]] auto us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+
+	    NVS_LOGW(__func__, "The task was blocked by the initialization of \"%s\" for %lld us", plabel.c_str(), (long long)us);
+	    NVS_TRACE_OP("wait", plabel.c_str(), "us", std::to_string(us).c_str(), rc);
+	}
+	return status();
+    }; /* device::wait */
+
+
     // get a device instance
     dev& dev::core()
     {
-	    static dev instance;
+	    static dev& instance = dev::partition(std::string(NVS_DEFAULT_PART_NAME));
 
 	return instance;
     }; /* device::core */
@@ -86,8 +305,10 @@ namespace nvs
     /// one pass reinit if first initialization
     dev& dev::partition()
     {
-	ESP_LOGW(__func__, "Get the partition of the NVS device (singleton exemplar of object); test only");
-	if (dev::state() == ESP_ERR_NVS_NO_FREE_PAGES || dev::state() == ESP_ERR_NVS_NEW_VERSION_FOUND)
+	    esp_err_t rc = core().wait();
+
+	NVS_LOGW(__func__, "Get the partition of the NVS device (singleton exemplar of object); test only");
+	if (rc == ESP_ERR_NVS_NO_FREE_PAGES || rc == ESP_ERR_NVS_NEW_VERSION_FOUND)
 	    core().reInit();
 	return dev::core();
     };
@@ -115,9 +336,113 @@ namespace nvs
     // check the nvs partition status
     bool dev::check()
     {
-	return dev::core().isOK();
+	return dev::core().wait() == ESP_OK;
     }; /* device::check */
 
+    // check the status of the partition 'label'
+    bool dev::check(const std::string& label)
+    {
+	return dev::partition(label).wait() == ESP_OK;
+    }; /* device::check */
+
+
+    //--[ Partition registry ]----------------------------------------------------------------------------------------
+
+    namespace
+    {
+
+	/// Registry entry of the partition, the default one included
+	struct labelled
+	{
+	    std::once_flag once;	///< initialization of the device: only once
+	    std::atomic<dev*> device{nullptr};	///< the device, never destroyed
+	    bool deferred = false;	///< initialized by the background task, set by dev::start()
+	}; /* struct labelled */
+
+	/// The registered partitions; the map is locked only to find/insert the entry,
+	/// the partition is initialized outside the lock, so the other ones do not wait
+	struct partitions
+	{
+	    std::mutex lock;
+	    std::map<std::string, labelled> devices;
+	}; /* struct partitions */
+
+	partitions& labels()
+	{
+		static partitions* reg = new partitions;	// still used by the late destructors of the streams
+
+	    return *reg;
+	}; /* labels() */
+
+    }; /* namespace */
+
+
+    // get the device of the partition 'label': registered & initialized on the first call
+    dev& dev::partition(const std::string& label)
+    {
+	    partitions& reg = labels();
+	    labelled* entry;
+	    bool deferred;
+
+	{
+		std::lock_guard<std::mutex> guard(reg.lock);
+
+	    entry = &reg.devices[label];	// std::map: the entry stays in place
+	    deferred = entry->deferred;
+	}
+	std::call_once(entry->once, [entry, &label, deferred]() { entry->device = new dev(label, deferred); });
+	return *entry->device;
+    }; /* device::partition */
+
+
+    // status of the partition 'label' without the wait
+    esp_err_t dev::status(const std::string& label)
+    {
+	    partitions& reg = labels();
+	    std::lock_guard<std::mutex> guard(reg.lock);
+	    auto it = reg.devices.find(label);
+	    dev* device = (it == reg.devices.end())? nullptr: it->second.device.load();
+
+	return device? device->status(): ESP_ERR_NVS_INVALID_HANDLE;
+    }; /* device::status */
+
+
+    // start the initialization of the partitions in the background, one task per partition
+    void dev::start(const std::vector<std::string>& labels)
+    {
+	    partitions& reg = ::nvs::labels();
+
+	for (const std::string& label: labels)
+	{
+	    {
+		    std::lock_guard<std::mutex> guard(reg.lock);
+
+		reg.devices[label].deferred = true;	// no effect, if the device is already made
+	    }
+	    dev::partition(label);
+	}; /* for const std::string& label: labels */
+    }; /* device::start */
+
+
+    // readiness of the partition 'label'
+    std::shared_future<esp_err_t> dev::ready(const std::string& label)
+    {
+	return dev::partition(label).done;
+    }; /* device::ready */
+
+
+    // initialize the partitions concurrently, one task per partition; the first error
+    esp_err_t dev::init(const std::vector<std::string>& labels)
+    {
+	    esp_err_t rc = ESP_OK;
+
+	dev::start(labels);
+	for (const std::string& label: labels)
+	    if (esp_err_t st = dev::partition(label).wait(); rc == ESP_OK)
+		rc = st;
+	return rc;
+    }; /* device::init */
+
 
 
 
@@ -144,517 +469,1392 @@ namespace nvs
 	}; /* switch mode */
     }; /* openmode2nvs() */
 
-    ///--[ Class nvs::stream ]-----------------------------------------------------------------------------------------
 
-    /// Manipulation with the NVS device namespaces
+/// Implemented using types:
+///    integer types: uint8_t, int8_t, uint16_t, int16_t, uint32_t, int32_t, uint64_t, int64_t
+///    zero-terminated string
+///    variable length binary data (blob)
+/// The C++ types are mapped to them at compile time, see the nvs::stored_type() in the 'nvstream'
 
+    /// name of the NVS type, for the trace
+    static const char* type_name(nvs_type_t type)
+    {
+	switch (type)
+	{
+	case NVS_TYPE_I8:  return "int8_t";
+	case NVS_TYPE_U8:  return "uint8_t";
+	case NVS_TYPE_I16: return "int16_t";
+	case NVS_TYPE_U16: return "uint16_t";
+	case NVS_TYPE_I32: return "int32_t";
+	case NVS_TYPE_U32: return "uint32_t";
+	case NVS_TYPE_I64: return "int64_t";
+	case NVS_TYPE_U64: return "uint64_t";
+	case NVS_TYPE_STR: return "string";
+	case NVS_TYPE_BLOB: return "blob";
+	default:
+	    return "any";
+	}; /* switch type */
+    }; /* type_name() */
 
-    /// Specialization of the stream::get_size() for the std::string type
-    template <>
-    size_t stream::get_size<std::string>(const std::string& name);
 
-    /// Specialization of the stream::get_size() for the char[] type
-    template <>
-    size_t stream::get_size<char[]>(const std::string& name);
+    /// @brief output values of any types value into C-string in a correct/compatible way, primarilly int-types.
+    /// The string is kept in the helper object itself, on the stack of the caller:
+    /// no allocation and no shared buffer, safe for the concurrent callers.
+    class printf_helper
+    {
+    public:
+	printf_helper(uint32_t item): printf_helper(NVS_TYPE_U32, &item) {};
+	/// the integer of the NVS type, by its bytes; zero padded to the width of the type
+	printf_helper(nvs_type_t type, const void* item)
+	{
+		static constexpr int digits[] = {0, 3, 5, 0, 10, 0, 0, 0, 20};	///< of the max value, by the width
+		size_t width = std::min<size_t>(type & 0x0F, sizeof(uint64_t));
+		bool sign = type & 0x10;
+		uint64_t val = 0;
+
+	    memcpy(&val, item, width);
+	    if (sign && width < sizeof(val) && (val >> (width * 8 - 1)) & 1)
+		val |= ~uint64_t(0) << (width * 8);	// sign extension
+	    if (sign)
+		snprintf(buff, sizeof(buff), "%0*" PRIi64, digits[width] + 1, int64_t(val));
+	    else
+		snprintf(buff, sizeof(buff), "%0*" PRIu64, digits[width], val);
+	};
+	const char* c_str() const { return buff; };
+
+    private:
+	char buff[22];	///< buffer for string output of sended any int: the sign & 20 digits
+    }; /* class printf_helper */
+
+
+    ///--[ Class nvs::pool ]------------------------------------------------------------------------------------------
+
+    /// Open handle of the pool
+    struct pooled
+    {
+	std::string part;
+	std::string space;
+	open_mode mode;
+	uint32_t handle;
+	unsigned refs;		///< streams using the handle
+	uint64_t used;		///< tick of the last release, for the LRU closing of the idle handles
+    }; /* struct pooled */
+
+    /// State of the pool; never destroyed, as the handles must not be closed after the NVS is gone at exit
+    struct registry
+    {
+	std::mutex lock;
+	std::vector<pooled> handles;	///< a few namespaces: the linear search is the fastest
+	pool::stats st;
+	size_t idle_max = pool::default_idle;
+	uint64_t tick = 0;
+    }; /* struct registry */
+
+    static registry& handles()
+    {
+	    static registry* reg = new registry;
 
-    /// Specialization of the stream::get_size() for the 'void' type (implied the 'blob' item)
-    template <>
-    size_t stream::get_size<void>(const std::string& name);
+	return *reg;
+    }; /* handles() */
 
-    /// Specialization of the stream::get_size() for the 'void*' type (implied the 'blob' item)
-    template <>
-    size_t stream::get_size<void*>(const std::string& name);
+    /// close the least recently used idle handles over the 'keep' limit; registry is locked
+    static void trim(registry& reg, size_t keep)
+    {
+	while (reg.st.idle > keep)
+	{
+		auto lru = reg.handles.end();
+
+	    for (auto it = reg.handles.begin(); it != reg.handles.end(); it++)
+		if (it->refs == 0 && (lru == reg.handles.end() || it->used < lru->used))
+		    lru = it;
+	    nvs_close(handler(lru->handle));
+	    NVS_TRACE_OP("close", lru->space.c_str(), "pool", "idle", ESP_OK);
+	    reg.handles.erase(lru);
+	    reg.st.idle--;
+	    reg.st.closes++;
+	}; /* while reg.st.idle > keep */
+    }; /* trim() */
+
+
+    /// take the open handle of the namespace, if any; registry is locked
+    static bool reuse(registry& reg, const std::string& part, const std::string& space, open_mode mode, uint32_t& handle)
+    {
+	for (auto& p: reg.handles)
+	    if (p.mode == mode && p.space == space && p.part == part)
+	    {
+		if (p.refs++ == 0)
+		{
+		    reg.st.idle--;
+		    reg.st.active++;
+		}; /* if p.refs++ == 0 */
+		reg.st.reuses++;
+		handle = p.handle;
+		return true;
+	    }; /* if p.mode == mode && ... */
+	return false;
+    }; /* reuse() */
+
+
+    esp_err_t pool::acquire(const std::string& part, const std::string& space, open_mode mode, uint32_t& handle, bool& fresh)
+    {
+	    registry& reg = handles();
+	    std::unique_lock<std::mutex> guard(reg.lock);
+	    nvs_handle_t h;
+	    esp_err_t rc;
+
+	fresh = false;
+	if (reuse(reg, part, space, mode, handle))
+	    return ESP_OK;
+	guard.unlock();
+
+	// the partition is initialized (or its deferred initialization is waited for) unlocked:
+	// the opens of the other partitions go on, only the handle table is locked
+	    dev& device = dev::partition(part);
+
+	device.wait();
+	guard.lock();
+	if (reuse(reg, part, space, mode, handle))
+	    return ESP_OK;
+	fresh = true;
+	if (!device.isOK())
+	    return ESP_ERR_NVS_INVALID_STATE;
+	rc = nvs_open_from_partition(part.c_str(), space.c_str(), openmode2nvs(mode), &h);
+	if (rc != ESP_OK)
+	    return rc;
+	reg.handles.push_back(pooled{part, space, mode, storhandler(h), 1, 0});
+	reg.st.opens++;
+	reg.st.active++;
+	handle = storhandler(h);
+	return ESP_OK;
+    }; /* pool::acquire() */
+
+
+    void pool::release(uint32_t handle)
+    {
+	    registry& reg = handles();
+	    std::lock_guard<std::mutex> guard(reg.lock);
+
+	for (auto& p: reg.handles)
+	    if (p.handle == handle)
+	    {
+		if (p.refs == 0 || --p.refs > 0)
+		    return;
+		p.used = ++reg.tick;
+		reg.st.active--;
+		reg.st.idle++;
+		trim(reg, reg.idle_max);
+		return;
+	    }; /* if p.handle == handle */
+    }; /* pool::release() */
+
+
+    void pool::flush()
+    {
+	    registry& reg = handles();
+	    std::lock_guard<std::mutex> guard(reg.lock);
 
+	trim(reg, 0);
+    }; /* pool::flush() */
 
 
-    stream::stream(): err(ESP_ERR_NVS_INVALID_STATE) {};
+    void pool::idle_limit(size_t count)
+    {
+	    registry& reg = handles();
+	    std::lock_guard<std::mutex> guard(reg.lock);
 
+	reg.idle_max = count;
+	trim(reg, count);
+    }; /* pool::idle_limit() */
 
-    stream::stream(const std::string& spacename, open_mode mode)
-    {
-	ESP_LOGI(__func__, "Create nvs::stream object with namespace name \"%s\"", spacename.c_str());
-	open(spacename, mode);
-    }; /* stream::stream */
 
-    stream::~stream()
+    pool::stats pool::get_stats()
     {
-	close();
-    }; /* stream::~stream() */
+	    registry& reg = handles();
+	    std::lock_guard<std::mutex> guard(reg.lock);
 
-    esp_err_t stream::open(const std::string& name, open_mode mode)
-    {
-	ESP_LOGI(__func__, "Open the nvs namespace with name \"%s\"", name.c_str());
-	//dev::partition();
-	if (dev::check())
-	{
-	    err = nvs_open(name.c_str(), openmode2nvs(mode), &handler(store));
-	    ESP_LOGI(__func__, "Initializing NVS namespase is OK");
-	}
-	else
-	{
-	    err = ESP_ERR_NVS_INVALID_STATE;
-	    ESP_LOGE(__func__, "Error initializing NVS namespase %s !!!", name.c_str());
-	}; /* else if dev::check() */
-	return err;
-    }; /* stream::open */
+	return reg.st;
+    }; /* pool::get_stats() */
 
 
-    esp_err_t stream::close()
+    void pool::reset_stats()
     {
-	nvs_close(handler(store));
-	store = 0;
-	err = ESP_OK;
-	return err;
-    }; /* stream::close() */
+	    registry& reg = handles();
+	    std::lock_guard<std::mutex> guard(reg.lock);
 
-    esp_err_t  stream::read_blob(const std::string& name, void* item, size_t& length)
-    {
-	err = (dev::core().isOK())? nvs_get_blob(handler(store), name.c_str(), item, &length): ESP_ERR_NVS_INVALID_STATE;
-	return err;
-    }; /* stream::read_blob() */
+	reg.st.opens = reg.st.reuses = reg.st.closes = 0;
+    }; /* pool::reset_stats() */
 
-    esp_err_t stream::write_blob(const std::string& name, const void* item, size_t length)
-    {
-	err = (dev::core().isOK())? nvs_set_blob(handler(store), name.c_str(), item, length): ESP_ERR_NVS_INVALID_STATE;
-	return err;
-    }; /* stream::set_blob */
 
-    esp_err_t stream::commit()
-    {
-	err = (dev::check())? nvs_commit(handler(store)): ESP_ERR_NVS_INVALID_STATE;
-	if (err == ESP_OK)
-	    clr_chngst();
-	return err;
-    }; /* stream::commit */
 
-    /// set the changing state of the nvs::stream
-    inline void stream::set_chgst()
+    /// FNV-1a hash of the key string
+    static uint32_t fnv1a(const char str[])
     {
-	chg_st = true;
-    }; /* stream::set_chgst() */
-
+	    uint32_t hash = 2166136261u;
 
+	for (const char* c = str; *c; c++)
+	    hash = (hash ^ uint8_t(*c)) * 16777619u;
+	return hash;
+    }; /* fnv1a() */
 
-/// Implemented using types:
-///    integer types: uint8_t, int8_t, uint16_t, int16_t, uint32_t, int32_t, uint64_t, int64_t
-///    zero-terminated string
-///    variable length binary data (blob)
 
-    template <typename T>
-    struct type
-    {
-	static const char name[];
-	static const char fmt[];
-	static const size_t prnw;
-    }; /* type */
-
-    template <> const char type<int8_t  >::name[] = "int8_t";
-    template <> const char type<uint8_t >::name[] = "uint8_t";
-    template <> const char type<int16_t >::name[] = "int16_t";
-    template <> const char type<uint16_t>::name[] = "uint16_t";
-    template <> const char type<int32_t >::name[] = "int32_t";
-    template <> const char type<uint32_t>::name[] = "uint32_t";
-    template <> const char type<int64_t >::name[] = "int64_t";
-    template <> const char type<uint64_t>::name[] = "uint64_t";
-
-    template <> const char type<char*>::name[] = "char*";
-    template <> const char type<std::string>::name[] = "std::string";
-    template <> const char type<void> ::name[] = "void";
-    template <> const char type<void*>::name[] = "void*";
-
-    template <> const char type<int8_t>  ::fmt[] = "%0*" PRIi8;
-    template <> const char type<uint8_t> ::fmt[] = "%0*" PRIu8;
-    template <> const char type<int16_t> ::fmt[] = "%0*" PRIi16;
-    template <> const char type<uint16_t>::fmt[] = "%0*" PRIu16;
-    template <> const char type<int32_t> ::fmt[] = "%0*" PRIi32;
-    template <> const char type<uint32_t>::fmt[] = "%0*" PRIu32;
-    template <> const char type<int64_t> ::fmt[] = "%0*" PRIi64;
-    template <> const char type<uint64_t>::fmt[] = "%0*" PRIu64;
-
-    template <> const size_t type<uint8_t >::prnw  = 3;
-    template <> const size_t type<int8_t  >::prnw  = type<uint8_t>::prnw + 1;
-    template <> const size_t type<uint16_t>::prnw  = 5;
-    template <> const size_t type<int16_t >::prnw  = type<uint16_t>::prnw + 1;
-    template <> const size_t type<uint32_t>::prnw  = 10;
-    template <> const size_t type<int32_t >::prnw  = type<uint32_t>::prnw + 1;
-    template <> const size_t type<uint64_t>::prnw  = 20;
-    template <> const size_t type<int64_t >::prnw  = type<uint64_t>::prnw + 1;
+    ///--[ Locks of the nvs::stream ]----------------------------------------------------------------------------------
 
+    /// Keys are spread over the shards by the hash: operations on the keys of the
+    /// different shards run in parallel, on the keys of the same shard - one by one.
+    static constexpr size_t shards = 8;
 
+    /// shard of the key, FNV-1a hash
+    static size_t shard_of(const key& name)
+    {
+	return fnv1a(name.c_str()) % shards;
+    }; /* shard_of() */
 
-    /// @brief output values of any types value into C-string in a correct/compatible way, primarilly int-types.
-    template <typename T>
-    std::string printf_helper(T item);
-    ///@brief buffer for string output of sended any int
-    static char prnoutbuff[type<int64_t>::prnw + 1];
 
-    template <typename T>
-    std::string printf_helper(T item)
+    /// Locks of the stream, opened in the 'multi_task' mode
+    class stream::locks
     {
-	sprintf(prnoutbuff, type<T>::fmt, type<T>::prnw, item);
-	return prnoutbuff;
-    }; /* printf_helper() */
-
+    public:
+	std::shared_mutex whole;	///< shared by the key operations, exclusive for open/close & transactions
+	std::mutex shard[shards];	///< key operations of the shard, including the read-compare-write
+	std::atomic<std::thread::id> owner;	///< task of the exclusive 'whole': its key operations take no lock
+    }; /* class nvs::stream::locks */
 
 
-    /// @brief implementation of the read/write operation
-    template <typename ItemT>
-    class stream::core
+    /// Guard of the operation on the single key; nothing for the 'single_task' stream
+    /// & for the task, which holds the whole stream already; the key only in the sweep of the task
+    class stream::key_lock
     {
     public:
-	/// @brief read core template procedure
-	template <esp_err_t (*read_action)(nvs_handle_t, const char*, ItemT*)>
-	static inline esp_err_t read(stream* nvstor, const std::string& name, ItemT &out);
+	key_lock(const stream& strm, const key& name): sync(strm.sync), idx(shard_of(name))
+	{
+	    if (sync && sync->owner.load() == std::this_thread::get_id())
+		sync = nullptr;
+	    if (!sync)
+		return;
+	    shared = sweeping != sync;	// the shared mutex is not locked twice by the task
+	    if (shared)
+		sync->whole.lock_shared();
+	    sync->shard[idx].lock();
+	}; /* key_lock::key_lock() */
+
+	~key_lock()
+	{
+	    if (!sync)
+		return;
+	    sync->shard[idx].unlock();
+	    if (shared)
+		sync->whole.unlock_shared();
+	}; /* key_lock::~key_lock() */
+
+	key_lock(const key_lock&) = delete;
+	key_lock& operator=(const key_lock&) = delete;
 
-	/// @brief write core template procedure
-	template <esp_err_t (*write_action)(nvs_handle_t, const char*, ItemT)>
-	static inline esp_err_t write(stream* nvstor, const std::string& name, ItemT item);
-    }; /* template class nvs::stream::core */
+	static inline thread_local const locks* sweeping = nullptr;	///< stream of the sweep of the task
 
+    private:
+	locks* sync;
+	size_t idx;
+	bool shared = false;
+    }; /* class nvs::stream::key_lock */
 
-    // Read the int32_t item from the NVS namespace
-    /// @brief read core template procedure
-    template <typename ItemT>
-    template <esp_err_t (*read_action)(nvs_handle_t, const char*, ItemT*)>
-    inline esp_err_t nvs::stream::core<ItemT>::read(stream* nvstream, const std::string& name, ItemT &out)
+
+    /// Guard of the sweep over the whole stream: no operation on the whole stream (open/close, transaction
+    /// commit) meanwhile, the key operations of the other tasks go on; nothing for the 'single_task' stream
+    class stream::sweep_lock
     {
-	ESP_LOGW(__func__, "Read the %s item '%s', old value is: %s"/*"%'i"*/, type<ItemT>::name, name.c_str(), printf_helper(out).c_str());
-	nvstream->err = read_action(handler(nvstream->store), name.c_str(), &out);
-	ESP_LOGI(__func__, "                 New value of the %s is: %s"/*"%i"*/, name.c_str(), printf_helper(out).c_str());
-	return nvstream->err;
-    }; /* nvs::stream::core<ItemT>::write<read_action>() */
+    public:
+	sweep_lock(const stream& strm): sync(strm.sync)
+	{
+	    if (sync && (sync->owner.load() == std::this_thread::get_id() || key_lock::sweeping == sync))
+		sync = nullptr;
+	    if (!sync)
+		return;
+	    sync->whole.lock_shared();
+	    key_lock::sweeping = sync;
+	}; /* sweep_lock::sweep_lock() */
+
+	~sweep_lock()
+	{
+	    if (!sync)
+		return;
+	    key_lock::sweeping = nullptr;
+	    sync->whole.unlock_shared();
+	}; /* sweep_lock::~sweep_lock() */
 
+	sweep_lock(const sweep_lock&) = delete;
+	sweep_lock& operator=(const sweep_lock&) = delete;
 
+    private:
+	locks* sync;
+    }; /* class nvs::stream::sweep_lock */
 
 
-    /// @brief write core template procedure
-    template <typename ItemT>
-    template <esp_err_t (*write_action)(nvs_handle_t, const char*, ItemT item)>
-    inline esp_err_t nvs::stream::core<ItemT>::write(stream* nvstream, const std::string& name, ItemT item)
+    /// Guard of the operation on the whole stream; nothing for the 'single_task' stream
+    /// & for the task, which holds it already
+    class stream::whole_lock
     {
-	    ItemT tmpval = 0;
-
-// TODO --> temporarily changed from it: read(name, tmpval);
-	nvstream->read(name, tmpval);
-	ESP_LOGW(__PRETTY_FUNCTION__, "New item value \"%s\" value is: %s,\n\t\treaded item %s\n\t\terr state is: %i", name.c_str(), printf_helper(item).c_str(), printf_helper(tmpval).c_str(), nvstream->err);
-	if ((nvstream->err == ESP_OK || nvstream->err == ESP_ERR_NVS_NOT_FOUND) && tmpval != item)
+    public:
+	whole_lock(const stream& strm): sync(strm.sync) {
+	    if (sync && sync->owner.load() == std::this_thread::get_id())
+		sync = nullptr;
+	    if (sync) {
+		sync->whole.lock();
+		sync->owner = std::this_thread::get_id(); }; };
+	~whole_lock() {
+	    if (sync) {
+		sync->owner = std::thread::id();
+		sync->whole.unlock(); }; };
+
+	whole_lock(const whole_lock&) = delete;
+	whole_lock& operator=(const whole_lock&) = delete;
+
+    private:
+	locks* sync;
+    }; /* class nvs::stream::whole_lock */
+
+
+
+    ///--[ Compressed items ]-----------------------------------------------------------------------------------------
+
+    /// The compressed blob or string is the blob of the header & the LZF-style stream: the control
+    /// byte 0..31 is the literal run of 1..32 bytes, which follow it; other control byte is the back
+    /// reference, 3 bits of the length & 13 bits of the distance (up to 8 KiB back) in the next byte,
+    /// the length 7 is extended by one more byte. The encoder keeps the fixed table of the last
+    /// positions of the 3-bytes hashes (2 KiB), the decoder needs nothing but the output.
+    /// The header is trusted only in the namespace marked by the reserved item "~pack": it is written
+    /// before the first compressed item, after the check, that no plain blob of the namespace starts by
+    /// the header. In the marked namespace the plain blob starting by the magic is escaped by the header
+    /// without the 'pack_lzf' flag; the blobs of the unmarked namespace are all plain.
+    static constexpr uint8_t pack_magic[3] = {0xA7, 'N', 'Z'};
+    static constexpr size_t pack_header = 8;		///< magic, flags, the decoded size (LE)
+    static constexpr uint8_t pack_lzf = 0x01;		///< payload is compressed, otherwise it is the plain one
+    static constexpr uint8_t pack_string = 0x02;	///< the item is the string, without the terminating zero
+    static constexpr size_t pack_str_max = 4000;	///< the longest string of the NVS, the longer ones are not packed
+    static constexpr unsigned pack_hash_bits = 10;
+    static constexpr size_t pack_window = 8192;
+    static constexpr size_t pack_match_max = 264;	///< 7 + 255 extended + 2 implied
+    static constexpr char pack_mark[] = "~pack";	///< mark of the namespace with the compressed items
+    static constexpr uint8_t pack_format = 1;		///< value of the mark: the format of the header
+
+
+    /// compress 'size' bytes of 'data' into the 'out', after the header with the 'flags';
+    /// false, if the result is not shorter than the 'data'
+    static bool pack(const uint8_t data[], size_t size, uint8_t flags, std::vector<uint8_t>& out)
+    {
+	    std::vector<uint16_t> last(size_t(1) << pack_hash_bits);	// low 16 bits of the positions
+	    size_t pos = 0;
+	    size_t lit = 0;	// start of the pending literal run
+	    auto hash = [data](size_t at) {
+		return ((uint32_t(data[at]) << 16 | uint32_t(data[at + 1]) << 8 | data[at + 2]) * 2654435761u) >> (32 - pack_hash_bits); };
+	    auto literals = [&](size_t end) {
+		while (lit < end)
+		{
+			size_t run = std::min<size_t>(32, end - lit);
+
+		    out.push_back(uint8_t(run - 1));
+		    out.insert(out.end(), data + lit, data + lit + run);
+		    lit += run;
+		}; /* while lit < end */
+	    };
+
+	out.assign(pack_magic, pack_magic + sizeof(pack_magic));
+	out.push_back(flags | pack_lzf);
+	for (int i = 0; i < 4; i++)
+	    out.push_back(uint8_t(size >> (8 * i)));
+	while (pos + 2 < size && out.size() < size)
 	{
-	    ESP_LOGW(__func__, "Saving the new value of the Item %s", name.c_str());
-	    nvstream->err = write_action(handler(nvstream->store), name.c_str(), item);
+		uint32_t h = hash(pos);
+		size_t dist = uint16_t(pos - last[h]);	// the wrong distance of the far position is caught by the compare
+
+	    last[h] = uint16_t(pos);
+	    if (dist == 0 || dist > pack_window || dist > pos || memcmp(data + pos - dist, data + pos, 3) != 0)
+	    {
+		pos++;
+		continue;
+	    }; /* if dist == 0 || ... */
+
+		size_t len = 3;
+		size_t max = std::min(pack_match_max, size - pos);
+
+	    while (len < max && data[pos - dist + len] == data[pos + len])
+		len++;
+	    literals(pos);
+	    if (len - 2 < 7)
+		out.push_back(uint8_t((len - 2) << 5 | (dist - 1) >> 8));
+	    else
+	    {
+		out.push_back(uint8_t(7 << 5 | (dist - 1) >> 8));
+		out.push_back(uint8_t(len - 2 - 7));
+	    }; /* else if len - 2 < 7 */
+	    out.push_back(uint8_t(dist - 1));
+	    for (size_t end = std::min(pos + len, size - 2), i = pos + 1; i < end; i++)
+		last[hash(i)] = uint16_t(i);
+	    pos = lit = pos + len;
+	}; /* while pos + 2 < size && out.size() < size */
+	if (out.size() >= size)
+	    return false;
+	literals(size);
+	return out.size() < size;
+    }; /* pack() */
+
+
+    /// header of the packed item: the 'flags' & the decoded 'length'; false - the plain blob
+    static bool packed(const void* data, size_t size, uint8_t& flags, size_t& length)
+    {
+	    const uint8_t* p = static_cast<const uint8_t*>(data);
 
-	    if (nvstream->err == ESP_OK)
-		nvstream->set_chgst();
-	}; /* 	if err == ESP_OK && tmpval != item */
-	ESP_LOGW(__PRETTY_FUNCTION__, "Change state is: %s", nvstream->chg_st? "Yes": "No");
-	return nvstream->err;
-    }; /* nvs::stream::core<ItemT>::write<write_action>() */
+	if (size < pack_header || memcmp(p, pack_magic, sizeof(pack_magic)) != 0 || (p[3] & ~(pack_lzf | pack_string)) != 0)
+	    return false;
+	flags = p[3];
+	length = uint32_t(p[4]) | uint32_t(p[5]) << 8 | uint32_t(p[6]) << 16 | uint32_t(p[7]) << 24;
+	return (flags & pack_lzf) || length == size - pack_header;
+    }; /* packed() */
 
 
+    /// the namespace of the handle is marked: its blobs, starting by the header, are the packed ones
+    static bool has_pack_mark(nvs_handle_t handle)
+    {
+	    uint8_t format = 0;
 
+	return nvs_get_u8(handle, pack_mark, &format) == ESP_OK && format == pack_format;
+    }; /* has_pack_mark() */
 
-    // Read the int8_t item from the NVS namespace
-    template <>
-    esp_err_t stream::read<int8_t>(const std::string& name, int8_t& item)
-    {
-	//err = nvs_get_i8(handle, name.c_str(), item);
-	err = stream::core<int8_t>::read<nvs_get_i8>(this, name.c_str(), item);
-	return err;
-    }; /* stream::read<int8_t>() */
-    template esp_err_t stream::read(const std::string&, int8_t&);
 
+    /// decode the packed item 'data' of 'size' bytes into the 'length' bytes of the 'out'
+    static esp_err_t unpack(const void* data, size_t size, void* out, size_t length)
+    {
+	    const uint8_t* in = static_cast<const uint8_t*>(data) + pack_header;
+	    const uint8_t* end = static_cast<const uint8_t*>(data) + size;
+	    uint8_t* dst = static_cast<uint8_t*>(out);
+	    size_t pos = 0;
 
-    // Read the 'char' from the NVS namespace
-    template <>
-    esp_err_t stream::read<char>(const std::string& name, char& item)
+	if (!(static_cast<const uint8_t*>(data)[3] & pack_lzf))
+	{
+	    memcpy(out, in, length);
+	    return ESP_OK;
+	}; /* if !(flags & pack_lzf) */
+	while (in < end)
+	{
+		size_t ctrl = *in++;
+		size_t len = ctrl >> 5;
+
+	    if (len == 0)
+	    {
+		if (size_t(end - in) <= ctrl || length - pos <= ctrl)
+		    return ESP_ERR_INVALID_SIZE;
+		memcpy(dst + pos, in, ctrl + 1);
+		in += ctrl + 1;
+		pos += ctrl + 1;
+		continue;
+	    }; /* if len == 0 */
+	    if (len == 7 && in < end)
+		len += *in++;
+	    if (in == end)
+		return ESP_ERR_INVALID_SIZE;
+
+		size_t dist = ((ctrl & 0x1F) << 8 | *in++) + 1;
+
+	    len += 2;
+	    if (dist > pos || length - pos < len)
+		return ESP_ERR_INVALID_SIZE;
+	    if (dist >= len)
+		memcpy(dst + pos, dst + pos - dist, len);
+	    else
+		for (size_t i = 0; i < len; i++)
+		    dst[pos + i] = dst[pos + i - dist];	// overlapped copy is the repeat of the run
+	    pos += len;
+	}; /* while in < end */
+	return (pos == length)? ESP_OK: ESP_ERR_INVALID_SIZE;
+    }; /* unpack() */
+
+
+    /// stored form of the blob or the string in the namespace, 'marked' or not: compressed, if 'compress'
+    /// and it is shorter so, or the plain blob escaped by the header; false - the 'data' are stored as is
+    static bool encode(const void* data, size_t size, uint8_t flags, bool compress, bool marked, std::vector<uint8_t>& out)
     {
-	ESP_LOGW(__func__, "Read the char item '%s', old value is: %c", name.c_str(), item);
-	read<int8_t>(name, reinterpret_cast<int8_t&>(item));
-	ESP_LOGI(__func__, "               New value of the %s is: %c", name.c_str(), item);
-	return err;
-    }; /* stream::read<char>() */
-    template esp_err_t stream::read<char>(const std::string&, char&);
+	    const uint8_t* p = static_cast<const uint8_t*>(data);
+	    uint8_t dummy;
+	    size_t len;
+
+	if (!marked)
+	    return false;
+	if (compress && size >= stream::compress_min && (!(flags & pack_string) || size < pack_str_max)
+		&& pack(p, size, flags, out))
+	    return true;
+	if ((flags & pack_string) || !packed(data, size, dummy, len))
+	    return false;
+	out.assign(pack_magic, pack_magic + sizeof(pack_magic));
+	out.push_back(flags);
+	for (int i = 0; i < 4; i++)
+	    out.push_back(uint8_t(size >> (8 * i)));
+	out.insert(out.end(), p, p + size);
+	return true;
+    }; /* encode() */
+
+
+    /// read the whole blob into the vector
+    static esp_err_t get_blob(nvs_handle_t handle, const char kname[], std::vector<uint8_t>& out)
+    {
+	    size_t size = 0;
+	    esp_err_t err = nvs_get_blob(handle, kname, nullptr, &size);
 
-    ///XXX operation 'read<char>()' was duplicated & redefined the 'read<int8_t>()', therefore is not needed
-    ///XXX operation 'read<signed char>()' was duplicated & redefined the 'read<int8_t>()', therefore is not needed
+	if (err != ESP_OK)
+	    return err;
+	out.resize(size);
+	return nvs_get_blob(handle, kname, out.data(), &size);
+    }; /* get_blob() */
 
 
-    // Read the 'bool' from the NVS namespace
-    template <>
-    esp_err_t stream::read<bool>(const std::string& name, bool& item)
+    /// read the compressed string, stored as the blob; ESP_ERR_NVS_TYPE_MISMATCH - other blob
+    static esp_err_t get_packed_str(nvs_handle_t handle, const char kname[], std::string& out)
     {
-	    char c = item? '1': '0';
+	    std::vector<uint8_t> stored;
+	    size_t size = 0;
+	    size_t length;
+	    uint8_t flags;
+	    esp_err_t err = nvs_get_blob(handle, kname, nullptr, &size);
 
-	ESP_LOGW(__func__, "Read the bool item '%s', old value is: [%s]", name.c_str(), item? "True": "False");
-	read<char>(name, c);
-	item = !(c == '0');
-	ESP_LOGI(__func__, "               New value of the %s is: [%s]", name.c_str(), item? "True": "False");
-	return err;
-    }; /* stream::read<char>() */
-    template esp_err_t stream::read(const std::string&, bool&);
+	if (err != ESP_OK)
+	    return err;
+	// the packed string is shorter than the longest string of the NVS, the longer blob is not even read
+	if (size < pack_header || size > pack_str_max)
+	    return ESP_ERR_NVS_TYPE_MISMATCH;
+	if ((err = get_blob(handle, kname, stored)) != ESP_OK)
+	    return err;
+	if (!packed(stored.data(), stored.size(), flags, length) || !(flags & pack_string) || !has_pack_mark(handle))
+	    return ESP_ERR_NVS_TYPE_MISMATCH;
+	out.resize(length);
+	return unpack(stored.data(), stored.size(), out.data(), length);
+    }; /* get_packed_str() */
 
 
-    // Read the int16_t item from the NVS namespace
-    template <>
-    esp_err_t stream::read<int16_t>(const std::string& name, int16_t& item)
+    /// the stored blob is the same as the 'data'
+    static bool same_blob(nvs_handle_t handle, const char kname[], const std::vector<uint8_t>& data)
     {
-	//err = nvs_get_i16(handle, name.c_str(), item);
-	err = stream::core<int16_t>::read<nvs_get_i16>(this, name.c_str(), item);
-	return err;
-    }; /* stream::read<int16_t>() */
-    template esp_err_t stream::read(const std::string&, int16_t&);
+	    std::vector<uint8_t> stored;
+	    size_t size = 0;
 
+	return nvs_get_blob(handle, kname, nullptr, &size) == ESP_OK && size == data.size()
+		&& get_blob(handle, kname, stored) == ESP_OK && stored == data;
+    }; /* same_blob() */
 
-    // Read the int32_t item from the NVS namespace
-    template <>
-    esp_err_t stream::read<int32_t>(const std::string& name, int32_t& item)
+
+    /// the string 'text' into the caller's buffer, with the same semantic of the 'length' as for the nvs_get_str()
+    static esp_err_t copy_str(const std::string& text, char* item, size_t& length)
     {
-	//err = nvs_get_i32(handle, name.c_str(), item);
-	err = stream::core<int32_t>::read<nvs_get_i32>(this, name.c_str(), item);
-	return err;
-    }; /* stream::read<int32_t>() */
-    template esp_err_t stream::read<int32_t>(const std::string&, int32_t&);
+	    esp_err_t rc = (item && length < text.size() + 1)? ESP_ERR_NVS_INVALID_LENGTH: ESP_OK;
 
+	if (item && rc == ESP_OK)
+	    memcpy(item, text.c_str(), text.size() + 1);
+	length = text.size() + 1;
+	return rc;
+    }; /* copy_str() */
 
-    // Read the int64_t item from the NVS namespace
-    template <>
-    esp_err_t stream::read<int64_t>(const std::string& name, int64_t& item)
-    {
-	//err = nvs_get_i64(handler(store), name.c_str(), item);
-	err = stream::core<int64_t>::read<nvs_get_i64>(this, name.c_str(), item);
-	return err;
-    }; /* stream::read<int64_t>() */
-    template esp_err_t stream::read(const std::string&, int64_t&);
 
 
+    ///--[ Class nvs::stream::image ]----------------------------------------------------------------------------------
 
-    // Read the std::string item from the NVS namespace
-    template <>
-    esp_err_t stream::read<std::string>(const std::string& name, std::string &item)
+    /// RAM shadow of the opened namespace: integer and string items,
+    /// stored as the raw bytes of the value with the type of the item.
+    /// Blobs are not shadowed, the stream writes them to the flash directly;
+    /// the compressed strings are shadowed decoded, as the strings.
+    /// Items are kept by the key shards: the shard is accessed under its key lock.
+    class stream::image
     {
-	ESP_LOGW(__func__, "Read the char[] item '%s', old value is: \"%s\"", name.c_str(), item.c_str());
-	    size_t bufsz = get_size<std::string>(name);
-	    char *buf = nullptr;
+    public:
+	/// @brief fill the image by all the items of the namespace 'spacename'
+	esp_err_t load(nvs_handle_t handle, const char spacename[]);
+
+	/// @brief stored value of the item 'name' with type 'type', nullptr if not present
+	const std::string* find(const key& name, nvs_type_t type) const;
+	/// @brief check, if the item 'name' with the type 'type' has the value 'data'
+	bool same(const key& name, nvs_type_t type, const void* data, size_t size) const;
+	/// @brief set the new value of the item after the successful write to the flash
+	void update(const key& name, nvs_type_t type, const void* data, size_t size);
+	/// @brief remove the item from the image (item is not shadowed now)
+	void forget(const key& name);
+
+    private:
+	struct item
+	{
+	    nvs_type_t type;
+	    std::string data;
+	}; /* struct item */
 
-	/// Select maximum between size of the stored item and a length of 'item'
-	if (err == ESP_OK)
-	    bufsz = ((item.length() + 1) > bufsz)? (item.length() + 1): bufsz;
-	else
-	    return err;
+	std::map<key, item> items[shards];
+    }; /* class nvs::stream::image */
 
-	buf = new char[bufsz];
-    	strcpy(buf, item.c_str());
-    	err = nvs_get_str(handler(store), name.c_str(), buf, &bufsz);
-    	item = buf;
-    	delete[] buf;
-	ESP_LOGI(__func__, "                 New value of the %s is: \"%s\", new buffer size is: %d", name.c_str(), item.c_str(), bufsz);
-    	return err;
-    }; /* stream::read<std::string>() */
-    template esp_err_t stream::read(const std::string&, std::string&);
 
+    /// read the value of any type into the caller's storage 'out' of the 'size' bytes;
+    /// 'size' is set to the length of the value read
+    static esp_err_t get_into(nvs_handle_t handle, const char kname[], nvs_type_t type, void* out, size_t& size)
+    {
+	    size_t width = ((type & 0xE0) == 0)? (type & 0x0F): 0;	// integer width, by the type code
+
+	if (width && size < width)
+	    return ESP_ERR_NVS_INVALID_LENGTH;
+	if (width)
+	    size = width;
+	switch (type)
+	{
+	case NVS_TYPE_I8:  return nvs_get_i8 (handle, kname, static_cast<int8_t*>  (out));
+	case NVS_TYPE_U8:  return nvs_get_u8 (handle, kname, static_cast<uint8_t*> (out));
+	case NVS_TYPE_I16: return nvs_get_i16(handle, kname, static_cast<int16_t*> (out));
+	case NVS_TYPE_U16: return nvs_get_u16(handle, kname, static_cast<uint16_t*>(out));
+	case NVS_TYPE_I32: return nvs_get_i32(handle, kname, static_cast<int32_t*> (out));
+	case NVS_TYPE_U32: return nvs_get_u32(handle, kname, static_cast<uint32_t*>(out));
+	case NVS_TYPE_I64: return nvs_get_i64(handle, kname, static_cast<int64_t*> (out));
+	case NVS_TYPE_U64: return nvs_get_u64(handle, kname, static_cast<uint64_t*>(out));
+	case NVS_TYPE_STR: return nvs_get_str(handle, kname, static_cast<char*>(out), &size);
+	case NVS_TYPE_BLOB: return nvs_get_blob(handle, kname, out, &size);
+	default:
+	    return ESP_ERR_NVS_TYPE_MISMATCH;
+	}; /* switch type */
+    }; /* get_into() */
 
 
-    // Read the uint8_t item from the NVS namespace
-    template <>
-    esp_err_t stream::read<uint8_t>(const std::string& name, uint8_t& item)
+    /// read the value of any integer or string type into the raw bytes
+    static esp_err_t get_raw(nvs_handle_t handle, const char kname[], nvs_type_t type, std::string& out)
     {
-	//err = nvs_get_u8(handle, name.c_str(), item);
-	err = stream::core<uint8_t>::read<nvs_get_u8>(this, name.c_str(), item);
-	return err;
-    }; /* stream::read<uint8_t>() */
-    template esp_err_t stream::read(const std::string&, uint8_t&);
+	    uint64_t val = 0;
+	    size_t size = sizeof(val);
+	    esp_err_t err;
 
-    ///XXX operation 'read<unsigned char>()' was duplicated & redefined the 'read<uint8_t>()', therefore is not needed
+	switch (type)
+	{
+	case NVS_TYPE_STR:
+	    if ((err = nvs_get_str(handle, kname, nullptr, &size)) != ESP_OK)
+		return err;
+	    out.resize(size);
+	    if ((err = nvs_get_str(handle, kname, out.data(), &size)) == ESP_OK)
+		out.resize(size - 1);	// without the terminating zero
+	    return err;
+	case NVS_TYPE_BLOB:
+	    return ESP_ERR_NVS_TYPE_MISMATCH;
+	default:
+	    if ((err = get_into(handle, kname, type, &val, size)) == ESP_OK)
+		out.assign(reinterpret_cast<const char*>(&val), size);
+	    return err;
+	}; /* switch type */
+    }; /* get_raw() */
 
 
-    // Read the uint16_t item from the NVS namespace
-    template <>
-    esp_err_t stream::read<uint16_t>(const std::string& name, uint16_t& item)
+    /// the integer T from its bytes: copied, not type-punned
+    template <typename T>
+    static T int_of(const void* data)
     {
-	//err = nvs_get_u16(handle, name.c_str(), item);
-	err = stream::core<uint16_t>::read<nvs_get_u16>(this, name.c_str(), item);
-	return err;
-    }; /* stream::read<uint16_t>() */
-    template esp_err_t stream::read(const std::string& name, uint16_t& item);
+	    T val;
 
+	memcpy(&val, data, sizeof(val));
+	return val;
+    }; /* int_of() */
 
-    // Read the uint32_t item from the NVS namespace
-    template <>
-    esp_err_t stream::read<uint32_t>(const std::string& name, uint32_t& item)
+    /// write the integer of the NVS type 'type' from its bytes
+    static esp_err_t set_int(nvs_handle_t handle, const char kname[], nvs_type_t type, const void* data)
     {
-	//err = nvs_get_i32(handle, name.c_str(), item);
-	err = stream::core<uint32_t>::read<nvs_get_u32>(this, name.c_str(), item);
-	return err;
-    }; /* stream::read<uint32_t>() */
-    template esp_err_t stream::read(const std::string&, uint32_t&);
+	switch (type)
+	{
+	case NVS_TYPE_I8:  return nvs_set_i8 (handle, kname, int_of<int8_t>  (data));
+	case NVS_TYPE_U8:  return nvs_set_u8 (handle, kname, int_of<uint8_t> (data));
+	case NVS_TYPE_I16: return nvs_set_i16(handle, kname, int_of<int16_t> (data));
+	case NVS_TYPE_U16: return nvs_set_u16(handle, kname, int_of<uint16_t>(data));
+	case NVS_TYPE_I32: return nvs_set_i32(handle, kname, int_of<int32_t> (data));
+	case NVS_TYPE_U32: return nvs_set_u32(handle, kname, int_of<uint32_t>(data));
+	case NVS_TYPE_I64: return nvs_set_i64(handle, kname, int_of<int64_t> (data));
+	case NVS_TYPE_U64: return nvs_set_u64(handle, kname, int_of<uint64_t>(data));
+	default:
+	    return ESP_ERR_NVS_TYPE_MISMATCH;
+	}; /* switch type */
+    }; /* set_int() */
 
 
-    // Read the uint64_t item from the NVS namespace
-    template <>
-    esp_err_t stream::read<uint64_t>(const std::string& name, uint64_t& item)
+    /// write the value of any type from the raw bytes; strings are stored without the terminating zero
+    static esp_err_t set_raw(nvs_handle_t handle, const char kname[], nvs_type_t type, const std::string& data)
     {
-	//return nvs_get_i64(handle, name.c_str(), item);
-	err = stream::core<uint64_t>::read<nvs_get_u64>(this, name.c_str(), item);
-	return err;
-    }; /* stream::read<uint64_t>() */
-    template esp_err_t stream::read<uint64_t>(const std::string&, uint64_t&);
-
+	    uint64_t val = 0;
 
+	switch (type)
+	{
+	case NVS_TYPE_STR: return nvs_set_str(handle, kname, data.c_str());
+	case NVS_TYPE_BLOB: return nvs_set_blob(handle, kname, data.data(), data.size());
+	default:
+	    memcpy(&val, data.data(), std::min(data.size(), sizeof(val)));	// the short data are zero extended
+	    return set_int(handle, kname, type, &val);
+	}; /* switch type */
+    }; /* set_raw() */
 
 
-    ///@brief Write the int8_t item to the NVS namespace
-    template <>
-    esp_err_t stream::write<int8_t>(const std::string& name, int8_t item)
+    /// CRC-32 (IEEE 802.3, the same as the esp_rom_crc32_le() with the initial ~0), by the nibbles:
+    /// the table of 16 words is constant - in the flash, not in RAM
+    static uint32_t crc32(uint32_t crc, const void* data, size_t size)
     {
-	// err = nvs_set_i8(handle, name.c_str(), item);
-	return (err = stream::core<int8_t>::write<nvs_set_i8>(this, name.c_str(), item));
-	//return err;
-    }; /* stream::write<int8_t>() */
-    template esp_err_t stream::write(const std::string&, int8_t);
+	    static const uint32_t nibble[16] = {
+		0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+		0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C};
+	    const uint8_t* p = static_cast<const uint8_t*>(data);
 
-    ///XXX operation write<char>() and a write<bool>() was defined in the 'nvstream' file as inline
-    ///XXX operation 'write<signed char>()' was duplicated & redefined the 'write<uint8_t>()', therefore is not needed
+	crc = ~crc;
+	while (size--)
+	{
+	    crc ^= *p++;
+	    crc = (crc >> 4) ^ nibble[crc & 0x0F];
+	    crc = (crc >> 4) ^ nibble[crc & 0x0F];
+	}; /* while size-- */
+	return ~crc;
+    }; /* crc32() */
 
-    ///@brief Write the int16_t item to the NVS namespace
-    template <>
-    esp_err_t stream::write<int16_t>(const std::string& name, int16_t item)
+
+    esp_err_t stream::image::load(nvs_handle_t handle, const char spacename[])
     {
-	//err = nvs_set_i16(handle, name.c_str(), item);
-	err = stream::core<int16_t>::write<nvs_set_i16>(this, name.c_str(), item);
-	return err;
-    }; /* stream::write<int16_t>() */
-    template esp_err_t stream::write(const std::string&, int16_t);
+	    nvs_iterator_t it = nullptr;
+	    esp_err_t err = nvs_entry_find_in_handle(handle, NVS_TYPE_ANY, &it);
+	    size_t count = 0;
 
-    ///@brief Write the int32_t item to the NVS namespace
-    template <>
-    esp_err_t stream::write<int32_t>(const std::string& name, int32_t item)
+	for (auto& shard: items)
+	    shard.clear();
+	while (err == ESP_OK)
+	{
+		nvs_entry_info_t info;
+		std::string data;
+
+	    nvs_entry_info(it, &info);
+	    if (info.type != NVS_TYPE_BLOB)
+	    {
+		if ((err = get_raw(handle, info.key, info.type, data)) != ESP_OK)
+		{
+		    nvs_release_iterator(it);
+		    return err;
+		}; /* if (err = get_raw(...)) != ESP_OK */
+		items[shard_of(info.key)][info.key] = item{info.type, std::move(data)};
+		count++;
+	    }
+	    else if (get_packed_str(handle, info.key, data) == ESP_OK)
+	    {
+		items[shard_of(info.key)][info.key] = item{NVS_TYPE_STR, std::move(data)};	// the compressed string
+		count++;
+	    }; /* else if info.type != NVS_TYPE_BLOB */
+	    err = nvs_entry_next(&it);
+	}; /* while err == ESP_OK */
+	NVS_LOGI(__func__, "Shadow image of the namespace \"%s\" is loaded, %zu items", spacename, count);
+	// end of iteration is reported as 'not found'
+	return (err == ESP_ERR_NVS_NOT_FOUND)? ESP_OK: err;
+    }; /* stream::image::load() */
+
+
+    const std::string* stream::image::find(const key& name, nvs_type_t type) const
     {
-	//err = nvs_set_i32(handle, name.c_str(), item);
-	err = nvs::stream::core<int32_t>::write<nvs_set_i32>(this, name.c_str(), item);
-	return err;
-    }; /* stream::write<int32_t>() */
-    template esp_err_t stream::write(const std::string&, int32_t);
+	    auto& shard = items[shard_of(name)];
+	    auto it = shard.find(name);
 
-    ///@brief Write the int64_t item to the NVS namespace
-    template <>
-    esp_err_t stream::write<int64_t>(const std::string& name, int64_t item)
+	return (it != shard.end() && it->second.type == type)? &it->second.data: nullptr;
+    }; /* stream::image::find() */
+
+
+    bool stream::image::same(const key& name, nvs_type_t type, const void* data, size_t size) const
     {
-	//err = nvs_set_i64(handle, name.c_str(), item);
-	err = nvs::stream::core<int64_t>::write<nvs_set_i64>(this, name.c_str(), item);
-	return err;
-    }; /* stream::write<int64_t>() */
-    template esp_err_t stream::write(const std::string&, int64_t);
+	    const std::string* stored = find(name, type);
 
+	return stored && stored->size() == size && memcmp(stored->data(), data, size) == 0;
+    }; /* stream::image::same() */
 
-    ///@brief Write the const char[] item to the NVS namespace
-    template <>
-    esp_err_t stream::write<const char[]>(const std::string& name, const char item[])
+
+    void stream::image::update(const key& name, nvs_type_t type, const void* data, size_t size)
     {
-	    size_t size = get_size<char[]>(name);
+	items[shard_of(name)][name] = item{type, std::string(static_cast<const char*>(data), size)};
+    }; /* stream::image::update() */
 
-	if (err == ESP_OK && size == strlen(item))
-	{
-		std::string tmpstr = "";
 
-	    read(name, tmpstr);
-	    if (err == ESP_OK && tmpstr == item)
-		return err;
-	}; /* if err == ESP_OK && size == item.length() */
-	ESP_LOGW(__func__, "Write the C-string char[] item '%s', value is: %s", name.c_str(), item);
-	err = nvs_set_str(handler(store), name.c_str(), item);
-	if (err == ESP_OK)
-	    set_chgst();
-	return err;
-    }; /* stream::write<const char[]>() */
-    template esp_err_t stream::write<const char[]>(const std::string& name, const char item[]);
+    void stream::image::forget(const key& name)
+    {
+	items[shard_of(name)].erase(name);
+    }; /* stream::image::forget() */
+
+
+    ///--[ Class nvs::stream ]-----------------------------------------------------------------------------------------
+
+    /// Manipulation with the NVS device namespaces
+
+
+    /// Specialization of the stream::get_size() for the std::string type
+    template <>
+    size_t stream::get_size<std::string>(const key& name);
+
+    /// Specialization of the stream::get_size() for the char[] type
+    template <>
+    size_t stream::get_size<char[]>(const key& name);
+
+    /// Specialization of the stream::get_size() for the 'void' type (implied the 'blob' item)
+    template <>
+    size_t stream::get_size<void>(const key& name);
 
-    ///@brief Write the const std::string& item to the NVS namespace
+    /// Specialization of the stream::get_size() for the 'void*' type (implied the 'blob' item)
     template <>
-    esp_err_t stream::write<const std::string&>(const std::string& name, const std::string& item)
+    size_t stream::get_size<void*>(const key& name);
+
+
+
+    stream::stream(): err(ESP_ERR_NVS_INVALID_STATE) {};
+
+
+    stream::stream(const std::string& spacename, open_mode mode, shadow_mode shmode, task_mode tmode)
+    {
+	NVS_LOGI(__func__, "Create nvs::stream object with namespace name \"%s\"", spacename.c_str());
+	open(spacename, mode, shmode, tmode);
+    }; /* stream::stream */
+
+    stream::~stream()
+    {
+	close();
+	delete sync;
+    }; /* stream::~stream() */
+
+    esp_err_t stream::open(const std::string& name, open_mode mode, shadow_mode shmode, task_mode tmode)
+    {
+	return open_partition(NVS_DEFAULT_PART_NAME, name, mode, shmode, tmode);
+    }; /* stream::open */
+
+    esp_err_t stream::open_partition(const std::string& part_name, const std::string& name, open_mode mode,
+	    shadow_mode shmode, task_mode tmode)
     {
-	    size_t size = get_size<std::string>(name);
+	    NVS_TIME_OP(open);
+	    esp_err_t rc;
 
-	if (err == ESP_OK && size == item.length())
+	NVS_LOGI(__func__, "Open the nvs namespace with name \"%s\" on the partition \"%s\"", name.c_str(), part_name.c_str());
+	// the task mode of the open stream is kept: its locks may be held by the other tasks
+	if (store && (tmode == multi_task) != (sync != nullptr))
+	{
+	    NVS_LOGE(__func__, "Task mode of the open stream is not changed, close it first");
+	    return (err = ESP_ERR_INVALID_STATE);
+	}; /* if store && ... */
+	if (!store && tmode == multi_task && !sync)
+	    sync = new locks;
+	else if (!store && tmode == single_task && sync)
+	{
+	    delete sync;
+	    sync = nullptr;
+	}; /* else if !store && ... */
+
+	    whole_lock guard(*this);
+	    bool fresh;
+
+	// reopening: the previous namespace is released
+	delete shadow;
+	shadow = nullptr;
+	packs = false;
+	if (store)
+	    pool::release(store);
+	// the device is checked by the pool, only when the handle is really opened
+	device = &dev::partition(part_name);
+	rc = pool::acquire(part_name, name, mode, store, fresh);
+	if (rc == ESP_OK)
 	{
-		std::string tmpstr = "";
+	    NVS_LOGI(__func__, "Initializing NVS namespase is OK");
+	    meter = telemetry::attach(part_name, name);
+	    // the interrupted transaction is completed once, at the first opening after the reset
+	    if (fresh && mode == readwrite)
+		recover();
+	    if (shmode == shadowed)
+	    {
+		shadow = new image;
+		if ((rc = shadow->load(handler(store), name.c_str())) != ESP_OK)
+		{
+		    NVS_LOGE(__func__, "Error loading the shadow of the NVS namespace %s: %s", name.c_str(), esp_err_to_name(rc));
+		    delete shadow;
+		    shadow = nullptr;
+		}; /* if (rc = shadow->load(...)) != ESP_OK */
+	    }; /* if shmode == shadowed */
+	}
+	else
+	{
+	    store = 0;
+	    meter = nullptr;
+	    NVS_LOGE(__func__, "Error initializing NVS namespase %s: %s", name.c_str(), esp_err_to_name(rc));
+	}; /* else if rc == ESP_OK */
+	NVS_TRACE_OP("open", name.c_str(), "namespace", (mode == readwrite)? "readwrite": "readonly", rc);
+	return (err = rc);
+    }; /* stream::open_partition */
 
-	    read(name, tmpstr);
-	    if (err == ESP_OK && tmpstr == item)
-		return err;
-	}; /* if err == ESP_OK && size == item.length() */
 
-	ESP_LOGW(__func__, "Write the std::string item '%s', value is: %s", name.c_str(), item.c_str());
-	err = nvs_set_str(handler(store), name.c_str(), item.c_str());
-	if (err == ESP_OK)
+    // the partition of the stream is initialized
+    bool stream::ready() const
+    {
+	return device && device->isOK();
+    }; /* stream::ready() */
+
+
+    esp_err_t stream::close()
+    {
+	    whole_lock guard(*this);
+
+	delete shadow;
+	shadow = nullptr;
+	packs = false;
+	if (store)
+	    pool::release(store);
+	store = 0;
+	meter = nullptr;
+	err = ESP_OK;
+	return ESP_OK;
+    }; /* stream::close() */
+
+
+    // the mark is cached once seen: it is never removed from the namespace
+    bool stream::packs_marked()
+    {
+	return packs || (ready() && (packs = has_pack_mark(handler(store))));
+    }; /* stream::packs_marked() */
+
+
+    // Mark the namespace before its first compressed item: every plain blob is checked once, that it
+    // does not start by the header. The namespace with such blob is not marked: its items are plain.
+    bool stream::mark_packs()
+    {
+	    whole_lock guard(*this);	// no blob is written by the other task during the check
+	    nvs_iterator_t it = nullptr;
+	    esp_err_t rc;
+
+	if (packs_marked() || !ready())
+	    return packs;
+	for (rc = nvs_entry_find_in_handle(handler(store), NVS_TYPE_BLOB, &it); rc == ESP_OK; rc = nvs_entry_next(&it))
+	{
+		nvs_entry_info_t info;
+		std::vector<uint8_t> stored;
+		uint8_t flags;
+		size_t size = 0;
+
+	    nvs_entry_info(it, &info);
+	    if (nvs_get_blob(handler(store), info.key, nullptr, &size) == ESP_OK && size >= pack_header
+		    && get_blob(handler(store), info.key, stored) == ESP_OK && packed(stored.data(), stored.size(), flags, size))
+	    {
+		NVS_LOGW(__func__, "Plain blob '%s' starts by the header of the compressed item: nothing is compressed", info.key);
+		rc = ESP_ERR_NVS_TYPE_MISMATCH;
+		break;
+	    }; /* if nvs_get_blob(...) == ESP_OK && ... */
+	}; /* for rc = nvs_entry_find_in_handle(...); ... */
+	nvs_release_iterator(it);
+	if (rc == ESP_ERR_NVS_NOT_FOUND && nvs_set_u8(handler(store), pack_mark, pack_format) == ESP_OK)
+	{
 	    set_chgst();
-	return err;
-    }; /* stream::write<const std::string&>() */
-    template esp_err_t stream::write(const std::string&, const std::string&);
+	    packs = true;
+	}; /* if rc == ESP_ERR_NVS_NOT_FOUND && ... */
+	return packs;
+    }; /* stream::mark_packs() */
 
+    esp_err_t  stream::read_blob(const key& name, void* item, size_t& length)
+    {
+	    NVS_TIME_OP(read_blob);
+	    key_lock guard(*this, name);
+	    size_t room = length;
+	    esp_err_t rc = (ready())? nvs_get_blob(handler(store), name.c_str(), item, &length): ESP_ERR_NVS_INVALID_STATE;
+	    std::vector<uint8_t> stored;
+	    uint8_t flags;
+	    size_t size;
+
+	// the packed blob: it is in the caller's buffer already, or is read in the whole for the size query & the short
+	// buffer; the blobs of the unmarked namespace are plain, the size query of them is the lookup only
+	if (rc == ESP_OK && item && packed(item, length, flags, size) && packs_marked())
+	{
+	    stored.assign(static_cast<const uint8_t*>(item), static_cast<const uint8_t*>(item) + length);
+	    rc = (size > room)? ESP_ERR_NVS_INVALID_LENGTH: unpack(stored.data(), stored.size(), item, size);
+	    length = size;
+	}
+	else if (((rc == ESP_OK && !item) || rc == ESP_ERR_NVS_INVALID_LENGTH) && length >= pack_header && packs_marked()
+		&& get_blob(handler(store), name.c_str(), stored) == ESP_OK && packed(stored.data(), stored.size(), flags, size))
+	{
+	    rc = (!item)? ESP_OK: (size > room)? ESP_ERR_NVS_INVALID_LENGTH: unpack(stored.data(), stored.size(), item, size);
+	    length = size;
+	}; /* else if (rc == ESP_OK && !item) || ... */
+	NVS_TRACE_OP("read", name.c_str(), "blob", printf_helper(uint32_t(length)).c_str(), rc);
+	return (err = rc);
+    }; /* stream::read_blob() */
+
+    ///@brief read the blob into the vector: single probe into its own buffer, if the capacity is enough
+    esp_err_t stream::read_blob(const key& name, std::vector<uint8_t>& item)
+    {
+	    NVS_TIME_OP(read_blob);
+	    key_lock guard(*this, name);
+	    size_t oldsz = item.size();
+	    size_t length;
+	    uint8_t flags;
+	    esp_err_t rc;
+
+	if (!ready())
+	    return (err = ESP_ERR_NVS_INVALID_STATE);
+	item.resize(item.capacity());
+	length = item.size();
+	rc = nvs_get_blob(handler(store), name.c_str(), item.data(), &length);
+	// no capacity at all: the probe was the size query only
+	if (rc == ESP_ERR_NVS_INVALID_LENGTH || (rc == ESP_OK && item.empty() && length > 0))
+	{
+	    item.resize(length);
+	    rc = nvs_get_blob(handler(store), name.c_str(), item.data(), &length);
+	}; /* if rc == ESP_ERR_NVS_INVALID_LENGTH */
+	item.resize((rc == ESP_OK)? length: oldsz);
+	if (rc == ESP_OK && packed(item.data(), item.size(), flags, length) && packs_marked())
+	{
+		std::vector<uint8_t> stored(item);
 
+	    item.resize(length);
+	    rc = unpack(stored.data(), stored.size(), item.data(), length);
+	}; /* if rc == ESP_OK && packed(...) */
+	NVS_TRACE_OP("read", name.c_str(), "blob", printf_helper(uint32_t(item.size())).c_str(), rc);
+	return (err = rc);
+    }; /* stream::read_blob(std::vector<uint8_t>&) */
 
-    ///@brief Write the uint8_t item to the NVS namespace
-    template <>
-    esp_err_t stream::write<uint8_t>(const std::string& name, uint8_t item)
+    esp_err_t stream::write_blob(const key& name, const void* item, size_t length)
     {
-	//err = nvs_set_u8(handle, name.c_str(), item);
-	err = nvs::stream::core<uint8_t>::write<nvs_set_u8>(this, name.c_str(), item);
-	return err;
-    }; /* stream::write<uint8_t>() */
-    template esp_err_t stream::write(const std::string&, uint8_t);
+	    NVS_TIME_OP(write_blob);
+	    bool marked = packing && mark_packs();	// before the key lock
+	    key_lock guard(*this, name);
+	    std::vector<uint8_t> stored;
+	    uint8_t flags;
+	    size_t size;
+	    bool encoded = ready() && encode(item, length, 0, packing, marked
+		    || (packed(item, length, flags, size) && packs_marked()), stored);
+	    esp_err_t rc = (!ready())? ESP_ERR_NVS_INVALID_STATE:
+		    encoded? nvs_set_blob(handler(store), name.c_str(), stored.data(), stored.size()):
+		    nvs_set_blob(handler(store), name.c_str(), item, length);
+
+	if (rc == ESP_OK)
+	{
+	    telemetry::written(meter, name, encoded? stored.size(): length);
+	    if (shadow)
+		shadow->forget(name);	// the item of other type, if any, is replaced by the blob
+	}; /* if rc == ESP_OK */
+	NVS_TRACE_OP("write", name.c_str(), encoded? "packed": "blob", printf_helper(uint32_t(length)).c_str(), rc);
+	return (err = rc);
+    }; /* stream::set_blob */
 
-    ///XXX operation 'write<unsigned char>()' was duplicated & redefined the 'write<uint8_t>()', therefore is not needed
+    esp_err_t stream::commit()
+    {
+	    NVS_TIME_OP(commit);
+	    // change state is dropped before the commit: the write of other task after it is kept
+	    bool was = chg_st.exchange(false);
+	    esp_err_t rc = (ready())? nvs_commit(handler(store)): ESP_ERR_NVS_INVALID_STATE;
+
+	if (rc == ESP_OK)
+	    telemetry::committed(meter);
+	else if (was)
+	    set_chgst();
+	NVS_TRACE_OP("commit", "-", "-", "-", rc);
+	return (err = rc);
+    }; /* stream::commit */
 
-    // Write the uint16_t item to the NVS namespace
-    template <>
-    esp_err_t stream::write<uint16_t>(const std::string& name, uint16_t item)
+    /// set the changing state of the nvs::stream
+    inline void stream::set_chgst()
     {
-	//err = nvs_set_u16(handle, name.c_str(), item);
-	err = nvs::stream::core<uint16_t>::write<nvs_set_u16>(this, name.c_str(), item);
-	return err;
-    }; /* stream::write<uint16_t>() */
-    template esp_err_t stream::write(const std::string&, uint16_t);
+	chg_st = true;
+    }; /* stream::set_chgst() */
 
-    // Write the uint32_t item to the NVS namespace
-    template <>
-    esp_err_t stream::write<uint32_t>(const std::string& name, uint32_t item)
+
+
+
+
+
+    /// Read the integer item of the NVS type 'type': from the shadow, if any
+    esp_err_t stream::get_int(const key& name, nvs_type_t type, void* item)
     {
-	//err = nvs_set_u32(handle, name.c_str(), item);
-	err = nvs::stream::core<uint32_t>::write<nvs_set_u32>(this, name.c_str(), item);
-	return err;
-    }; /* stream::write<uint32_t>() */
-    template esp_err_t stream::write(const std::string&, uint32_t);
+	    NVS_TIME_OP(read);
+	    key_lock guard(*this, name);
+	    size_t width = type & 0x0F;
+	    esp_err_t rc;
 
+	if (shadow)
+	{
+		const std::string* stored = shadow->find(name, type);
 
-    // Write the uint64_t item to the NVS namespace
-    template <>
-    esp_err_t stream::write<uint64_t>(const std::string& name, uint64_t item)
+	    if (stored)
+		memcpy(item, stored->data(), width);
+	    rc = stored? ESP_OK: ESP_ERR_NVS_NOT_FOUND;
+	}
+	else
+	    rc = get_into(handler(store), name.c_str(), type, item, width);
+	NVS_TRACE_OP("read", name.c_str(), type_name(type), printf_helper(type, item).c_str(), rc);
+	return (err = rc);
+    }; /* stream::get_int() */
+
+
+    /// Write the integer item of the NVS type 'type', if the stored value is differ
+    esp_err_t stream::put_int(const key& name, nvs_type_t type, const void* item)
     {
-	//err = nvs_set_u64(handle, name.c_str(), item);
-	err = stream::core<uint64_t>::write<nvs_set_u64>(this, name.c_str(), item);
-	return err;
-    }; /* stream::write<uint64_t>() */
-    template esp_err_t stream::write(const std::string&, uint64_t);
+	    NVS_TIME_OP(write);
+	    key_lock guard(*this, name);	// read-compare-write of the key is atomic
+	    size_t width = type & 0x0F;
+	    bool dirty;
+	    esp_err_t rc;
+
+	if (shadow)
+	{
+	    // change detection is a memory compare with the shadow image
+	    dirty = !shadow->same(name, type, item, width);
+	    rc = ESP_OK;
+	}
+	else
+	{
+		uint64_t stored = 0;
+		size_t size = sizeof(stored);
+
+	    rc = get_into(handler(store), name.c_str(), type, &stored, size);
+	    dirty = rc == ESP_ERR_NVS_NOT_FOUND || (rc == ESP_OK && memcmp(&stored, item, width) != 0);
+	}; /* else if shadow */
+	if (dirty)
+	{
+	    rc = set_int(handler(store), name.c_str(), type, item);
+	    if (rc == ESP_OK)
+	    {
+		set_chgst();
+		telemetry::written(meter, name, width);
+		if (shadow)
+		    shadow->update(name, type, item, width);
+	    }; /* if rc == ESP_OK */
+	}
+	else if (rc == ESP_OK)
+	    telemetry::skipped(meter, name);
+	NVS_TRACE_OP(dirty? "write": "skip", name.c_str(), type_name(type), printf_helper(type, item).c_str(), rc);
+	return (err = rc);
+    }; /* stream::put_int() */
+
+
+    /// Read the object, stored as the blob of exactly 'size' bytes; the object is kept on error
+    esp_err_t stream::get_fixed(const key& name, void* item, size_t size)
+    {
+	    NVS_TIME_OP(read_blob);
+	    key_lock guard(*this, name);
+	    size_t length = 0;
+	    esp_err_t rc = (ready())? nvs_get_blob(handler(store), name.c_str(), nullptr, &length): ESP_ERR_NVS_INVALID_STATE;
+
+	if (rc == ESP_OK && length != size)
+	    rc = ESP_ERR_NVS_INVALID_LENGTH;
+	if (rc == ESP_OK)
+	    rc = nvs_get_blob(handler(store), name.c_str(), item, &length);
+	NVS_TRACE_OP("read", name.c_str(), "blob", printf_helper(uint32_t(size)).c_str(), rc);
+	return (err = rc);
+    }; /* stream::get_fixed() */
+
+
+    /// Write the object as the blob, if the stored one is differ
+    esp_err_t stream::put_fixed(const key& name, const void* item, size_t size)
+    {
+	    NVS_TIME_OP(write_blob);
+	    key_lock guard(*this, name);	// read-compare-write of the key is atomic
+	    size_t length = 0;
+	    esp_err_t rc;
+
+	if (!ready())
+	    return (err = ESP_ERR_NVS_INVALID_STATE);
+	rc = nvs_get_blob(handler(store), name.c_str(), nullptr, &length);
+	if (rc == ESP_OK && length == size)
+	{
+		std::string stored(size, '\0');
+
+	    rc = nvs_get_blob(handler(store), name.c_str(), stored.data(), &length);
+	    if (rc == ESP_OK && memcmp(stored.data(), item, size) == 0)
+	    {
+		telemetry::skipped(meter, name);
+		NVS_TRACE_OP("skip", name.c_str(), "blob", printf_helper(uint32_t(size)).c_str(), rc);
+		return (err = rc);
+	    }; /* if rc == ESP_OK && ... */
+	}; /* if rc == ESP_OK && length == size */
+
+	rc = nvs_set_blob(handler(store), name.c_str(), item, size);
+	if (rc == ESP_OK)
+	{
+	    set_chgst();
+	    telemetry::written(meter, name, size);
+	    if (shadow)
+		shadow->forget(name);	// the item of other type, if any, is replaced by the blob
+	}; /* if rc == ESP_OK */
+	NVS_TRACE_OP("write", name.c_str(), "blob", printf_helper(uint32_t(size)).c_str(), rc);
+	return (err = rc);
+    }; /* stream::put_fixed() */
+
+
+
+    // Read the std::string item from the NVS namespace
+    esp_err_t stream::get_str(const key& name, std::string& item)
+    {
+	    NVS_TIME_OP(read);
+	    key_lock guard(*this, name);
+	    esp_err_t rc;
+
+	NVS_LOGW(__func__, "Read the char[] item '%s', old value is: \"%s\"", name.c_str(), item.c_str());
+	if (shadow)
+	{
+		const std::string* stored = shadow->find(name, NVS_TYPE_STR);
+
+	    if (stored)
+		item = *stored;
+	    rc = stored? ESP_OK: ESP_ERR_NVS_NOT_FOUND;
+	    NVS_TRACE_OP("read", name.c_str(), "std::string", item.c_str(), rc);
+	    return (err = rc);
+	}; /* if shadow */
+
+	    size_t oldsz = item.size();
+	    size_t bufsz;
+
+	// single probe into the own buffer of the 'item', if the capacity is enough;
+	// otherwise the size is reported by the nvs_get_str(), second probe after the resize
+	item.resize(item.capacity());
+	bufsz = item.size() + 1;	// terminating zero is always room in the std::string
+	rc = nvs_get_str(handler(store), name.c_str(), item.data(), &bufsz);
+	if (rc == ESP_ERR_NVS_INVALID_LENGTH)
+	{
+	    item.resize(bufsz - 1);
+	    rc = nvs_get_str(handler(store), name.c_str(), item.data(), &bufsz);
+	}; /* if rc == ESP_ERR_NVS_INVALID_LENGTH */
+	item.resize((rc == ESP_OK)? bufsz - 1: oldsz);	// an old value is kept on error
+	if (rc == ESP_ERR_NVS_NOT_FOUND || rc == ESP_ERR_NVS_TYPE_MISMATCH)
+	{
+		std::string text;
+		esp_err_t packed_rc = get_packed_str(handler(store), name.c_str(), text);	// the string may be compressed
+
+	    if (packed_rc == ESP_OK)
+		item = std::move(text);
+	    if (packed_rc != ESP_ERR_NVS_NOT_FOUND)
+		rc = packed_rc;
+	}; /* if rc == ESP_ERR_NVS_NOT_FOUND || ... */
+	NVS_LOGI(__func__, "                 New value of the %s is: \"%s\", new buffer size is: %zu", name.c_str(), item.c_str(), bufsz);
+	NVS_TRACE_OP("read", name.c_str(), "std::string", item.c_str(), rc);
+	return (err = rc);
+    }; /* stream::get_str() */
+
+
+    /// Write the string item, if the stored value is differ
+    esp_err_t stream::put_str(const key& name, const char item[], size_t length)
+    {
+	    NVS_TIME_OP(write);
+	    bool marked = packing && mark_packs();	// before the key lock
+	    key_lock guard(*this, name);	// read-compare-write of the key is atomic
+	    std::vector<uint8_t> stored;
+	    bool encoded = false;
+	    esp_err_t rc;
+
+	if (shadow)
+	{
+	    if (shadow->same(name, NVS_TYPE_STR, item, length))
+	    {
+		telemetry::skipped(meter, name);
+		NVS_TRACE_OP("skip", name.c_str(), "string", item, ESP_OK);
+		return (err = ESP_OK);
+	    }; /* if shadow->same(...) */
+	    encoded = encode(item, length, pack_string, packing, marked, stored);
+	}
+	else if ((encoded = encode(item, length, pack_string, packing, marked, stored)))
+	{
+	    // the encoding is the same for the same string: the stored blob is compared
+	    if (same_blob(handler(store), name.c_str(), stored))
+	    {
+		telemetry::skipped(meter, name);
+		NVS_TRACE_OP("skip", name.c_str(), "string", item, ESP_OK);
+		return (err = ESP_OK);
+	    }; /* if same_blob(...) */
+	}
+	else
+	{
+		size_t size = 0;
+
+	    rc = nvs_get_str(handler(store), name.c_str(), nullptr, &size);
+	    // stored size includes the terminating zero
+	    if (rc == ESP_OK && size == length + 1)
+	    {
+		    std::string tmpstr(size, '\0');
+
+		rc = nvs_get_str(handler(store), name.c_str(), tmpstr.data(), &size);
+		if (rc == ESP_OK && memcmp(tmpstr.data(), item, length) == 0)
+		{
+		    telemetry::skipped(meter, name);
+		    NVS_TRACE_OP("skip", name.c_str(), "string", item, rc);
+		    return (err = rc);
+		}; /* if rc == ESP_OK && ... */
+	    }; /* if rc == ESP_OK && size == length + 1 */
+	}; /* else if shadow */
+
+	NVS_LOGW(__func__, "Write the string item '%s', value is: %s", name.c_str(), item);
+	rc = encoded? nvs_set_blob(handler(store), name.c_str(), stored.data(), stored.size()):
+		nvs_set_str(handler(store), name.c_str(), item);
+	if (rc == ESP_OK)
+	{
+	    set_chgst();
+	    telemetry::written(meter, name, encoded? stored.size(): length + 1);
+	    if (shadow)
+		shadow->update(name, NVS_TYPE_STR, item, length);
+	}; /* if rc == ESP_OK */
+	NVS_TRACE_OP("write", name.c_str(), "string", item, rc);
+	return (err = rc);
+    }; /* stream::put_str() */
+
+
 
 
     ///@brief write c-string to nvs storage
-    esp_err_t stream::write_str(const std::string& name, const char* item)
+    esp_err_t stream::write_str(const key& name, const char* item)
     {
-	err = nvs_set_str(handler(store), name.c_str(), item);
-	return err;
+	    NVS_TIME_OP(write);
+	    bool marked = packing && mark_packs();	// before the key lock
+	    key_lock guard(*this, name);
+	    std::vector<uint8_t> stored;
+	    bool encoded = encode(item, strlen(item), pack_string, packing, marked, stored);
+	    esp_err_t rc = encoded? nvs_set_blob(handler(store), name.c_str(), stored.data(), stored.size()):
+		    nvs_set_str(handler(store), name.c_str(), item);
+
+	if (rc == ESP_OK)
+	{
+	    set_chgst();
+	    telemetry::written(meter, name, encoded? stored.size(): strlen(item) + 1);
+	    if (shadow)
+		shadow->update(name, NVS_TYPE_STR, item, strlen(item));
+	}; /* if rc == ESP_OK */
+	NVS_TRACE_OP("write", name.c_str(), "char*", item, rc);
+	return (err = rc);
     }; /* stream::write_str() */
 
+#if __cplusplus > 201703L
+    ///@brief Read the string into the caller's buffer: single lookup, no allocation
+    esp_err_t stream::read(const key& name, std::span<char> item)
+    {
+	    size_t length = item.size();
+
+	return read_str(name, item.data(), length);
+    }; /* stream::read(std::span<char>) */
+#endif
+
     ///@brief read c-string from nvs storage
-    esp_err_t  stream::read_str(const std::string& name, char* item, size_t& length)
+    esp_err_t  stream::read_str(const key& name, char* item, size_t& length)
     {
-	 err = nvs_get_str(handler(store), name.c_str(), item, &length);
-	 return err;
+	    NVS_TIME_OP(read);
+	    key_lock guard(*this, name);
+	    esp_err_t rc;
+
+	if (shadow)
+	{
+		const std::string* stored = shadow->find(name, NVS_TYPE_STR);
+
+	    if (!stored)
+		return (err = ESP_ERR_NVS_NOT_FOUND);
+	    rc = copy_str(*stored, item, length);
+	    NVS_TRACE_OP("read", name.c_str(), "char*", (rc == ESP_OK && item)? item: "-", rc);
+	    return (err = rc);
+	}; /* if shadow */
+	 rc = nvs_get_str(handler(store), name.c_str(), item, &length);
+	 if (rc == ESP_ERR_NVS_NOT_FOUND || rc == ESP_ERR_NVS_TYPE_MISMATCH)
+	 {
+		std::string text;
+		esp_err_t packed_rc = get_packed_str(handler(store), name.c_str(), text);	// the string may be compressed
+
+	    if (packed_rc == ESP_OK)
+		packed_rc = copy_str(text, item, length);
+	    if (packed_rc != ESP_ERR_NVS_NOT_FOUND)
+		rc = packed_rc;
+	 }; /* if rc == ESP_ERR_NVS_NOT_FOUND || ... */
+	 NVS_TRACE_OP("read", name.c_str(), "char*", (rc == ESP_OK && item)? item: "-", rc);
+	 return (err = rc);
     }; /* stream::read_str() */
 
 
 
 
     /**
-     * size_t stream::get_size(const std::string& name);
+     * size_t stream::get_size(const key& name);
      * get size of the item named 'name';
      * defined for the std::string, char* (length of stored string) or
      * void*, void (length of the blob)
@@ -667,44 +1867,2591 @@ namespace nvs
 
     /// Specialization of the stream::get_size() for the std::string type
     template <>
-    size_t stream::get_size<std::string>(const std::string& name)
+    size_t stream::get_size<std::string>(const key& name)
     {
 	    size_t size = -1;
+	    esp_err_t rc = nvs_get_str(handler(store), name.c_str(), NULL, &size);
 
-	err = nvs_get_str(handler(store), name.c_str(), NULL, &size);
-	ESP_LOGW(__func__, "Get size of the %s with type <std::string>, size is: %i, returned error state is: %i", name.c_str(), size, err);
-	return (err == ESP_OK)? size: -1;
+	NVS_LOGW(__func__, "Get size of the %s with type <std::string>, size is: %zu, returned error state is: %i", name.c_str(), size, rc);
+	err = rc;
+	return (rc == ESP_OK)? size: -1;
     }; /* stream::get_size<std::string>() */
-    template size_t stream::get_size<std::string>(const std::string& name);
+    template size_t stream::get_size<std::string>(const key& name);
 
     /// Specialization of the stream::get_size() for the char[] type
     template <>
-    size_t stream::get_size<char[]>(const std::string& name) {
-	ESP_LOGW(__func__, "Get size of the %s with type <char[]> (or a <char*>), redirected to a stream::get_size<std::string>()", name.c_str());
+    size_t stream::get_size<char[]>(const key& name) {
+	NVS_LOGW(__func__, "Get size of the %s with type <char[]> (or a <char*>), redirected to a stream::get_size<std::string>()", name.c_str());
 	return get_size<std::string>(name); }
 
-    template size_t stream::get_size<char[]>(const std::string& name);
+    template size_t stream::get_size<char[]>(const key& name);
 
     /// Specialization of the stream::get_size() for the 'void' type (implied the 'blob' item)
     template <>
-    size_t stream::get_size<void>(const std::string& name)
+    size_t stream::get_size<void>(const key& name)
     {
 	    size_t size = -1;	// TODO stub only!!! Modify it!!!
+	    esp_err_t rc = nvs_get_blob(handler(store), name.c_str(), NULL, &size);
 
-	err = nvs_get_blob(handler(store), name.c_str(), NULL, &size);
-	ESP_LOGW(__func__, "Get size of the %s with type <void> (implied the 'blob' item), size is: %i, returned error state is: %i", name.c_str(), size, err);
-	return (err == ESP_OK)? size: -1;
+	NVS_LOGW(__func__, "Get size of the %s with type <void> (implied the 'blob' item), size is: %zu, returned error state is: %i", name.c_str(), size, rc);
+	err = rc;
+	return (rc == ESP_OK)? size: -1;
     }; /* stream::get_size<void>() */
-    template size_t stream::get_size<void>(const std::string& name);
+    template size_t stream::get_size<void>(const key& name);
 
     /// Specialization of the stream::get_size() for the 'void*' type (implied the 'blob' item)
     template <>
-    size_t stream::get_size<void*>(const std::string& name) {
-	ESP_LOGW(__func__, "Get size of the %s with type <void*> (implied the 'blob' item), redirected to a stream::get_size<void>()", name.c_str());
+    size_t stream::get_size<void*>(const key& name) {
+	NVS_LOGW(__func__, "Get size of the %s with type <void*> (implied the 'blob' item), redirected to a stream::get_size<void>()", name.c_str());
 	return get_size<void>(name); }
-    template size_t stream::get_size<void*>(const std::string& name);
+    template size_t stream::get_size<void*>(const key& name);
 
 
 
-}; /* namespace nvs */
+    ///--[ Class nvs::stream::iterator ]-------------------------------------------------------------------------------
+
+    /// One pass of the NVS entry iterator over the namespace of the stream
+
+
+    stream::iterator::iterator(stream& strm): strm(&strm)
+    {
+	if (!strm.ready())
+	{
+	    err = ESP_ERR_NVS_INVALID_STATE;
+	    return;
+	}; /* if !strm.ready() */
+	err = nvs_entry_find_in_handle(handler(strm.store), NVS_TYPE_ANY, &it);
+	if (err == ESP_ERR_NVS_NOT_FOUND)
+	    err = ESP_OK;	// empty namespace
+	if (!fetch())
+	    ++(*this);
+    }; /* stream::iterator::iterator() */
+
+    stream::iterator::iterator(iterator&& other):
+	strm(other.strm), it(other.it), cur(other.cur), err(other.err)
+    {
+	other.it = nullptr;
+    }; /* stream::iterator::iterator(iterator&&) */
+
+    stream::iterator& stream::iterator::operator=(iterator&& other)
+    {
+	if (this != &other)
+	{
+	    nvs_release_iterator(it);
+	    strm = other.strm;
+	    it = other.it;
+	    cur = other.cur;
+	    err = other.err;
+	    other.it = nullptr;
+	}; /* if this != &other */
+	return *this;
+    }; /* stream::iterator::operator=() */
+
+    stream::iterator::~iterator()
+    {
+	nvs_release_iterator(it);
+    }; /* stream::iterator::~iterator() */
+
+
+    stream::iterator& stream::iterator::operator++()
+    {
+	do
+	{
+	    if (!it)
+		return *this;
+	    err = nvs_entry_next(&it);	// the NVS releases the iterator at the end
+	    if (err == ESP_ERR_NVS_NOT_FOUND)
+		err = ESP_OK;
+	    else if (err != ESP_OK)
+	    {
+		nvs_release_iterator(it);
+		it = nullptr;
+	    }; /* else if err != ESP_OK */
+	} while (!fetch());	// the reserved keys (a lot of the blob chunks) are skipped in the loop
+	return *this;
+    }; /* stream::iterator::operator++() */
+
+
+    bool stream::iterator::fetch()
+    {
+	    nvs_entry_info_t info;
+
+	if (!it)
+	    return true;
+	nvs_entry_info(it, &info);
+	if (info.key[0] == reserved_prefix)
+	    return false;
+	cur = entry(*strm, info.key, info.type);
+	return true;
+    }; /* stream::iterator::fetch() */
+
+
+    stream::iterator stream::begin()
+    {
+	return iterator(*this);
+    }; /* stream::begin() */
+
+    stream::iterator stream::end()
+    {
+	return iterator();
+    }; /* stream::end() */
+
+
+    template <typename T>
+    static esp_err_t read_as(const entry& ent, value& item)
+    {
+	    T val;
+	    esp_err_t err = ent.read(val);
+
+	if (err == ESP_OK)
+	    item = std::move(val);
+	return err;
+    }; /* read_as() */
+
+    esp_err_t entry::read(value& item) const
+    {
+	if (!strm)
+	    return ESP_ERR_NVS_INVALID_STATE;
+	switch (ktype)
+	{
+	case NVS_TYPE_I8:  return read_as<int8_t>  (*this, item);
+	case NVS_TYPE_U8:  return read_as<uint8_t> (*this, item);
+	case NVS_TYPE_I16: return read_as<int16_t> (*this, item);
+	case NVS_TYPE_U16: return read_as<uint16_t>(*this, item);
+	case NVS_TYPE_I32: return read_as<int32_t> (*this, item);
+	case NVS_TYPE_U32: return read_as<uint32_t>(*this, item);
+	case NVS_TYPE_I64: return read_as<int64_t> (*this, item);
+	case NVS_TYPE_U64: return read_as<uint64_t>(*this, item);
+	case NVS_TYPE_STR: return read_as<std::string>(*this, item);
+	case NVS_TYPE_BLOB:
+	{
+		std::vector<uint8_t> blob;
+		esp_err_t err = strm->read_blob(kname, blob);
+
+	    if (err == ESP_OK)
+		item = std::move(blob);
+	    return err;
+	}; /* case NVS_TYPE_BLOB */
+	default:
+	    return ESP_ERR_NVS_TYPE_MISMATCH;
+	}; /* switch ktype */
+    }; /* entry::read(value&) */
+
+
+    // Read all the items of the namespace into the map
+    esp_err_t stream::load(std::map<key, value>& items)
+    {
+	    sweep_lock guard(*this);
+	    iterator it = begin();
+	    esp_err_t rc = ESP_OK;
+
+	for (; it != end() && rc == ESP_OK; ++it)
+	    rc = it->read(items[it->name()]);
+	if (rc == ESP_OK)
+	    rc = it.status();
+	NVS_TRACE_OP("load", "-", "map", printf_helper(uint32_t(items.size())).c_str(), rc);
+	return (err = rc);
+    }; /* stream::load(std::map<key, value>&) */
+
+
+    // Fill the caller's table: the entries of the namespace are matched with the table sorted by the key
+    esp_err_t stream::load(binding table[], size_t count)
+    {
+	    sweep_lock guard(*this);
+	    std::vector<binding*> index(count);
+	    size_t loaded = 0;
+
+	for (size_t i = 0; i < count; i++)
+	    index[i] = &table[i];
+	std::sort(index.begin(), index.end(), [](const binding* a, const binding* b) { return a->name < b->name; });
+
+	    iterator it = begin();
+
+	for (; it != end(); ++it)
+	{
+		auto pos = std::lower_bound(index.begin(), index.end(), it->name(),
+			[](const binding* b, const key& k) { return b->name < k; });
+		const std::string* stored;
+
+	    if (pos == index.end() || (*pos)->name != it->name())
+		continue;
+
+		binding& b = **pos;
+
+	    if (b.type != it->type() && !(b.type == NVS_TYPE_STR && it->is_blob()))	// the string may be compressed
+		b.err = ESP_ERR_NVS_TYPE_MISMATCH;
+	    else if (b.type == NVS_TYPE_STR)
+		b.err = read_str(b.name, static_cast<char*>(b.data), b.size);
+	    else
+	    {
+		    key_lock guard(*this, b.name);
+
+		if (shadow && b.type != NVS_TYPE_BLOB && (stored = shadow->find(b.name, b.type)) != nullptr)
+		{
+		    memcpy(b.data, stored->data(), stored->size());
+		    b.size = stored->size();
+		    b.err = ESP_OK;
+		}
+		else
+		    b.err = get_into(handler(store), b.name.c_str(), b.type, b.data, b.size);
+	    }; /* else if b.type == NVS_TYPE_STR */
+	    if (b.err == ESP_OK)
+		loaded++;
+	}; /* for ; it != end(); ++it */
+	NVS_TRACE_OP("load", "-", "table", printf_helper(uint32_t(loaded)).c_str(), it.status());
+	return (err = it.status());
+    }; /* stream::load(binding[], size_t) */
+
+
+
+    ///--[ Class nvs::stream::transaction ]----------------------------------------------------------------------------
+
+    /// Journal of the transaction, the blob:
+    ///	magic:u32, generation:u32, count:u16,
+    ///	count * {type:u8, key length:u8, key, data length:u32, data},
+    ///	crc32:u32 of all above
+
+    static constexpr uint32_t journal_magic = 0x5854564E;	// "NVTX"
+
+    template <typename T>
+    static void put(std::string& out, T val) {
+	out.append(reinterpret_cast<const char*>(&val), sizeof(val)); };
+
+    template <typename T>
+    static bool get(const std::string& in, size_t& pos, T& val)
+    {
+	if (pos + sizeof(val) > in.size())
+	    return false;
+	memcpy(&val, in.data() + pos, sizeof(val));
+	pos += sizeof(val);
+	return true;
+    }; /* get() */
+
+
+    // Complete the transaction interrupted by the reset, if any
+    esp_err_t stream::recover()
+    {
+	    size_t size = 0;
+	    esp_err_t rc = nvs_get_blob(handler(store), transaction::journal_key, nullptr, &size);
+
+	if (rc == ESP_ERR_NVS_NOT_FOUND)
+	    return ESP_OK;
+
+	    std::string journal(size, '\0');
+
+	if (rc == ESP_OK)
+	    rc = nvs_get_blob(handler(store), transaction::journal_key, journal.data(), &size);
+	if (rc == ESP_OK)
+	{
+	    NVS_LOGW(__func__, "Complete the interrupted transaction, journal size is %zu", size);
+	    rc = replay(journal);
+	}; /* if rc == ESP_OK */
+	if (rc != ESP_OK)
+	    NVS_LOGE(__func__, "Interrupted transaction is not completed: %s", esp_err_to_name(rc));
+	NVS_TRACE_OP("recover", transaction::journal_key, "blob", "-", rc);
+	return rc;
+    }; /* stream::recover() */
+
+
+    // Apply the transaction journal: all the items, then the generation; then drop the journal
+    esp_err_t stream::replay(const std::string& journal)
+    {
+	    struct entry
+	    {
+		uint8_t type = 0;
+		std::string_view name;
+		std::string_view data;
+	    }; /* struct entry */
+
+	    size_t pos = 0, end = 0;
+	    uint32_t magic = 0, gen = 0, crc = 0;
+	    uint16_t count = 0;
+	    std::vector<entry> entries;
+	    std::string_view raw(journal);
+	    esp_err_t rc = ESP_OK;
+
+	if (journal.size() >= sizeof(crc))
+	{
+	    end = journal.size() - sizeof(crc);
+	    pos = end;
+	    if (get(journal, pos, crc) && crc == crc32(0, journal.data(), end))
+	    {
+		pos = 0;
+		get(journal, pos, magic);
+		get(journal, pos, gen);
+		get(journal, pos, count);
+	    }
+	    else
+		end = 0;
+	}; /* if journal.size() >= sizeof(crc) */
+	if (end && magic != journal_magic)
+	    return ESP_ERR_INVALID_VERSION;
+	// every entry is checked before any item is touched
+	for (entries.reserve(count); end && entries.size() < count;)
+	{
+		entry e;
+		uint8_t keylen = 0;
+		uint32_t len = 0;
+
+	    if (!get(journal, pos, e.type) || !get(journal, pos, keylen) || keylen > end - pos)
+		break;
+	    e.name = raw.substr(pos, keylen);
+	    pos += keylen;
+	    if (!get(journal, pos, len) || len > end - pos)
+		break;
+	    e.data = raw.substr(pos, len);
+	    pos += len;
+	    entries.push_back(e);
+	}; /* for entries.reserve(count); end && entries.size() < count; */
+	if (!end || entries.size() != count || pos != end)
+	{
+	    // torn or corrupted journal: the transaction was not started
+	    NVS_LOGE(__func__, "Transaction journal is broken, dropped");
+	    nvs_erase_key(handler(store), transaction::journal_key);
+	    return nvs_commit(handler(store));
+	}; /* if !end || ... */
+
+	for (auto it = entries.begin(); it != entries.end() && rc == ESP_OK; ++it)
+	{
+		key name(it->name);
+		std::string data(it->data);
+
+	    rc = set_raw(handler(store), name.c_str(), nvs_type_t(it->type), data);
+	    if (rc == ESP_OK)
+		telemetry::written(meter, name, data.size());
+	    if (rc == ESP_OK && shadow)
+	    {
+		if (it->type == NVS_TYPE_BLOB)
+		    shadow->forget(name);
+		else
+		    shadow->update(name, nvs_type_t(it->type), data.data(), data.size());
+	    }; /* if rc == ESP_OK && shadow */
+	}; /* for auto it = entries.begin(); ... */
+	// on error the journal is kept: the transaction will be completed later
+	if (rc == ESP_OK)
+	    rc = nvs_set_u32(handler(store), transaction::generation_key, gen);
+	if (rc == ESP_OK && shadow)
+	    shadow->update(transaction::generation_key, NVS_TYPE_U32, &gen, sizeof(gen));
+	if (rc == ESP_OK)
+	    rc = nvs_erase_key(handler(store), transaction::journal_key);
+	if (rc == ESP_OK)
+	    rc = nvs_commit(handler(store));
+	if (rc == ESP_OK)
+	    clr_chngst();
+	return rc;
+    }; /* stream::replay() */
+
+
+    /// stage the item, replace the same key staged before
+    esp_err_t stream::transaction::stage(const key& name, nvs_type_t type, const void* data, size_t size)
+    {
+	if (!name.valid())
+	    return ESP_ERR_NVS_KEY_TOO_LONG;
+	if (name.empty() || name == journal_key || name == generation_key)
+	    return ESP_ERR_NVS_INVALID_NAME;
+	items[name] = item{type, std::string(static_cast<const char*>(data), size)};
+	return ESP_OK;
+    }; /* stream::transaction::stage() */
+
+
+    esp_err_t stream::transaction::write_str(const key& name, const char* item) {
+	return stage(name, NVS_TYPE_STR, item, strlen(item)); };
+
+    esp_err_t stream::transaction::write_blob(const key& name, const void* item, size_t length) {
+	return stage(name, NVS_TYPE_BLOB, item, length); };
+
+
+    // Apply the staged items as one batch
+    esp_err_t stream::transaction::commit()
+    {
+	    NVS_TIME_OP(commit);
+	    whole_lock guard(strm);	// the batch is applied with no other operation on the stream
+	    std::map<key, item> batch;
+	    std::string journal;
+	    size_t gensize = sizeof(gen);
+	    esp_err_t rc;
+
+	batch.swap(items);
+	if (!strm.ready())
+	    return ESP_ERR_NVS_INVALID_STATE;
+	// the journal of the failed commit is completed first: its batch is never left half-applied
+	if ((rc = strm.recover()) != ESP_OK)
+	    return (strm.err = rc);
+
+	// drop the unchanged items: compare with the shadow or with the stored values
+	for (auto it = batch.begin(); it != batch.end();)
+	{
+		bool same;
+
+	    if (strm.shadow && it->second.type != NVS_TYPE_BLOB)
+		same = strm.shadow->same(it->first, it->second.type, it->second.data.data(), it->second.data.size());
+	    else
+	    {
+		    std::string stored;
+		    size_t size = 0;
+
+		if (it->second.type == NVS_TYPE_BLOB)
+		{
+		    rc = nvs_get_blob(handler(strm.store), it->first.c_str(), nullptr, &size);
+		    if (rc == ESP_OK && size == it->second.data.size())
+		    {
+			stored.resize(size);
+			rc = nvs_get_blob(handler(strm.store), it->first.c_str(), stored.data(), &size);
+		    }; /* if rc == ESP_OK && size == it->second.data.size() */
+		}
+		else
+		    rc = get_raw(handler(strm.store), it->first.c_str(), it->second.type, stored);
+		same = rc == ESP_OK && stored == it->second.data;
+	    }; /* else if strm.shadow && ... */
+	    if (same)
+		telemetry::skipped(strm.meter, it->first);
+	    it = same? batch.erase(it): std::next(it);
+	}; /* for auto it = batch.begin(); it != batch.end(); */
+	if (batch.empty())
+	{
+	    NVS_TRACE_OP("txn", "-", "batch", "unchanged", ESP_OK);
+	    return ESP_OK;
+	}; /* if batch.empty() */
+	if (batch.size() > max_items)
+	    return (strm.err = ESP_ERR_INVALID_SIZE);
+
+	rc = get_into(handler(strm.store), generation_key, NVS_TYPE_U32, &gen, gensize);
+	if (rc == ESP_ERR_NVS_NOT_FOUND)
+	    gen = 0;
+	else if (rc != ESP_OK)
+	    return (strm.err = rc);
+	gen++;
+
+	put(journal, journal_magic);
+	put(journal, gen);
+	put(journal, uint16_t(batch.size()));
+	for (auto& it: batch)
+	{
+	    put(journal, uint8_t(it.second.type));
+	    put(journal, uint8_t(it.first.length()));
+	    journal += it.first.view();
+	    put(journal, uint32_t(it.second.data.size()));
+	    journal += it.second.data;
+	}; /* for auto& it: batch */
+	put(journal, crc32(0, journal.data(), journal.size()));
+
+	// the journal is durable before any item is touched
+	rc = nvs_set_blob(handler(strm.store), journal_key, journal.data(), journal.size());
+	if (rc == ESP_OK)
+	{
+	    telemetry::written(strm.meter, journal_key, journal.size());
+	    rc = nvs_commit(handler(strm.store));
+	}; /* if rc == ESP_OK */
+	if (rc == ESP_OK)
+	    rc = strm.replay(journal);
+	if (rc == ESP_OK)
+	    telemetry::committed(strm.meter);
+	NVS_TRACE_OP("txn", "-", "batch", printf_helper(uint32_t(batch.size())).c_str(), rc);
+	return (strm.err = rc);
+    }; /* stream::transaction::commit() */
+
+
+
+    ///--[ Class nvs::stream::write_behind ]---------------------------------------------------------------------------
+
+    /// Queue of the write-behind & its thread
+    class stream::write_behind::worker
+    {
+    public:
+	struct item
+	{
+	    nvs_type_t type;
+	    std::string data;
+	    bool fixed = false;	///< the object of write<T>: the plain blob, as by the stream::write<T>()
+	}; /* struct item */
+
+	worker(const policy& pol): pol(pol) {};
+
+	void run(stream& strm);	///< body of the worker thread
+	static esp_err_t apply(stream& strm, const key& name, const item& it);	///< write the queued item
+
+	policy pol;
+	std::mutex lock;
+	std::condition_variable wake;	///< to the worker: the batch is full, the flush or the stop
+	std::condition_variable room;	///< to the writers: the queue is taken by the worker
+	std::map<key, item> items;	///< queued items, sorted by the key
+	std::vector<std::promise<esp_err_t>> waiters;	///< flush() calls, done by the next batch
+	std::chrono::steady_clock::time_point first;	///< time of the first queued item
+	esp_err_t failed = ESP_OK;	///< first error since the previous flush
+	bool stop = false;
+	stats st;
+	std::thread thread;
+    }; /* class nvs::stream::write_behind::worker */
+
+
+    /// value of the integer item from its bytes
+    template <typename T>
+    static T as(const std::string& data)
+    {
+	    T val;
+
+	memcpy(&val, data.data(), sizeof(val));
+	return val;
+    }; /* as() */
+
+    // write the queued item by the stream operation, which queued it: the stored item is the same
+    esp_err_t stream::write_behind::worker::apply(stream& strm, const key& name, const item& it)
+    {
+	    const std::string& data = it.data;
+
+	switch (it.type)
+	{
+	case NVS_TYPE_I8:
+	    return strm.write<int8_t>(name, as<int8_t>(data));
+	case NVS_TYPE_U8:
+	    return strm.write<uint8_t>(name, as<uint8_t>(data));
+	case NVS_TYPE_I16:
+	    return strm.write<int16_t>(name, as<int16_t>(data));
+	case NVS_TYPE_U16:
+	    return strm.write<uint16_t>(name, as<uint16_t>(data));
+	case NVS_TYPE_I32:
+	    return strm.write<int32_t>(name, as<int32_t>(data));
+	case NVS_TYPE_U32:
+	    return strm.write<uint32_t>(name, as<uint32_t>(data));
+	case NVS_TYPE_I64:
+	    return strm.write<int64_t>(name, as<int64_t>(data));
+	case NVS_TYPE_U64:
+	    return strm.write<uint64_t>(name, as<uint64_t>(data));
+	case NVS_TYPE_STR:
+	    return strm.write<const std::string&>(name, data);
+	case NVS_TYPE_BLOB:
+	    return it.fixed? strm.put_fixed(name, data.data(), data.size()): strm.write_blob(name, data.data(), data.size());
+	default:
+	    return ESP_ERR_NVS_TYPE_MISMATCH;
+	}; /* switch it.type */
+    }; /* stream::write_behind::worker::apply() */
+
+
+    // Apply the queued items by batches, until stopped
+    void stream::write_behind::worker::run(stream& strm)
+    {
+	    std::unique_lock<std::mutex> guard(lock);
+
+	while (true)
+	{
+	    // wait for the batch: enough items, the interval of the first item elapsed, the flush or the stop
+	    while (!stop && waiters.empty() && items.size() < pol.batch)
+		if (items.empty())
+		    wake.wait(guard);
+		else if (wake.wait_until(guard, first + std::chrono::milliseconds(pol.interval_ms)) == std::cv_status::timeout)
+		    break;
+	    if (stop && items.empty() && waiters.empty())
+		break;
+
+		std::map<key, item> batch;
+		std::vector<std::promise<esp_err_t>> done;
+		esp_err_t rc = ESP_OK;
+		uint32_t errors = 0;
+
+	    batch.swap(items);
+	    done.swap(waiters);
+	    room.notify_all();
+	    guard.unlock();
+
+	    // the flash is touched out of the lock: the writers are not stalled by the GC
+	    for (auto& it: batch)
+	    {
+		    esp_err_t irc = apply(strm, it.first, it.second);
+
+		if (irc != ESP_OK)
+		{
+		    NVS_LOGE(__func__, "Error of the write-behind of the key '%s': %s", it.first.c_str(), esp_err_to_name(irc));
+		    errors++;
+		    if (rc == ESP_OK)
+			rc = irc;
+		}; /* if irc != ESP_OK */
+	    }; /* for auto& it: batch */
+	    if (!batch.empty())
+	    {
+		    esp_err_t crc = strm.commit();
+
+		if (crc != ESP_OK)
+		{
+		    errors++;
+		    if (rc == ESP_OK)
+			rc = crc;
+		}; /* if crc != ESP_OK */
+		NVS_TRACE_OP("behind", "-", "batch", printf_helper(uint32_t(batch.size())).c_str(), rc);
+	    }; /* if !batch.empty() */
+
+	    guard.lock();
+	    st.applied += batch.size();
+	    st.batches += !batch.empty();
+	    st.errors += errors;
+	    if (failed == ESP_OK)
+		failed = rc;
+	    if (!done.empty())
+	    {
+		for (auto& p: done)
+		    p.set_value(failed);
+		failed = ESP_OK;
+	    }; /* if !done.empty() */
+	}; /* while true */
+    }; /* stream::write_behind::worker::run() */
+
+
+    stream::write_behind::write_behind(stream& strm, const policy& pol): strm(strm), work(new worker(pol))
+    {
+#ifdef ESP_PLATFORM
+	    esp_pthread_cfg_t old;
+	    bool restore = esp_pthread_get_cfg(&old) == ESP_OK;
+	    esp_pthread_cfg_t cfg = esp_pthread_get_default_config();
+
+	cfg.stack_size = pol.stack_size;
+	cfg.prio = pol.priority;
+	cfg.thread_name = "nvs_behind";
+	esp_pthread_set_cfg(&cfg);
+#endif
+	work->thread = std::thread(&worker::run, work, std::ref(strm));
+#ifdef ESP_PLATFORM
+	if (restore)
+	    esp_pthread_set_cfg(&old);
+#endif
+    }; /* stream::write_behind::write_behind() */
+
+
+    stream::write_behind::~write_behind()
+    {
+	{
+		std::lock_guard<std::mutex> guard(work->lock);
+
+	    work->stop = true;
+	    work->wake.notify_one();
+	}
+	work->thread.join();
+	delete work;
+    }; /* stream::write_behind::~write_behind() */
+
+
+    // Queue the item; the queued item of the same key is replaced
+    esp_err_t stream::write_behind::stage(const key& name, nvs_type_t type, const void* data, size_t size, bool fixed)
+    {
+	if (!name.valid())
+	    return ESP_ERR_NVS_KEY_TOO_LONG;
+	if (name.empty())
+	    return ESP_ERR_NVS_INVALID_NAME;
+
+	    std::unique_lock<std::mutex> guard(work->lock);
+	    auto full = [this, &name]() { return work->items.size() >= work->pol.capacity && !work->items.count(name); };
+
+	if (full())
+	{
+	    work->st.full_waits++;
+	    work->wake.notify_one();
+	    if (!work->room.wait_for(guard, std::chrono::milliseconds(work->pol.full_wait_ms), [&full]() { return !full(); }))
+		return ESP_ERR_TIMEOUT;
+	}; /* if full() */
+	    bool was_empty = work->items.empty();
+
+	if (was_empty)
+	    work->first = std::chrono::steady_clock::now();
+	if (!work->items.insert_or_assign(name, worker::item{type, std::string(static_cast<const char*>(data), size), fixed}).second)
+	    work->st.coalesced++;
+	work->st.queued++;
+	// the first item starts the interval of the worker, the full batch - the apply
+	if (was_empty || work->items.size() >= work->pol.batch)
+	    work->wake.notify_one();
+	return ESP_OK;
+    }; /* stream::write_behind::stage() */
 
+
+    esp_err_t stream::write_behind::write_str(const key& name, const char* item) {
+	return stage(name, NVS_TYPE_STR, item, strlen(item)); };
+
+    esp_err_t stream::write_behind::write_blob(const key& name, const void* item, size_t length) {
+	return stage(name, NVS_TYPE_BLOB, item, length); };
+
+
+    std::shared_future<esp_err_t> stream::write_behind::flush()
+    {
+	    std::lock_guard<std::mutex> guard(work->lock);
+
+	work->waiters.emplace_back();
+	work->wake.notify_one();
+	return work->waiters.back().get_future().share();
+    }; /* stream::write_behind::flush() */
+
+
+    size_t stream::write_behind::pending() const
+    {
+	    std::lock_guard<std::mutex> guard(work->lock);
+
+	return work->items.size();
+    }; /* stream::write_behind::pending() */
+
+
+    stream::write_behind::stats stream::write_behind::get_stats() const
+    {
+	    std::lock_guard<std::mutex> guard(work->lock);
+
+	return work->st;
+    }; /* stream::write_behind::get_stats() */
+
+
+
+    ///--[ Chunked blobs: nvs::stream::blob_writer & nvs::stream::blob_reader ]---------------------------------------
+
+    static constexpr uint32_t chunked_magic = 0x4243564E;	// "NVCB"
+    static constexpr uint16_t chunked_format = 1;
+    static constexpr uint32_t max_chunks = 0x100000;	///< index of the chunk is 5 hex digits of the key
+
+    /// Header of the chunked blob, stored at the key of the blob
+    struct chunked_header
+    {
+	static constexpr size_t size = 28;	///< bytes of the stored header
+
+	uint16_t format = chunked_format;
+	char set = 'a';			///< set of the chunk keys, 'a' or 'b'
+	uint32_t chunk = 0;		///< bytes of the chunk, the last one may be shorter
+	uint32_t chunks = 0;
+	uint64_t length = 0;		///< bytes of the payload
+	uint32_t crc = 0;		///< CRC-32 of the payload
+    }; /* struct chunked_header */
+
+    template <typename T>
+    static void put(uint8_t*& out, T val)
+    {
+	memcpy(out, &val, sizeof(val));
+	out += sizeof(val);
+    }; /* put(uint8_t*&) */
+
+    template <typename T>
+    static void get(const uint8_t*& in, T& val)
+    {
+	memcpy(&val, in, sizeof(val));
+	in += sizeof(val);
+    }; /* get(const uint8_t*&) */
+
+    /// write the header of the chunked blob 'name'
+    static esp_err_t write_header(stream& strm, const key& name, const chunked_header& hdr)
+    {
+	    uint8_t raw[chunked_header::size] = {};
+	    uint8_t* out = raw;
+
+	put(out, chunked_magic);
+	put(out, hdr.format);
+	put(out, uint8_t(hdr.set));
+	put(out, uint8_t(0));
+	put(out, hdr.chunk);
+	put(out, hdr.chunks);
+	put(out, hdr.length);
+	put(out, hdr.crc);
+	return strm.write_blob(name, raw, sizeof(raw));
+    }; /* write_header() */
+
+    /// read the header of the chunked blob 'name'; ESP_ERR_NVS_TYPE_MISMATCH, if the blob is not chunked
+    static esp_err_t read_header(stream& strm, const key& name, chunked_header& hdr)
+    {
+	    uint8_t raw[chunked_header::size];
+	    const uint8_t* in = raw;
+	    size_t length = sizeof(raw);
+	    esp_err_t rc = strm.read_blob(name, raw, length);
+	    uint32_t magic = 0;
+	    uint8_t set = 0, pad = 0;
+
+	if (rc == ESP_ERR_NVS_INVALID_LENGTH)
+	    return ESP_ERR_NVS_TYPE_MISMATCH;	// the large plain blob
+	if (rc != ESP_OK)
+	    return rc;
+	if (length != sizeof(raw))
+	    return ESP_ERR_NVS_TYPE_MISMATCH;
+	get(in, magic);
+	get(in, hdr.format);
+	get(in, set);
+	get(in, pad);
+	get(in, hdr.chunk);
+	get(in, hdr.chunks);
+	get(in, hdr.length);
+	get(in, hdr.crc);
+	hdr.set = char(set);
+	if (magic != chunked_magic || (hdr.set != 'a' && hdr.set != 'b'))
+	    return ESP_ERR_NVS_TYPE_MISMATCH;
+	if (hdr.format != chunked_format)
+	    return ESP_ERR_INVALID_VERSION;
+	return ESP_OK;
+    }; /* read_header() */
+
+    static_assert(max_chunks - 1 <= 0xFFFFF, "index of the chunk is 5 hex digits of the key");
+
+    /// key of the chunk 'index' of the blob 'name': reserved prefix, hash of the name, set & index
+    static key chunk_key(const key& name, char set, uint32_t index)
+    {
+	    char buff[NVS_KEY_NAME_MAX_SIZE];
+
+	snprintf(buff, sizeof(buff), "%c%08" PRIx32 "%c%05" PRIx32, stream::reserved_prefix, fnv1a(name.c_str()), set,
+		index & (max_chunks - 1));
+	return key(buff);
+    }; /* chunk_key() */
+
+    /// key of the owner of the reserved keys of the hash of 'name': the name, which took them
+    static key owner_key(const key& name)
+    {
+	    char buff[NVS_KEY_NAME_MAX_SIZE];
+
+	snprintf(buff, sizeof(buff), "%c%08" PRIx32 "o", stream::reserved_prefix, fnv1a(name.c_str()));
+	return key(buff);
+    }; /* owner_key() */
+
+    // The keys stored before the owners were recorded are nobody's
+    esp_err_t stream::check_owner(const key& name, bool claim)
+    {
+	    key okey = owner_key(name);
+	    key_lock guard(*this, okey);
+	    char owner[NVS_KEY_NAME_MAX_SIZE];
+	    size_t length = sizeof(owner);
+	    esp_err_t rc = (ready())? nvs_get_str(handler(store), okey.c_str(), owner, &length): ESP_ERR_NVS_INVALID_STATE;
+
+	if (rc == ESP_ERR_NVS_NOT_FOUND && claim)
+	{
+	    if ((rc = nvs_set_str(handler(store), okey.c_str(), name.c_str())) == ESP_OK)
+	    {
+		set_chgst();
+		if (shadow)
+		    shadow->update(okey, NVS_TYPE_STR, name.c_str(), name.length());
+	    }; /* if (rc = nvs_set_str(...)) == ESP_OK */
+	    return rc;
+	}; /* if rc == ESP_ERR_NVS_NOT_FOUND && claim */
+	if (rc == ESP_ERR_NVS_NOT_FOUND)
+	    return ESP_OK;
+	if (rc == ESP_ERR_NVS_INVALID_LENGTH || (rc == ESP_OK && name != owner))
+	{
+	    NVS_LOGE(__func__, "Reserved keys of '%s' are taken by the other name of the same hash", name.c_str());
+	    return ESP_ERR_INVALID_STATE;
+	}; /* if rc == ESP_ERR_NVS_INVALID_LENGTH || ... */
+	return rc;
+    }; /* stream::check_owner() */
+
+
+    stream::blob_writer::blob_writer(stream& strm, const key& name, size_t chunk):
+	strm(strm), name(name), buff(chunk)
+    {
+	    chunked_header old;
+
+	if (!name.valid())
+	    err = ESP_ERR_NVS_KEY_TOO_LONG;
+	else if (chunk == 0 || uint64_t(chunk) > UINT32_MAX)
+	    err = ESP_ERR_INVALID_SIZE;
+	else
+	    err = strm.check_owner(name, true);
+	// the chunks go to the other set than of the previous blob, which is kept intact until the finish
+	if (err == ESP_OK && read_header(strm, name, old) == ESP_OK)
+	{
+	    set = (old.set == 'a')? 'b': 'a';
+	    old_chunks = old.chunks;
+	}
+	else
+	    set = 'a';
+    }; /* stream::blob_writer::blob_writer() */
+
+    stream::blob_writer::~blob_writer()
+    {
+	if (done)
+	    return;
+	// unfinished: the chunks written are dropped, the previous blob is intact
+	for (uint32_t i = 0; i < chunks; i++)
+	    nvs_erase_key(handler(strm.store), chunk_key(name, set, i).c_str());
+    }; /* stream::blob_writer::~blob_writer() */
+
+
+    esp_err_t stream::blob_writer::store_chunk()
+    {
+	if (chunks >= max_chunks)
+	    return (err = ESP_ERR_INVALID_SIZE);	// the writer is stopped, the chunks are erased by the destructor
+	crc = crc32(crc, buff.data(), fill);
+	if ((err = strm.write_blob(chunk_key(name, set, chunks), buff.data(), fill)) == ESP_OK)
+	{
+	    chunks++;
+	    fill = 0;
+	}; /* if (err = strm.write_blob(...)) == ESP_OK */
+	return err;
+    }; /* stream::blob_writer::store_chunk() */
+
+
+    esp_err_t stream::blob_writer::write(const void* data, size_t length)
+    {
+	    const uint8_t* in = static_cast<const uint8_t*>(data);
+	    esp_err_t rc;
+
+	if (err != ESP_OK)
+	    return err;
+	if (done)
+	    return ESP_ERR_INVALID_STATE;
+	while (length)
+	{
+		size_t part = std::min(length, buff.size() - fill);
+
+	    memcpy(buff.data() + fill, in, part);
+	    fill += part;
+	    in += part;
+	    length -= part;
+	    total += part;
+	    if (fill == buff.size() && (rc = store_chunk()) != ESP_OK)
+		return rc;
+	}; /* while length */
+	return ESP_OK;
+    }; /* stream::blob_writer::write() */
+
+
+    esp_err_t stream::blob_writer::finish()
+    {
+	    chunked_header hdr;
+	    esp_err_t rc;
+
+	if (done || err != ESP_OK)
+	    return err;
+	if (fill && (rc = store_chunk()) != ESP_OK)
+	    return rc;
+	hdr.set = set;
+	hdr.chunk = buff.size();
+	hdr.chunks = chunks;
+	hdr.length = total;
+	hdr.crc = crc;
+	// the header switches the blob to the new chunks
+	if ((err = write_header(strm, name, hdr)) != ESP_OK)
+	    return err;
+	done = true;
+	// chunks of the previous blob & the leftovers of the interrupted writes are not needed anymore
+	for (uint32_t i = 0; i < old_chunks; i++)
+	    nvs_erase_key(handler(strm.store), chunk_key(name, (set == 'a')? 'b': 'a', i).c_str());
+	for (uint32_t i = chunks; i < max_chunks && nvs_erase_key(handler(strm.store), chunk_key(name, set, i).c_str()) == ESP_OK; i++)
+	    ;
+	NVS_TRACE_OP("write", name.c_str(), "chunked", printf_helper(uint32_t(chunks)).c_str(), err);
+	return err;
+    }; /* stream::blob_writer::finish() */
+
+
+    stream::blob_reader::blob_reader(stream& strm, const key& name): strm(strm), name(name)
+    {
+	    chunked_header hdr;
+
+	if ((err = read_header(strm, name, hdr)) != ESP_OK || (err = strm.check_owner(name, false)) != ESP_OK)
+	    return;
+	if (hdr.chunk == 0 || hdr.chunks > max_chunks || hdr.length > uint64_t(hdr.chunk) * hdr.chunks)
+	{
+	    err = ESP_ERR_INVALID_SIZE;
+	    return;
+	}; /* if hdr.chunk == 0 || ... */
+	buff.resize(hdr.chunk);
+	chunks = hdr.chunks;
+	total = hdr.length;
+	expected = hdr.crc;
+	set = hdr.set;
+    }; /* stream::blob_reader::blob_reader() */
+
+
+    esp_err_t stream::blob_reader::load_chunk()
+    {
+	    uint64_t left = total - uint64_t(next) * buff.size();
+	    size_t length = buff.size();
+
+	if (next >= chunks)
+	    return (err = ESP_ERR_INVALID_SIZE);
+	if ((err = strm.read_blob(chunk_key(name, set, next), buff.data(), length)) != ESP_OK)
+	    return err;
+	if (length != std::min<uint64_t>(left, buff.size()))
+	    return (err = ESP_ERR_INVALID_SIZE);
+	crc = crc32(crc, buff.data(), length);
+	pos = 0;
+	fill = length;
+	next++;
+	return ESP_OK;
+    }; /* stream::blob_reader::load_chunk() */
+
+
+    esp_err_t stream::blob_reader::read(void* data, size_t& length)
+    {
+	    uint8_t* out = static_cast<uint8_t*>(data);
+	    size_t want = length;
+
+	length = 0;
+	if (err != ESP_OK)
+	    return err;
+	while (want && done < total)
+	{
+	    if (pos == fill && load_chunk() != ESP_OK)
+		return err;
+
+		size_t part = std::min(want, fill - pos);
+
+	    memcpy(out, buff.data() + pos, part);
+	    out += part;
+	    pos += part;
+	    want -= part;
+	    length += part;
+	    done += part;
+	}; /* while want && done < total */
+	if (done == total && crc != expected)
+	{
+	    NVS_LOGE(__func__, "CRC of the chunked blob '%s' does not match", name.c_str());
+	    err = ESP_ERR_INVALID_CRC;
+	}; /* if done == total && crc != expected */
+	return err;
+    }; /* stream::blob_reader::read() */
+
+
+
+    ///--[ Delta blobs ]-----------------------------------------------------------------------------------------------
+
+    static constexpr uint32_t delta_magic = 0x4244564E;	// "NVDB"
+    static constexpr uint16_t delta_format = 1;
+
+    /// Index entry of the delta blob: the header, the hash (CRC-32) & the slot of each chunk
+    class stream::delta_index
+    {
+    public:
+	static constexpr size_t header_size = 24;
+	static constexpr size_t entry_size = sizeof(uint32_t) + sizeof(char);
+
+	uint32_t chunk = 0;		///< bytes of the chunk, the last one may be shorter
+	uint64_t length = 0;		///< bytes of the blob
+	std::vector<uint32_t> hash;	///< CRC-32 of each chunk
+	std::vector<char> slot;		///< slot of each chunk, 'c' or 'd'
+
+	uint32_t chunks() const { return hash.size(); };
+	/// bytes of the chunk 'i'
+	size_t size_of(uint32_t i) const { return std::min<uint64_t>(chunk, length - uint64_t(i) * chunk); };
+
+	std::string encode() const
+	{
+		std::string raw;
+
+	    put(raw, delta_magic);
+	    put(raw, delta_format);
+	    put(raw, uint16_t(0));
+	    put(raw, chunk);
+	    put(raw, chunks());
+	    put(raw, length);
+	    for (uint32_t i = 0; i < chunks(); i++)
+	    {
+		put(raw, hash[i]);
+		put(raw, slot[i]);
+	    }; /* for uint32_t i = 0; i < chunks(); i++ */
+	    return raw;
+	}; /* delta_index::encode() */
+
+	/// ESP_ERR_NVS_TYPE_MISMATCH, if 'raw' is not the index of the delta blob
+	esp_err_t decode(const std::string& raw)
+	{
+		size_t pos = 0;
+		uint32_t magic = 0, count = 0;
+		uint16_t format = 0, pad = 0;
+
+	    if (!get(raw, pos, magic) || magic != delta_magic || !get(raw, pos, format) || !get(raw, pos, pad)
+		    || !get(raw, pos, chunk) || !get(raw, pos, count) || !get(raw, pos, length))
+		return ESP_ERR_NVS_TYPE_MISMATCH;
+	    if (format != delta_format)
+		return ESP_ERR_INVALID_VERSION;
+	    if (chunk == 0 || raw.size() != header_size + count * entry_size || length > uint64_t(chunk) * count)
+		return ESP_ERR_NVS_TYPE_MISMATCH;
+	    hash.resize(count);
+	    slot.resize(count);
+	    for (uint32_t i = 0; i < count; i++)
+	    {
+		get(raw, pos, hash[i]);
+		get(raw, pos, slot[i]);
+	    }; /* for uint32_t i = 0; i < count; i++ */
+	    return ESP_OK;
+	}; /* delta_index::decode() */
+    }; /* class nvs::stream::delta_index */
+
+
+    /// read the whole blob into the string
+    static esp_err_t get_blob(nvs_handle_t handle, const char kname[], std::string& out)
+    {
+	    size_t size = 0;
+	    esp_err_t err = nvs_get_blob(handle, kname, nullptr, &size);
+
+	if (err != ESP_OK)
+	    return err;
+	out.resize(size);
+	return nvs_get_blob(handle, kname, out.data(), &size);
+    }; /* get_blob() */
+
+
+    // Write the changed chunks & then the index
+    esp_err_t stream::write_blob_delta(const key& name, const void* item, size_t length, delta_stats* report, size_t chunk)
+    {
+	    esp_err_t owned = (name.valid() && ready())? check_owner(name, true): ESP_OK;
+	    key_lock guard(*this, name);
+	    const uint8_t* data = static_cast<const uint8_t*>(item);
+	    delta_index prev, next;
+	    delta_stats st;
+	    std::string raw;
+	    bool known;
+	    esp_err_t rc = ESP_OK;
+
+	if (report)
+	    *report = st;
+	if (!name.valid())
+	    return (err = ESP_ERR_NVS_KEY_TOO_LONG);
+	if (chunk == 0 || uint64_t(chunk) > UINT32_MAX || (length + chunk - 1) / chunk >= max_chunks)
+	    return (err = ESP_ERR_INVALID_SIZE);
+	if (!ready())
+	    return (err = ESP_ERR_NVS_INVALID_STATE);
+	if (owned != ESP_OK)
+	    return (err = owned);
+	known = get_blob(handler(store), name.c_str(), raw) == ESP_OK && prev.decode(raw) == ESP_OK;
+	if (!known)
+	    prev = delta_index();
+	st.chunks = (length + chunk - 1) / chunk;
+	next.chunk = chunk;
+	next.length = length;
+	next.hash.resize(st.chunks);
+	next.slot.resize(st.chunks);
+
+	// the changed chunk goes to the other slot: the previous blob is intact until the index is written
+	for (uint32_t i = 0; i < st.chunks && rc == ESP_OK; i++)
+	{
+		size_t size = next.size_of(i);
+		bool stored = i < prev.chunks();
+
+	    next.hash[i] = crc32(0, data + size_t(i) * chunk, size);
+	    if (stored && prev.chunk == chunk && prev.size_of(i) == size && prev.hash[i] == next.hash[i])
+	    {
+		next.slot[i] = prev.slot[i];
+		continue;
+	    }; /* if stored && ... */
+	    next.slot[i] = (stored && prev.slot[i] == 'c')? 'd': 'c';
+	    rc = nvs_set_blob(handler(store), chunk_key(name, next.slot[i], i).c_str(), data + size_t(i) * chunk, size);
+	    st.written++;
+	    st.bytes += size;
+	}; /* for uint32_t i = 0; i < st.chunks && rc == ESP_OK; i++ */
+
+	if (rc == ESP_OK && known && st.written == 0 && prev.chunks() == st.chunks && prev.length == length)
+	{
+	    if (report)
+		*report = st;
+	    telemetry::skipped(meter, name);
+	    NVS_TRACE_OP("write", name.c_str(), "delta", "unchanged", ESP_OK);
+	    return (err = ESP_OK);
+	}; /* if rc == ESP_OK && known && ... */
+	if (rc == ESP_OK)
+	{
+	    raw = next.encode();
+	    rc = nvs_set_blob(handler(store), name.c_str(), raw.data(), raw.size());
+	    st.bytes += raw.size();
+	}; /* if rc == ESP_OK */
+	if (rc == ESP_OK)
+	{
+	    set_chgst();
+	    telemetry::written(meter, name, st.bytes);
+	    if (shadow)
+		shadow->forget(name);	// the item of other type, if any, is replaced by the blob
+	    // the previous slots of the rewritten chunks & the chunks beyond the new end are dropped
+	    for (uint32_t i = 0; i < prev.chunks(); i++)
+		if (i >= st.chunks || next.slot[i] != prev.slot[i])
+		    nvs_erase_key(handler(store), chunk_key(name, prev.slot[i], i).c_str());
+	}; /* if rc == ESP_OK */
+	if (report)
+	    *report = st;
+	NVS_TRACE_OP("write", name.c_str(), "delta", printf_helper(uint32_t(st.bytes)).c_str(), rc);
+	return (err = rc);
+    }; /* stream::write_blob_delta() */
+
+
+    // Read the chunks of the delta blob into 'out' of idx.length bytes; the key of the blob is locked by the caller
+    esp_err_t stream::read_delta(const key& name, const delta_index& idx, uint8_t out[])
+    {
+	for (uint32_t i = 0; i < idx.chunks(); i++)
+	{
+		uint8_t* part = out + size_t(i) * idx.chunk;
+		size_t size = idx.size_of(i);
+		size_t got = size;
+		esp_err_t rc = nvs_get_blob(handler(store), chunk_key(name, idx.slot[i], i).c_str(), part, &got);
+
+	    if (rc != ESP_OK)
+		return rc;
+	    if (got != size)
+		return ESP_ERR_INVALID_SIZE;
+	    if (crc32(0, part, size) != idx.hash[i])
+	    {
+		NVS_LOGE(__func__, "Chunk %" PRIu32 " of the delta blob '%s' is corrupted", i, name.c_str());
+		return ESP_ERR_INVALID_CRC;
+	    }; /* if crc32(0, part, size) != idx.hash[i] */
+	}; /* for uint32_t i = 0; i < idx.chunks(); i++ */
+	return ESP_OK;
+    }; /* stream::read_delta() */
+
+
+    esp_err_t stream::read_blob_delta(const key& name, void* item, size_t& length)
+    {
+	    esp_err_t owned = (ready())? check_owner(name, false): ESP_OK;
+	    key_lock guard(*this, name);
+	    delta_index idx;
+	    std::string raw;
+	    esp_err_t rc = (ready())? get_blob(handler(store), name.c_str(), raw): ESP_ERR_NVS_INVALID_STATE;
+
+	if (rc == ESP_OK)
+	    rc = idx.decode(raw);
+	if (rc == ESP_OK)
+	    rc = owned;
+	if (rc == ESP_OK && length < idx.length)
+	    rc = ESP_ERR_NVS_INVALID_LENGTH;
+	if (rc == ESP_OK)
+	    rc = read_delta(name, idx, static_cast<uint8_t*>(item));
+	if (rc == ESP_OK || rc == ESP_ERR_NVS_INVALID_LENGTH)
+	    length = idx.length;	// the size of the blob, as the NVS reports it
+	NVS_TRACE_OP("read", name.c_str(), "delta", printf_helper(uint32_t(idx.length)).c_str(), rc);
+	return (err = rc);
+    }; /* stream::read_blob_delta() */
+
+
+    esp_err_t stream::read_blob_delta(const key& name, std::vector<uint8_t>& item)
+    {
+	    esp_err_t owned = (ready())? check_owner(name, false): ESP_OK;
+	    key_lock guard(*this, name);
+	    delta_index idx;
+	    std::string raw;
+	    esp_err_t rc = (ready())? get_blob(handler(store), name.c_str(), raw): ESP_ERR_NVS_INVALID_STATE;
+
+	if (rc == ESP_OK)
+	    rc = idx.decode(raw);
+	if (rc == ESP_OK)
+	    rc = owned;
+	if (rc == ESP_OK)
+	{
+	    item.resize(idx.length);
+	    if ((rc = read_delta(name, idx, item.data())) != ESP_OK)
+		item.clear();
+	}; /* if rc == ESP_OK */
+	NVS_TRACE_OP("read", name.c_str(), "delta", printf_helper(uint32_t(idx.length)).c_str(), rc);
+	return (err = rc);
+    }; /* stream::read_blob_delta(std::vector<uint8_t>&) */
+
+
+    ///--[ Class nvs::counter ]----------------------------------------------------------------------------------------
+
+    /// reserved key of the slot 'index' of the counter 'name'
+    static key slot_key(const key& name, uint8_t index)
+    {
+	    char buff[16];
+
+	snprintf(buff, sizeof(buff), "%c%08" PRIx32 "n%02x", stream::reserved_prefix, fnv1a(name.c_str()), index);
+	return key(buff);
+    }; /* slot_key() */
+
+
+    // Recover the value: the highest slot is the latest one
+    counter::counter(stream& strm, const key& name, const policy& pol):
+	strm(strm), name(name), pol(pol)
+    {
+	    bool found = false;
+
+	this->pol.slots = std::clamp<uint8_t>(pol.slots, 1, max_slots);
+	// the slots of the other counter of the same hash are not recovered
+	if ((fault = err = strm.check_owner(name, false)) != ESP_OK)
+	    return;
+	for (uint8_t i = 0; i < max_slots; i++)
+	{
+		uint64_t val = 0;
+		esp_err_t rc = strm.read(slot_key(name, i), val);
+
+	    if (rc == ESP_OK)
+	    {
+		present |= 1 << i;
+		if (!found || val > saved)
+		{
+		    saved = val;
+		    last = i;
+		    found = true;
+		}; /* if !found || val > saved */
+	    }
+	    else if (rc != ESP_ERR_NVS_NOT_FOUND && rc != ESP_ERR_NVS_TYPE_MISMATCH && err == ESP_OK)
+		err = rc;	// the slot is skipped, the error is reported
+	}; /* for uint8_t i = 0; i < max_slots; i++ */
+	if (!found)
+	    last = this->pol.slots - 1;	// the first persist goes to the slot 0
+	NVS_LOGI(__func__, "Counter '%s' is recovered from the slot %u: %" PRIu64, name.c_str(), last, saved);
+	NVS_TRACE_OP("recover", name.c_str(), "counter", printf_helper(NVS_TYPE_U64, &saved).c_str(), err);
+    }; /* counter::counter() */
+
+    counter::~counter()
+    {
+	flush();
+    }; /* counter::~counter() */
+
+
+    esp_err_t counter::persist()
+    {
+	if (!pending)
+	    return ESP_OK;
+
+	    uint8_t next = (last + 1) % pol.slots;
+	    uint64_t val = saved + pending;
+	    esp_err_t rc = claim();
+
+	if (rc == ESP_OK)
+	    rc = strm.write(slot_key(name, next), val);
+
+	if (rc == ESP_OK)
+	    rc = strm.commit();
+	if (rc == ESP_OK)
+	{
+	    saved = val;
+	    pending = 0;
+	    last = next;
+	    present |= 1 << next;
+	    st.persists++;
+	}
+	else
+	    st.errors++;	// the pending increments are kept for the next persist
+	NVS_TRACE_OP("persist", name.c_str(), "counter", printf_helper(NVS_TYPE_U64, &val).c_str(), rc);
+	return (err = rc);
+    }; /* counter::persist() */
+
+
+    esp_err_t counter::claim()
+    {
+	if (fault != ESP_OK)
+	    return fault;
+	if (!owned)
+	{
+		esp_err_t rc = strm.check_owner(name, true);
+
+	    if (rc != ESP_OK)
+		return rc;
+	    owned = true;
+	}; /* if !owned */
+	return ESP_OK;
+    }; /* counter::claim() */
+
+
+    esp_err_t counter::add(uint64_t delta)
+    {
+	    std::lock_guard<std::mutex> guard(lock);
+	    auto now = std::chrono::steady_clock::now();
+
+	if (!pending)
+	    since = now;
+	pending += delta;
+	st.adds++;
+	if ((pol.every && pending >= pol.every)
+		|| (pol.interval_ms && now - since >= std::chrono::milliseconds(pol.interval_ms)))
+	    return persist();
+	return ESP_OK;
+    }; /* counter::add() */
+
+
+    esp_err_t counter::flush()
+    {
+	    std::lock_guard<std::mutex> guard(lock);
+
+	return persist();
+    }; /* counter::flush() */
+
+
+    // The counter goes back: every stored slot is overwritten, none of them is higher after the reboot
+    esp_err_t counter::reset(uint64_t val)
+    {
+	    std::lock_guard<std::mutex> guard(lock);
+	    esp_err_t rc = claim();
+	    uint16_t slots = present | 1;
+
+	for (uint8_t i = 0; i < max_slots && rc == ESP_OK; i++)
+	    if (slots & (1 << i))
+		rc = strm.write(slot_key(name, i), val);
+	if (rc == ESP_OK)
+	    rc = strm.commit();
+	if (rc == ESP_OK)
+	{
+	    saved = val;
+	    pending = 0;
+	    last = 0;
+	    present = slots;
+	    st.persists++;
+	}
+	else
+	    st.errors++;
+	NVS_TRACE_OP("reset", name.c_str(), "counter", printf_helper(NVS_TYPE_U64, &val).c_str(), rc);
+	return (err = rc);
+    }; /* counter::reset() */
+
+
+    uint64_t counter::value() const
+    {
+	    std::lock_guard<std::mutex> guard(lock);
+
+	return saved + pending;
+    }; /* counter::value() */
+
+    uint64_t counter::stored() const
+    {
+	    std::lock_guard<std::mutex> guard(lock);
+
+	return saved;
+    }; /* counter::stored() */
+
+    esp_err_t counter::status() const
+    {
+	    std::lock_guard<std::mutex> guard(lock);
+
+	return err;
+    }; /* counter::status() */
+
+    counter::stats counter::get_stats() const
+    {
+	    std::lock_guard<std::mutex> guard(lock);
+
+	return st;
+    }; /* counter::get_stats() */
+
+
+
+    ///--[ Class nvs::ring_log ]---------------------------------------------------------------------------------------
+
+    static constexpr uint32_t ring_magic = 0x4C52564E;	// "NVRL"
+    static constexpr uint16_t ring_format = 1;
+    static constexpr size_t ring_index_size = 20;
+
+    static_assert(ring_log::max_capacity - 1 <= 0xFFFFF, "slot of the record is 5 hex digits of the key");
+
+    /// reserved key of the record slot 'slot' of the log 'name'
+    static key record_key(const key& name, uint32_t slot)
+    {
+	    char buff[16];
+
+	snprintf(buff, sizeof(buff), "%c%08" PRIx32 "l%05" PRIx32, stream::reserved_prefix, fnv1a(name.c_str()),
+		slot & (ring_log::max_capacity - 1));
+	return key(buff);
+    }; /* record_key() */
+
+
+    // Open the log: one read of the index; the new log is not stored till the first append
+    ring_log::ring_log(stream& strm, const key& name, uint32_t capacity):
+	strm(strm), name(name), cap(std::clamp<uint32_t>(capacity, 1, max_capacity)), slots(cap)
+    {
+	    char raw[ring_index_size];
+	    size_t length = sizeof(raw);
+	    std::string index;
+	    size_t pos = 0;
+	    uint32_t magic = 0;
+	    uint16_t format = 0, pad = 0;
+
+	err = strm.read_blob(name, raw, length);	// the single lookup: the index is of the fixed size
+	if (err == ESP_OK || err == ESP_ERR_NVS_INVALID_LENGTH)
+	    index.assign(raw, (err == ESP_OK)? length: 0);
+	if (err == ESP_ERR_NVS_NOT_FOUND)
+	    err = ESP_OK;	// the new log
+	else if ((err == ESP_OK || err == ESP_ERR_NVS_INVALID_LENGTH) && (!get(index, pos, magic) || magic != ring_magic || !get(index, pos, format)
+		|| !get(index, pos, pad) || !get(index, pos, slots) || !get(index, pos, first) || !get(index, pos, next)
+		|| slots == 0 || slots > max_capacity || next - first > slots))
+	{
+	    err = ESP_ERR_NVS_TYPE_MISMATCH;	// not the log
+	    slots = cap;
+	    first = next = 0;
+	}
+	else if (err == ESP_OK && format != ring_format)
+	    err = ESP_ERR_INVALID_VERSION;
+	if (err == ESP_OK)
+	    err = strm.check_owner(name, false);	// the record keys are not of the other log
+	fault = err;	// the foreign or unread index is not written over
+	NVS_LOGI(__func__, "Ring log '%s': %" PRIu32 " of %" PRIu32 " records, head %" PRIu32, name.c_str(), next - first, slots, first);
+	NVS_TRACE_OP("open", name.c_str(), "ring_log", printf_helper(next - first).c_str(), err);
+    }; /* ring_log::ring_log() */
+
+
+    esp_err_t ring_log::write_record(uint32_t seq, const void* data, size_t size)
+    {
+	    std::vector<uint8_t> rec(sizeof(seq) + size);
+
+	memcpy(rec.data(), &seq, sizeof(seq));
+	if (size)
+	    memcpy(rec.data() + sizeof(seq), data, size);
+	return strm.write_blob(record_key(name, seq % slots), rec.data(), rec.size());
+    }; /* ring_log::write_record() */
+
+
+    esp_err_t ring_log::write_index()
+    {
+	    std::string index;
+	    esp_err_t rc;
+
+	put(index, ring_magic);
+	put(index, ring_format);
+	put(index, uint16_t(0));
+	put(index, slots);
+	put(index, first);
+	put(index, next);
+	if ((rc = strm.write_blob(name, index.data(), index.size())) == ESP_OK)
+	    rc = strm.commit();
+	return rc;
+    }; /* ring_log::write_index() */
+
+
+    esp_err_t ring_log::read_record(uint32_t seq, record& rec)
+    {
+	    uint32_t stored = 0;
+	    esp_err_t rc = strm.read_blob(record_key(name, seq % slots), rec.data);
+
+	if (rc != ESP_OK)
+	    return rc;
+	if (rec.data.size() < sizeof(stored))
+	    return ESP_ERR_NOT_FOUND;
+	memcpy(&stored, rec.data.data(), sizeof(stored));
+	if (stored != seq)
+	    return ESP_ERR_NOT_FOUND;	// overwritten by the newer record, not indexed yet
+	rec.seq = seq;
+	rec.data.erase(rec.data.begin(), rec.data.begin() + sizeof(stored));
+	return ESP_OK;
+    }; /* ring_log::read_record() */
+
+
+    // The record first, then the index: the interrupted append leaves the previous log
+    esp_err_t ring_log::append(const void* data, size_t size)
+    {
+	    batch one(*this);
+	    esp_err_t rc = one.append(data, size);
+
+	return (rc == ESP_OK)? one.commit(): rc;
+    }; /* ring_log::append() */
+
+
+    // The index first, then the records of the stored capacity: the interrupted clear leaves them unindexed
+    esp_err_t ring_log::clear()
+    {
+	    std::lock_guard<std::mutex> guard(lock);
+	    stream::whole_lock whole(strm);	// the records are erased by the handle, with no other operation on the stream
+	    uint32_t stored = slots;
+	    uint32_t from = next - std::min(next, stored);
+
+	if (fault != ESP_OK)
+	    return fault;
+	slots = cap;
+	first = next;
+	err = write_index();
+	// the records of the last 'stored' sequence numbers & the unindexed one of the interrupted append
+	for (uint32_t seq = from; err == ESP_OK && seq != next + 1; seq++)
+	    if ((err = nvs_erase_key(handler(strm.store), record_key(name, seq % stored).c_str())) == ESP_ERR_NVS_NOT_FOUND)
+		err = ESP_OK;
+	if (err == ESP_OK)
+	    err = strm.commit();
+	NVS_TRACE_OP("clear", name.c_str(), "ring_log", printf_helper(slots).c_str(), err);
+	return err;
+    }; /* ring_log::clear() */
+
+
+    uint32_t ring_log::capacity() const
+    {
+	    std::lock_guard<std::mutex> guard(lock);
+
+	return slots;
+    }; /* ring_log::capacity() */
+
+    uint32_t ring_log::size() const
+    {
+	    std::lock_guard<std::mutex> guard(lock);
+
+	return next - first;
+    }; /* ring_log::size() */
+
+    uint32_t ring_log::head() const
+    {
+	    std::lock_guard<std::mutex> guard(lock);
+
+	return first;
+    }; /* ring_log::head() */
+
+    uint32_t ring_log::tail() const
+    {
+	    std::lock_guard<std::mutex> guard(lock);
+
+	return next;
+    }; /* ring_log::tail() */
+
+    esp_err_t ring_log::status() const
+    {
+	    std::lock_guard<std::mutex> guard(lock);
+
+	return err;
+    }; /* ring_log::status() */
+
+
+    ring_log::iterator ring_log::begin()
+    {
+	    std::unique_lock<std::mutex> guard(lock);
+	    uint32_t from = first, to = next;
+
+	guard.unlock();	// the records are read by the iterator under the lock
+	return iterator(*this, from, to);
+    }; /* ring_log::begin() */
+
+    ring_log::iterator ring_log::end()
+    {
+	return iterator();
+    }; /* ring_log::end() */
+
+
+    ring_log::batch::batch(ring_log& log): log(log), guard(log.lock) {};
+
+    ring_log::batch::~batch()
+    {
+	commit();
+    }; /* ring_log::batch::~batch() */
+
+
+    // The record is written at once, the oldest one is evicted by the index of the commit()
+    esp_err_t ring_log::batch::append(const void* data, size_t size)
+    {
+	if (err != ESP_OK)
+	    return err;
+	if (log.fault != ESP_OK)
+	    return (err = log.fault);
+	// the record keys are claimed by the first append of the log object
+	if (!log.owned && (err = log.strm.check_owner(log.name, true)) != ESP_OK)
+	    return err;
+	log.owned = true;
+	if ((err = log.write_record(log.next + added, data, size)) == ESP_OK)
+	    added++;
+	return err;
+    }; /* ring_log::batch::append() */
+
+
+    esp_err_t ring_log::batch::commit()
+    {
+	if (!added)
+	    return err;
+
+	    uint32_t first = log.first;
+	    uint32_t next = log.next;
+
+	log.next += added;
+	if (log.next - log.first > log.slots)
+	    log.first = log.next - log.slots;	// the oldest records are overwritten
+	if ((err = log.write_index()) != ESP_OK)
+	{
+	    log.first = first;	// the records written are not indexed
+	    log.next = next;
+	}; /* if (err = log.write_index()) != ESP_OK */
+	NVS_TRACE_OP("append", log.name.c_str(), "ring_log", printf_helper(added).c_str(), err);
+	added = 0;
+	return (log.err = err);
+    }; /* ring_log::batch::commit() */
+
+
+    ring_log::iterator::iterator(ring_log& log, uint32_t from, uint32_t to): log(&log), at(from), to(to)
+    {
+	if (at == to)
+	{
+	    this->log = nullptr;	// the empty log
+	    at = 0;
+	}
+	else if (!fetch())
+	    ++(*this);
+    }; /* ring_log::iterator::iterator() */
+
+
+    ring_log::iterator& ring_log::iterator::operator++()
+    {
+	do
+	{
+	    if (!log)
+		return *this;
+	    if (++at == to)
+	    {
+		log = nullptr;
+		at = 0;
+		return *this;
+	    }; /* if ++at == to */
+	} while (!fetch());	// the overwritten records are skipped
+	return *this;
+    }; /* ring_log::iterator::operator++() */
+
+
+    bool ring_log::iterator::fetch()
+    {
+	    std::lock_guard<std::mutex> guard(log->lock);
+	    esp_err_t rc = log->read_record(at, cur);
+
+	if (rc == ESP_ERR_NOT_FOUND || rc == ESP_ERR_NVS_NOT_FOUND)
+	    return false;
+	if (rc != ESP_OK)
+	{
+	    err = rc;
+	    log = nullptr;	// the reading is stopped by the error
+	    at = 0;
+	}; /* if rc != ESP_OK */
+	return true;
+    }; /* ring_log::iterator::fetch() */
+
+
+
+    ///--[ Path keys: nvs::path ]--------------------------------------------------------------------------------------
+
+    /// The item of the path is stored at the reserved key of the hash of the path & of the ordinal of the path in
+    /// the bucket of its hash, "~<fnv1a>p<ordinal>". The bucket entry "~<fnv1a>pi" is the blob of the paths of the
+    /// hash: format:u8, {flags:u8, length:u8, path}..., the ordinal is the position of the path in it; the paths
+    /// are not removed from the bucket, so the ordinals are stable. The directory keeps the listing of its children
+    /// in the entry "~<fnv1a>t<ordinal>" of its own path (the top level - in "~paths"): format:u8,
+    /// {flags:u8, ordinal:u8, length:u8, segment}..., so the enumeration reads the listings of the subtree only.
+    /// The new path is linked into the listings first and into its bucket last: the path, whose linking is
+    /// interrupted by the reset, is not in the bucket yet and is linked again by its next write, at the same ordinal.
+
+    static constexpr uint8_t path_format = 1;
+    static constexpr uint8_t path_leaf = 0x01;	///< node of the path holds the item
+    static constexpr uint8_t path_dir = 0x02;	///< node of the path has the children
+    static constexpr key path_root("~paths");	///< listing of the top level
+
+    /// reserved key of the node 'ordinal' of the hash: 'p' - of the item, 't' - of the listing
+    static key node_key(uint32_t hash, char kind, uint8_t ordinal)
+    {
+	    char buff[16];
+
+	snprintf(buff, sizeof(buff), "%c%08" PRIx32 "%c%02x", stream::reserved_prefix, hash, kind, ordinal);
+	return key(buff);
+    }; /* node_key() */
+
+    /// reserved key of the bucket of the hash
+    static key bucket_key(uint32_t hash)
+    {
+	    char buff[16];
+
+	snprintf(buff, sizeof(buff), "%c%08" PRIx32 "pi", stream::reserved_prefix, hash);
+	return key(buff);
+    }; /* bucket_key() */
+
+
+    /// Node of the path in the bucket of its hash
+    struct path_node
+    {
+	uint32_t hash = 0;
+	uint8_t flags = 0;		///< path_leaf | path_dir; 0 - the path is not in the bucket
+	size_t ordinal = 0;		///< position in the bucket; of the absent path - the next one
+	size_t at = 0;			///< offset of the record of the path in the bucket
+	std::vector<uint8_t> bucket;	///< bucket entry as it is stored
+    }; /* struct path_node */
+
+
+    /// find the path in the bucket of its hash: one read of the bucket entry
+    static esp_err_t find_node(stream& strm, const std::string& name, path_node& node)
+    {
+	    esp_err_t rc;
+	    size_t pos = 1;
+
+	node.hash = fnv1a(name.c_str());
+	node.flags = 0;
+	node.ordinal = 0;
+	node.bucket.reserve(4 * (name.size() + 2));	// room for a few paths: the bucket is read by one get
+	rc = strm.read_blob(bucket_key(node.hash), node.bucket);
+	if (rc == ESP_ERR_NVS_NOT_FOUND)
+	{
+	    node.bucket.assign(1, path_format);
+	    node.at = node.bucket.size();
+	    return ESP_OK;
+	}; /* if rc == ESP_ERR_NVS_NOT_FOUND */
+	if (rc != ESP_OK)
+	    return rc;
+	if (node.bucket.empty() || node.bucket[0] != path_format)
+	    return ESP_ERR_INVALID_VERSION;
+	for (; pos < node.bucket.size(); node.ordinal++)
+	{
+	    if (pos + 2 > node.bucket.size() || pos + 2 + node.bucket[pos + 1] > node.bucket.size())
+		return ESP_ERR_INVALID_SIZE;	// the damaged bucket
+	    if (node.bucket[pos + 1] == name.size() && memcmp(&node.bucket[pos + 2], name.data(), name.size()) == 0)
+	    {
+		node.flags = node.bucket[pos];
+		node.at = pos;
+		return ESP_OK;
+	    }; /* if node.bucket[pos + 1] == name.size() && ... */
+	    pos += 2 + node.bucket[pos + 1];
+	}; /* for ; pos < node.bucket.size(); node.ordinal++ */
+	node.at = pos;
+	return ESP_OK;
+    }; /* find_node() */
+
+    /// there is the ordinal for the path, absent from its bucket
+    static esp_err_t room(const path_node& node)
+    {
+	return (node.flags || node.ordinal <= UINT8_MAX)? ESP_OK: ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+    }; /* room() */
+
+
+    /// add the child 'segment' of the 'kind' at the 'ordinal' to the listing of the directory
+    static esp_err_t add_child(stream& strm, const key& listing, std::string_view segment, uint8_t kind, uint8_t ordinal)
+    {
+	    std::vector<uint8_t> children;
+	    esp_err_t rc = strm.read_blob(listing, children);
+	    size_t pos = 1;
+
+	if (rc == ESP_ERR_NVS_NOT_FOUND)
+	    children.assign(1, path_format);
+	else if (rc != ESP_OK)
+	    return rc;
+	else if (children.empty() || children[0] != path_format)
+	    return ESP_ERR_INVALID_VERSION;
+	while (pos + 3 <= children.size() && pos + 3 + children[pos + 2] <= children.size()
+		&& !(children[pos + 2] == segment.size() && memcmp(&children[pos + 3], segment.data(), segment.size()) == 0))
+	    pos += 3 + children[pos + 2];
+	if (pos < children.size() && pos + 3 > children.size())
+	    return ESP_ERR_INVALID_SIZE;	// the damaged listing
+	if (pos < children.size() && (children[pos] & kind))
+	    return ESP_OK;			// linked already: by the write, interrupted before its bucket
+	if (pos < children.size())
+	    children[pos] |= kind;
+	else
+	{
+	    children.push_back(kind);
+	    children.push_back(ordinal);
+	    children.push_back(uint8_t(segment.size()));
+	    children.insert(children.end(), segment.begin(), segment.end());
+	}; /* else if pos < children.size() */
+	return strm.write_blob(listing, children.data(), children.size());
+    }; /* add_child() */
+
+
+    /// link the node of the 'kind' into the 'listing' of its directory, then mark it in its bucket
+    static esp_err_t attach(stream& strm, const std::string& name, path_node& node, const key& listing, uint8_t kind)
+    {
+	    size_t slash = name.rfind(path::separator);
+	    esp_err_t rc = add_child(strm, listing, std::string_view(name).substr(slash + 1), kind, uint8_t(node.ordinal));
+
+	if (rc != ESP_OK)
+	    return rc;
+	// the bucket is written last
+	if (node.flags)
+	    node.bucket[node.at] |= kind;
+	else
+	{
+		uint8_t head[2] = {kind, uint8_t(name.size())};
+
+	    node.bucket.insert(node.bucket.end(), head, head + sizeof(head));
+	    node.bucket.insert(node.bucket.end(), name.begin(), name.end());
+	}; /* else if node.flags */
+	node.flags |= kind;
+	return strm.write_blob(bucket_key(node.hash), node.bucket.data(), node.bucket.size());
+    }; /* attach() */
+
+    /// the directory of the path is linked, new or not a directory yet, up to the top level; then the node
+    /// of the path is read: the directory may be in the same bucket. 'listing' - of the directory
+    static esp_err_t prepare(stream& strm, const std::string& name, path_node& node, key& listing)
+    {
+	    size_t slash = name.rfind(path::separator);
+	    esp_err_t rc = ESP_OK;
+
+	listing = path_root;
+	if (slash != std::string::npos)
+	{
+		std::string parent = name.substr(0, slash);
+		path_node up;
+		key upper;
+
+	    if ((rc = find_node(strm, parent, up)) == ESP_OK && !(up.flags & path_dir)
+		    && (rc = prepare(strm, parent, up, upper)) == ESP_OK && !(up.flags & path_dir))
+		rc = attach(strm, parent, up, upper, path_dir);
+	    listing = node_key(up.hash, 't', uint8_t(up.ordinal));
+	}; /* if slash != std::string::npos */
+	if (rc == ESP_OK)
+	    rc = find_node(strm, name, node);
+	return (rc == ESP_OK)? room(node): rc;
+    }; /* prepare() */
+
+
+    /// add the paths of the items of the listing & of its subdirectories, the directory 'base'
+    static esp_err_t walk(stream& strm, const std::string& base, const key& listing, std::vector<path>& items)
+    {
+	    std::vector<uint8_t> children;
+	    esp_err_t rc = strm.read_blob(listing, children);
+
+	if (rc == ESP_ERR_NVS_NOT_FOUND)
+	    return ESP_OK;		// no items yet
+	if (rc != ESP_OK)
+	    return rc;
+	if (children.empty() || children[0] != path_format)
+	    return ESP_ERR_INVALID_VERSION;
+	for (size_t pos = 1; pos < children.size() && rc == ESP_OK; pos += 3 + children[pos + 2])
+	{
+	    if (pos + 3 > children.size() || pos + 3 + children[pos + 2] > children.size())
+		return ESP_ERR_INVALID_SIZE;
+
+		std::string child = base.empty()? std::string(): base + path::separator;
+
+	    child.append(reinterpret_cast<const char*>(&children[pos + 3]), children[pos + 2]);
+	    if (children[pos] & path_leaf)
+		items.emplace_back(child);
+	    if (children[pos] & path_dir)
+		rc = walk(strm, child, node_key(fnv1a(child.c_str()), 't', children[pos + 1]), items);
+	}; /* for size_t pos = 1; pos < children.size() && ...; pos += ... */
+	return rc;
+    }; /* walk() */
+
+
+    path::path(std::string_view str)
+    {
+	for (size_t pos = 0; pos < str.size();)
+	{
+		size_t next = std::min(str.find(separator, pos), str.size());
+
+	    if (next > pos)
+	    {
+		if (!text.empty())
+		    text += separator;
+		text.append(str, pos, next - pos);
+	    }; /* if next > pos */
+	    pos = next + 1;
+	}; /* for size_t pos = 0; pos < str.size(); */
+    }; /* path::path() */
+
+
+    esp_err_t stream::find_path(const path& name, key& item)
+    {
+	    path_node node;
+	    esp_err_t rc = (!name.valid())? ESP_ERR_NVS_KEY_TOO_LONG: name.empty()? ESP_ERR_NVS_INVALID_NAME:
+		    find_node(*this, name.str(), node);
+
+	if (rc == ESP_OK && !(node.flags & path_leaf))
+	    rc = ESP_ERR_NVS_NOT_FOUND;
+	if (rc == ESP_OK)
+	    item = node_key(node.hash, 'p', uint8_t(node.ordinal));
+	return (err = rc);
+    }; /* stream::find_path() */
+
+
+    // The item of the known path is written at once; the new one - under the lock of the whole stream
+    // (the nodes are read, changed & written back by one task at a time): its item first, then its node
+    esp_err_t stream::put_path(const path& name, const raw_item& item)
+    {
+	    path_node node;
+	    esp_err_t rc = (!name.valid())? ESP_ERR_NVS_KEY_TOO_LONG: name.empty()? ESP_ERR_NVS_INVALID_NAME:
+		    find_node(*this, name.str(), node);
+	    auto put = [this, &item](const key& at)
+	    {
+		if (item.type == NVS_TYPE_STR)
+		    return put_str(at, static_cast<const char*>(item.data), item.size);
+		if (item.type == NVS_TYPE_BLOB)
+		    return put_fixed(at, item.data, item.size);
+		return put_int(at, item.type, item.data);
+	    }; /* put() */
+
+	if (rc != ESP_OK)
+	    return (err = rc);
+	if (node.flags & path_leaf)
+	    return (err = put(node_key(node.hash, 'p', uint8_t(node.ordinal))));
+
+	    whole_lock guard(*this);
+	    key listing;
+
+	if ((rc = prepare(*this, name.str(), node, listing)) != ESP_OK)
+	    return (err = rc);
+
+	    key at = node_key(node.hash, 'p', uint8_t(node.ordinal));
+
+	rc = put(at);
+	if (rc == ESP_OK && !(node.flags & path_leaf))
+	{
+	    rc = attach(*this, name.str(), node, listing, path_leaf);
+	    NVS_TRACE_OP("link", name.c_str(), "path", at.c_str(), rc);
+	}; /* if rc == ESP_OK && !(node.flags & path_leaf) */
+	return (err = rc);
+    }; /* stream::put_path() */
+
+
+    esp_err_t stream::list(const path& prefix, std::vector<path>& items)
+    {
+	    key listing = path_root;
+	    path_node node;
+	    esp_err_t rc = prefix.valid()? ESP_OK: ESP_ERR_NVS_KEY_TOO_LONG;
+
+	items.clear();
+	if (rc == ESP_OK && !prefix.empty() && (rc = find_node(*this, prefix.str(), node)) == ESP_OK)
+	{
+	    if (!node.flags)
+		return (err = ESP_ERR_NVS_NOT_FOUND);
+	    if (node.flags & path_leaf)
+		items.push_back(prefix);
+	    if (!(node.flags & path_dir))
+		return (err = ESP_OK);
+	    listing = node_key(node.hash, 't', uint8_t(node.ordinal));
+	}; /* if rc == ESP_OK && !prefix.empty() && ... */
+	if (rc == ESP_OK)
+	    rc = walk(*this, prefix.str(), listing, items);
+	return (err = rc);
+    }; /* stream::list() */
+
+
+
+    ///--[ Snapshots: nvs::snapshot ]---------------------------------------------------------------------------------
+
+    esp_err_t snapshot::buffer::write(const void* data, size_t length)
+    {
+	out.insert(out.end(), static_cast<const uint8_t*>(data), static_cast<const uint8_t*>(data) + length);
+	return ESP_OK;
+    }; /* snapshot::buffer::write() */
+
+
+    esp_err_t snapshot::memory::read(void* data, size_t length)
+    {
+	if (length > size - pos)
+	    return ESP_ERR_INVALID_SIZE;
+	memcpy(data, base + pos, length);
+	pos += length;
+	return ESP_OK;
+    }; /* snapshot::memory::read() */
+
+
+    esp_err_t snapshot::file::write(const void* data, size_t length)
+    {
+	return (f && fwrite(data, 1, length, f) == length)? ESP_OK: ESP_FAIL;
+    }; /* snapshot::file::write() */
+
+
+    esp_err_t snapshot::file::read(void* data, size_t length)
+    {
+	if (!f)
+	    return ESP_FAIL;
+	if (fread(data, 1, length, f) == length)
+	    return ESP_OK;
+	return ferror(f)? ESP_FAIL: ESP_ERR_INVALID_SIZE;
+    }; /* snapshot::file::read() */
+
+
+    esp_err_t snapshot::file::rewind()
+    {
+	return (f && start >= 0 && fseek(f, start, SEEK_SET) == 0)? ESP_OK: ESP_ERR_NOT_SUPPORTED;
+    }; /* snapshot::file::rewind() */
+
+
+#ifndef ESP_PLATFORM
+    snapshot::mapped::mapped(const std::string& path): memory(nullptr, 0)
+    {
+	    int fd = ::open(path.c_str(), O_RDONLY);
+	    struct stat st;
+
+	if (fd < 0 || fstat(fd, &st) != 0)
+	    err = ESP_ERR_NOT_FOUND;
+	else if (st.st_size > 0)
+	{
+		void* addr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+	    if (addr == MAP_FAILED)
+		err = ESP_FAIL;
+	    else
+	    {
+		base = static_cast<const uint8_t*>(addr);
+		size = st.st_size;
+	    }; /* else if addr == MAP_FAILED */
+	}; /* else if st.st_size > 0 */
+	if (fd >= 0)
+	    ::close(fd);	// the mapping stays
+    }; /* snapshot::mapped::mapped() */
+
+
+    snapshot::mapped::~mapped()
+    {
+	if (base)
+	    munmap(const_cast<uint8_t*>(base), size);
+    }; /* snapshot::mapped::~mapped() */
+#endif
+
+
+    /// Reader of the snapshot, item by item: the CRC-32 is counted over all the bytes read
+    class snapshot_reader
+    {
+    public:
+	snapshot_reader(snapshot::source& in): in(in) {};
+
+	/// check the header
+	esp_err_t start()
+	{
+		uint32_t magic = 0;
+		uint8_t format = 0;
+		esp_err_t rc = take(&magic, sizeof(magic));
+
+	    if (rc == ESP_OK)
+		rc = take(&format, sizeof(format));
+	    if (rc == ESP_OK && (magic != snapshot::magic || format != snapshot::format))
+		rc = ESP_ERR_INVALID_VERSION;
+	    return rc;
+	}; /* start() */
+
+	/// the next item; 'type' is 0 at the end, which is checked by its count & the CRC-32
+	esp_err_t next(nvs_type_t& type, key& name, std::string& data)
+	{
+		uint8_t tag = 0, keylen = 0;
+		uint32_t length = 0;
+		char kname[NVS_KEY_NAME_MAX_SIZE] = {};
+		esp_err_t rc = take(&tag, sizeof(tag));
+
+	    type = nvs_type_t(tag);
+	    if (rc != ESP_OK || tag == 0)
+		return (rc == ESP_OK)? finish(): rc;
+	    if (!known(type))
+		return ESP_ERR_INVALID_RESPONSE;
+	    if ((rc = take(&keylen, sizeof(keylen))) != ESP_OK)
+		return rc;
+	    if (keylen == 0 || keylen > key::max_length)
+		return ESP_ERR_NVS_INVALID_NAME;
+	    if ((rc = take(kname, keylen)) != ESP_OK)
+		return rc;
+	    for (unsigned shift = 0, more = 1; more; shift += 7)
+	    {
+		    uint8_t byte = 0;
+
+		if (shift > 28)
+		    return ESP_ERR_INVALID_SIZE;
+		if ((rc = take(&byte, sizeof(byte))) != ESP_OK)
+		    return rc;
+		length |= uint32_t(byte & 0x7F) << shift;
+		more = byte & 0x80;
+	    }; /* for unsigned shift = 0, more = 1; more; shift += 7 */
+	    if ((type & 0xE0) == 0 && length != (type & 0x0F))
+		return ESP_ERR_NVS_INVALID_LENGTH;
+	    name = key(std::string_view(kname, keylen));
+	    data.resize(length);
+	    count++;
+	    return take(data.data(), length);
+	}; /* next() */
+
+    private:
+	snapshot::source& in;
+	uint32_t crc = 0;
+	uint32_t count = 0;	///< items read
+
+	esp_err_t take(void* data, size_t length)
+	{
+		esp_err_t rc = in.read(data, length);
+
+	    if (rc == ESP_OK)
+		crc = crc32(crc, data, length);
+	    return rc;
+	}; /* take() */
+
+	/// the count of the items & the CRC-32 of all the bytes before it
+	esp_err_t finish()
+	{
+		uint32_t items = 0, stored = 0, sum;
+		esp_err_t rc = take(&items, sizeof(items));
+
+	    sum = crc;
+	    if (rc == ESP_OK)
+		rc = in.read(&stored, sizeof(stored));
+	    if (rc == ESP_OK && (items != count || stored != sum))
+		rc = ESP_ERR_INVALID_CRC;
+	    return rc;
+	}; /* finish() */
+
+	static bool known(nvs_type_t type)
+	{
+	    switch (type)
+	    {
+	    case NVS_TYPE_I8: case NVS_TYPE_U8: case NVS_TYPE_I16: case NVS_TYPE_U16:
+	    case NVS_TYPE_I32: case NVS_TYPE_U32: case NVS_TYPE_I64: case NVS_TYPE_U64:
+	    case NVS_TYPE_STR: case NVS_TYPE_BLOB:
+		return true;
+	    default:
+		return false;
+	    }; /* switch type */
+	}; /* known() */
+    }; /* class nvs::snapshot_reader */
+
+
+    // Write all the items of the namespace into the sink: one item in RAM at a time
+    esp_err_t stream::export_snapshot(snapshot::sink& out)
+    {
+	    whole_lock guard(*this);
+	    nvs_iterator_t it = nullptr;
+	    std::string head, data;
+	    uint32_t crc = 0, count = 0;
+	    esp_err_t rc;
+
+	if (!ready())
+	    return (err = ESP_ERR_NVS_INVALID_STATE);
+	put(head, snapshot::magic);
+	put(head, snapshot::format);
+	crc = crc32(crc, head.data(), head.size());
+	rc = out.write(head.data(), head.size());
+	if (rc == ESP_OK)
+	    rc = nvs_entry_find_in_handle(handler(store), NVS_TYPE_ANY, &it);
+	while (rc == ESP_OK)
+	{
+		nvs_entry_info_t info;
+		size_t keylen;
+
+	    nvs_entry_info(it, &info);
+	    keylen = strnlen(info.key, key::max_length);
+	    rc = (info.type == NVS_TYPE_BLOB)? get_blob(handler(store), info.key, data): get_raw(handler(store), info.key, info.type, data);
+	    if (rc != ESP_OK)
+		break;
+	    head.clear();
+	    put(head, uint8_t(info.type));
+	    put(head, uint8_t(keylen));
+	    head.append(info.key, keylen);
+	    for (uint32_t length = data.size(); ; length >>= 7)
+	    {
+		put(head, uint8_t((length & 0x7F) | ((length > 0x7F)? 0x80: 0)));
+		if (length <= 0x7F)
+		    break;
+	    }; /* for uint32_t length = data.size(); ; length >>= 7 */
+	    crc = crc32(crc32(crc, head.data(), head.size()), data.data(), data.size());
+	    if ((rc = out.write(head.data(), head.size())) == ESP_OK)
+		rc = out.write(data.data(), data.size());
+	    count++;
+	    if (rc == ESP_OK)
+		rc = nvs_entry_next(&it);
+	}; /* while rc == ESP_OK */
+	nvs_release_iterator(it);
+	// end of iteration is reported as 'not found'
+	if (rc == ESP_ERR_NVS_NOT_FOUND)
+	{
+	    head.clear();
+	    put(head, uint8_t(0));
+	    put(head, count);
+	    put(head, crc32(crc, head.data(), head.size()));
+	    rc = out.write(head.data(), head.size());
+	}; /* if rc == ESP_ERR_NVS_NOT_FOUND */
+	NVS_TRACE_OP("export", "-", "snapshot", printf_helper(count).c_str(), rc);
+	return (err = rc);
+    }; /* stream::export_snapshot() */
+
+
+    // Write the items of the snapshot & commit them once
+    esp_err_t stream::import_snapshot(snapshot::source& in, bool replace)
+    {
+	    whole_lock guard(*this);
+	    std::vector<key> names;	///< keys of the snapshot, for the replace
+	    std::vector<key> absent;
+	    std::string data;
+	    nvs_type_t type;
+	    key name;
+	    uint32_t count = 0;
+	    esp_err_t rc;
+
+	if (!ready())
+	    return (err = ESP_ERR_NVS_INVALID_STATE);
+	// the rewindable source is checked whole before the first write
+	if ((rc = in.rewind()) == ESP_OK)
+	{
+		snapshot_reader check(in);
+
+	    rc = check.start();
+	    while (rc == ESP_OK && (rc = check.next(type, name, data)) == ESP_OK && type != 0)
+		;
+	    if (rc == ESP_OK)
+		rc = in.rewind();
+	}
+	else if (rc == ESP_ERR_NOT_SUPPORTED)
+	    rc = ESP_OK;
+
+	    snapshot_reader reader(in);
+
+	if (rc == ESP_OK)
+	    rc = reader.start();
+	while (rc == ESP_OK && (rc = reader.next(type, name, data)) == ESP_OK && type != 0)
+	{
+	    if ((rc = set_raw(handler(store), name.c_str(), type, data)) != ESP_OK)
+		break;
+	    telemetry::written(meter, name, data.size());
+	    count++;
+	    if (shadow && type == NVS_TYPE_BLOB)
+	    {
+		    std::string text;
+		    size_t length;
+		    uint8_t flags;
+
+		// the compressed string is kept by the shadow as the string, as by the image::load()
+		shadow->forget(name);
+		if (packed(data.data(), data.size(), flags, length) && (flags & pack_string) && has_pack_mark(handler(store))
+			&& (text.resize(length), unpack(data.data(), data.size(), text.data(), length)) == ESP_OK)
+		    shadow->update(name, NVS_TYPE_STR, text.data(), text.size());
+	    }
+	    else if (shadow)
+		shadow->update(name, type, data.data(), data.size());
+	    if (replace)
+		names.push_back(name);
+	}; /* while rc == ESP_OK && ... */
+	// all the items are compared, the reserved ones included; erased after the iteration
+	if (rc == ESP_OK && replace)
+	{
+		nvs_iterator_t it = nullptr;
+
+	    std::sort(names.begin(), names.end());
+	    for (rc = nvs_entry_find_in_handle(handler(store), NVS_TYPE_ANY, &it); rc == ESP_OK; rc = nvs_entry_next(&it))
+	    {
+		    nvs_entry_info_t info;
+
+		nvs_entry_info(it, &info);
+		if (!std::binary_search(names.begin(), names.end(), key(std::string_view(info.key, strnlen(info.key, key::max_length)))))
+		    absent.push_back(key(std::string_view(info.key, strnlen(info.key, key::max_length))));
+	    }; /* for rc = nvs_entry_find_in_handle(...); ... */
+	    nvs_release_iterator(it);
+	    if (rc == ESP_ERR_NVS_NOT_FOUND)
+		rc = ESP_OK;
+	    for (size_t i = 0; i < absent.size() && rc == ESP_OK; i++)
+	    {
+		if ((rc = nvs_erase_key(handler(store), absent[i].c_str())) == ESP_ERR_NVS_NOT_FOUND)
+		    rc = ESP_OK;
+		if (shadow)
+		    shadow->forget(absent[i]);
+	    }; /* for size_t i = 0; i < absent.size() && rc == ESP_OK; i++ */
+	}; /* if rc == ESP_OK && replace */
+	packs = false;	// the mark of the compressed items may be imported or erased
+	if (rc == ESP_OK)
+	    rc = nvs_commit(handler(store));
+	if (rc == ESP_OK)
+	    telemetry::committed(meter);
+	NVS_TRACE_OP("import", "-", "snapshot", printf_helper(count).c_str(), rc);
+	return (err = rc);
+    }; /* stream::import_snapshot() */
+
+
+
+    ///--[ Class nvs::telemetry ]--------------------------------------------------------------------------------------
+
+    /// Counters of the namespace & of its keys
+    class telemetry::space
+    {
+    public:
+	struct keyed
+	{
+	    telemetry::counters cnt;
+	    bool pending = false;	///< written since the last commit of the namespace
+	}; /* struct keyed */
+
+	std::string part;
+	std::string name;
+	std::mutex lock;
+	telemetry::counters cnt;
+	std::map<std::string, keyed> keys;
+	std::vector<keyed*> pending;	///< keys written since the last commit; std::map keeps them in place
+    }; /* class nvs::telemetry::space */
+
+    /// All the metered namespaces; never destroyed, as the streams keep the pointers
+    struct meters
+    {
+	std::atomic<bool> on = false;
+	std::mutex lock;
+	std::map<std::pair<std::string, std::string>, telemetry::space> spaces;
+    }; /* struct meters */
+
+    static meters& metered()
+    {
+	    static meters* all = new meters;
+
+	return *all;
+    }; /* metered() */
+
+
+    void telemetry::enable(bool on) {
+	metered().on.store(on, std::memory_order_relaxed); };
+
+    bool telemetry::enabled() {
+	return metered().on.load(std::memory_order_relaxed); };
+
+
+    void telemetry::reset()
+    {
+	    meters& all = metered();
+	    std::lock_guard<std::mutex> guard(all.lock);
+
+	for (auto& it: all.spaces)
+	{
+		std::lock_guard<std::mutex> sguard(it.second.lock);
+
+	    it.second.cnt = counters();
+	    it.second.pending.clear();
+	    it.second.keys.clear();
+	}; /* for auto& it: all.spaces */
+    }; /* telemetry::reset() */
+
+
+    telemetry::space* telemetry::attach(const std::string& part, const std::string& name)
+    {
+	    meters& all = metered();
+	    std::lock_guard<std::mutex> guard(all.lock);
+	    auto [it, added] = all.spaces.try_emplace(std::make_pair(part, name));
+
+	if (added)
+	{
+	    it->second.part = part;
+	    it->second.name = name;
+	}; /* if added */
+	return &it->second;
+    }; /* telemetry::attach() */
+
+
+    void telemetry::written(space* sp, const key& name, size_t bytes)
+    {
+	if (!sp || !enabled())
+	    return;
+
+	    std::lock_guard<std::mutex> guard(sp->lock);
+	    space::keyed& k = sp->keys[name.c_str()];
+
+	sp->cnt.writes++;
+	sp->cnt.bytes += bytes;
+	k.cnt.writes++;
+	k.cnt.bytes += bytes;
+	if (!k.pending)
+	{
+	    k.pending = true;
+	    sp->pending.push_back(&k);
+	}; /* if !k.pending */
+    }; /* telemetry::written() */
+
+
+    void telemetry::skipped(space* sp, const key& name)
+    {
+	if (!sp || !enabled())
+	    return;
+
+	    std::lock_guard<std::mutex> guard(sp->lock);
+
+	sp->cnt.skipped++;
+	sp->keys[name.c_str()].cnt.skipped++;
+    }; /* telemetry::skipped() */
+
+
+    void telemetry::committed(space* sp)
+    {
+	if (!sp || !enabled())
+	    return;
+
+	    std::lock_guard<std::mutex> guard(sp->lock);
+
+	sp->cnt.commits++;
+	for (space::keyed* k: sp->pending)
+	{
+	    k->cnt.commits++;
+	    k->pending = false;
+	}; /* for space::keyed* k: sp->pending */
+	sp->pending.clear();
+    }; /* telemetry::committed() */
+
+
+    /// the most written first, by the bytes when the writes are equal
+    template <typename Stats>
+    static bool hotter(const Stats& a, const Stats& b)
+    {
+	return a.cnt.writes != b.cnt.writes? a.cnt.writes > b.cnt.writes: a.cnt.bytes > b.cnt.bytes;
+    }; /* hotter() */
+
+
+    std::vector<telemetry::key_stats> telemetry::keys(size_t top)
+    {
+	    meters& all = metered();
+	    std::lock_guard<std::mutex> guard(all.lock);
+	    std::vector<key_stats> out;
+
+	for (auto& it: all.spaces)
+	{
+		std::lock_guard<std::mutex> sguard(it.second.lock);
+
+	    for (auto& k: it.second.keys)
+		out.push_back(key_stats{it.second.part, it.second.name, k.first, k.second.cnt});
+	}; /* for auto& it: all.spaces */
+	std::sort(out.begin(), out.end(), hotter<key_stats>);
+	if (out.size() > top)
+	    out.resize(top);
+	return out;
+    }; /* telemetry::keys() */
+
+
+    std::vector<telemetry::space_stats> telemetry::spaces()
+    {
+	    meters& all = metered();
+	    std::lock_guard<std::mutex> guard(all.lock);
+	    std::vector<space_stats> out;
+
+	for (auto& it: all.spaces)
+	{
+		std::lock_guard<std::mutex> sguard(it.second.lock);
+
+	    out.push_back(space_stats{it.second.part, it.second.name, it.second.cnt, it.second.keys.size()});
+	}; /* for auto& it: all.spaces */
+	std::sort(out.begin(), out.end(), hotter<space_stats>);
+	return out;
+    }; /* telemetry::spaces() */
+
+
+    esp_err_t telemetry::get_usage(const std::string& part, usage& use)
+    {
+	    nvs_stats_t st;
+	    esp_err_t rc = nvs_get_stats(part.c_str(), &st);
+
+	use = usage();
+	use.part = part;
+	if (rc == ESP_OK)
+	{
+	    use.used = st.used_entries;
+	    use.free = st.free_entries;
+	    use.total = st.total_entries;
+	    use.namespaces = st.namespace_count;
+	}; /* if rc == ESP_OK */
+	return rc;
+    }; /* telemetry::get_usage() */
+
+
+    static void put(std::string& out, const telemetry::counters& cnt)
+    {
+	put(out, cnt.writes);
+	put(out, cnt.skipped);
+	put(out, cnt.commits);
+	put(out, cnt.bytes);
+    }; /* put(telemetry::counters) */
+
+    /// the name, prefixed by its length
+    static void put(std::string& out, const std::string& name)
+    {
+	    size_t len = std::min<size_t>(name.size(), UINT8_MAX);
+
+	put(out, uint8_t(len));
+	out.append(name, 0, len);
+    }; /* put(std::string) */
+
+
+    std::vector<uint8_t> telemetry::dump()
+    {
+	    std::vector<space_stats> sps = spaces();
+	    std::vector<key_stats> ks = keys();
+	    std::vector<std::string> parts;
+	    std::string out;
+
+	for (const space_stats& sp: sps)
+	    if (std::find(parts.begin(), parts.end(), sp.part) == parts.end() && parts.size() < UINT8_MAX)
+		parts.push_back(sp.part);
+
+	put(out, dump_magic);
+	put(out, dump_format);
+	put(out, uint8_t(parts.size()));
+	for (const std::string& part: parts)
+	{
+		usage use;
+
+	    get_usage(part, use);	// the partition not initialized is dumped with the zero usage
+	    put(out, part);
+	    put(out, uint32_t(use.used));
+	    put(out, uint32_t(use.free));
+	    put(out, uint32_t(use.total));
+	    put(out, uint32_t(use.namespaces));
+	}; /* for const std::string& part: parts */
+
+	put(out, uint16_t(std::min<size_t>(sps.size(), UINT16_MAX)));
+	for (size_t i = 0; i < sps.size() && i < UINT16_MAX; i++)
+	{
+		const space_stats& sp = sps[i];
+		uint8_t pidx = uint8_t(std::find(parts.begin(), parts.end(), sp.part) - parts.begin());
+		uint16_t count = 0;
+
+	    for (const key_stats& k: ks)
+		count += (k.part == sp.part && k.space == sp.space && count < UINT16_MAX);
+	    put(out, pidx);
+	    put(out, sp.space);
+	    put(out, sp.cnt);
+	    put(out, count);
+	    for (const key_stats& k: ks)
+		if (k.part == sp.part && k.space == sp.space && count-- > 0)
+		{
+		    put(out, k.name);
+		    put(out, k.cnt);
+		}; /* if k.part == sp.part && ... */
+	}; /* for size_t i = 0; i < sps.size() && i < UINT16_MAX; i++ */
+	return std::vector<uint8_t>(out.begin(), out.end());
+    }; /* telemetry::dump() */
+
+
+
+
+}; /* namespace nvs */